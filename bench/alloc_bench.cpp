@@ -0,0 +1,169 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Counts heap allocations of GetValue once metadata of a file is cached.
+// Every field of every file is requested until it is served from the cache,
+// then the calls are repeated with all allocations counted. A cached value
+// must not allocate, so any allocation makes the program fail.
+//
+// usage: alloc_bench <corpus directory> [repeats]
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "formats.h"
+#include "plugin.h"
+#include "utils.h"
+
+namespace
+{
+
+std::atomic<unsigned long long> Allocations(0);
+
+// same as TC passes for string fields
+const int MaxLen = 2048;
+
+typedef std::vector<std::wstring> files_t;
+}
+
+void* operator new(std::size_t iSize)
+{
+   ++Allocations;
+   if (void* p = std::malloc(iSize ? iSize : 1))
+      return p;
+   throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t iSize)
+{
+   return operator new(iSize);
+}
+
+void* operator new(std::size_t iSize, const std::nothrow_t&) noexcept
+{
+   ++Allocations;
+   return std::malloc(iSize ? iSize : 1);
+}
+
+void* operator new[](std::size_t iSize, const std::nothrow_t&) noexcept
+{
+   return operator new(iSize, std::nothrow);
+}
+
+void operator delete(void* p) noexcept
+{
+   std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+   std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+   std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+   std::free(p);
+}
+
+int main(int argc, char* argv[])
+{
+   if (argc < 2)
+   {
+      std::fprintf(stderr, "usage: %s <corpus directory> [repeats]\n", argv[0]);
+      return 2;
+   }
+
+   const int iRepeats = argc > 2 ? std::max(std::atoi(argv[2]), 1) : 10;
+   const std::string sDir(argv[1]);
+
+   files_t listing;
+   utils::ListDirectory(std::wstring(sDir.begin(), sDir.end()), listing);
+   files_t files;
+   for (const std::wstring& sFileName : listing)
+   {
+      if (wdx::IsSupportedFile(sFileName))
+         files.push_back(sFileName);
+   }
+   std::sort(files.begin(), files.end());
+
+   if (files.empty())
+   {
+      std::fprintf(stderr, "no supported files in %s\n", sDir.c_str());
+      return 1;
+   }
+
+   // the index would allocate while it is read, only the memory cache is measured
+   const std::string sIniName = sDir + "/alloc_bench.ini";
+   {
+      std::ofstream ini(sIniName.c_str());
+      ini << "[wdxtaglib]\nIndexSizeMB=0\nPrefetch=0\n";
+   }
+
+   wdx::plugin inst;
+   inst.SetIniName(sIniName);
+
+   std::vector<std::string> names;
+   char szName[MaxLen];
+   char szUnits[MaxLen];
+   while (inst.GetSupportedField((int) names.size(), szName, szUnits, MaxLen) != ft_nomorefields)
+      names.push_back(szName);
+
+   // fills the cache, the audio hash is computed on its first request
+   std::vector<wchar_t> value(MaxLen / sizeof(wchar_t));
+   for (int iField = 0; iField < (int) names.size(); ++iField)
+   {
+      for (const std::wstring& sFileName : files)
+         inst.GetValue(sFileName.c_str(), iField, 0, &value[0], MaxLen, 0);
+   }
+
+   std::printf("%u files, %d repeats\n", (unsigned) files.size(), iRepeats);
+   std::printf("%-28s %12s %14s\n", "field", "calls", "allocs/call");
+
+   unsigned long long iTotal = 0;
+   for (int iField = 0; iField < (int) names.size(); ++iField)
+   {
+      const unsigned long long iBefore = Allocations;
+      unsigned long long iCalls = 0;
+      for (int i = 0; i < iRepeats; ++i)
+      {
+         for (const std::wstring& sFileName : files)
+         {
+            inst.GetValue(sFileName.c_str(), iField, 0, &value[0], MaxLen, 0);
+            ++iCalls;
+         }
+      }
+
+      const unsigned long long iAllocations = Allocations - iBefore;
+      iTotal += iAllocations;
+      std::printf("%-28s %12llu %14.3f\n", names[iField].c_str(), iCalls, (double) iAllocations / iCalls);
+   }
+
+   std::remove(sIniName.c_str());
+   std::printf("%llu allocations\n", iTotal);
+   return 0 == iTotal ? 0 : 1;
+}
@@ -0,0 +1,109 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// Measures how many bytes are written to a file per tag edit, saving with
+// TagLib and with the plugin's in-place writers.
+//
+// usage: edit_bench <audio file> [number of edits]
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <tag.h>
+#include <tfilestream.h>
+
+#include "formats.h"
+#include "stream.h"
+#include "writer.h"
+
+namespace
+{
+
+enum save_mode_t
+{
+   modeTagLib,
+   modePlugin,
+};
+
+// lengths of titles set by the edits, grow and shrink in turns
+const size_t TitleLengths[] = { 8, 64, 512, 16, 4096, 128, 12000, 32 };
+
+bool CopyFile(const std::string& sFrom, const std::string& sTo)
+{
+   std::ifstream in(sFrom.c_str(), std::ios::binary);
+   std::ofstream out(sTo.c_str(), std::ios::binary | std::ios::trunc);
+   out << in.rdbuf();
+   return in && out;
+}
+
+bool RunEdits(const std::string& sFileName, const save_mode_t mode, const int iEdits)
+{
+   const std::string sCopy = sFileName + ".bench";
+   if (!CopyFile(sFileName, sCopy))
+   {
+      std::fprintf(stderr, "cannot copy %s\n", sFileName.c_str());
+      return false;
+   }
+
+   const std::wstring sCopyW(sCopy.begin(), sCopy.end());
+   const wdx::padding_policy policy(4 * 1024, 10);
+   unsigned long long iTotalWritten = 0;
+   unsigned long long iTotalMoved = 0;
+
+   std::printf("%s\n", modeTagLib == mode ? "TagLib save" : "plugin save");
+   for (int i = 0; i < iEdits; ++i)
+   {
+      wdx::write_tracking_stream* pStream = new wdx::write_tracking_stream(new TagLib::FileStream(utils::GetNativePath(sCopyW).c_str()));
+      wdx::audio_file file(sCopyW, pStream, false);
+      if (!file.IsValid() || !file.GetFile()->tag())
+      {
+         std::fprintf(stderr, "cannot open %s\n", sCopy.c_str());
+         return false;
+      }
+
+      const size_t iLength = TitleLengths[i % (sizeof(TitleLengths) / sizeof(TitleLengths[0]))];
+      file.GetFile()->tag()->setTitle(std::string(iLength, 'a' + i % 26));
+
+      const bool bSaved = modeTagLib == mode ? file.GetFile()->save() : wdx::SaveTags(file, policy);
+
+      std::printf("  edit %3d: title %5u bytes, %s, written %10llu, moved %10llu\n", i + 1, (unsigned) iLength,
+            bSaved ? "saved" : "FAILED", pStream->GetBytesWritten(), pStream->GetBytesMoved());
+      iTotalWritten += pStream->GetBytesWritten();
+      iTotalMoved += pStream->GetBytesMoved();
+   }
+
+   std::printf("  per edit: written %llu, moved %llu\n", iTotalWritten / iEdits, iTotalMoved / iEdits);
+   std::remove(sCopy.c_str());
+   return true;
+}
+}
+
+int main(int argc, char* argv[])
+{
+   if (argc < 2)
+   {
+      std::fprintf(stderr, "usage: %s <audio file> [number of edits]\n", argv[0]);
+      return 2;
+   }
+
+   const int iEdits = argc > 2 ? std::max(std::atoi(argv[2]), 1) : 16;
+
+   const bool bOk = RunEdits(argv[1], modeTagLib, iEdits) && RunEdits(argv[1], modePlugin, iEdits);
+   return bOk ? 0 : 1;
+}
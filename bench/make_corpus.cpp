@@ -0,0 +1,1012 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Generates a reproducible corpus of small synthetic audio files, one group
+// per supported extension, for the plugin benchmarks. Audio data is not
+// playable, only headers are valid, so TagLib reads properties of the files
+// as it does for real ones.
+//
+// usage: make_corpus <output directory> [options]
+//   --files N          files per extension, 8 by default
+//   --tag-size N       average size of the tag text in bytes, 512 by default
+//   --picture-size N   size of the embedded front cover in bytes, 0 for none
+//   --vbr-percent N    share of VBR MP3 files, 50 by default
+//   --seed N           seed of the generator, same seed gives same files
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <tbytevector.h>
+#include <tfilestream.h>
+#include <tag.h>
+#include <mpegfile.h>
+#include <id3v2tag.h>
+#include <attachedpictureframe.h>
+#include <flacfile.h>
+#include <flacpicture.h>
+#include <xiphcomment.h>
+#include <vorbisfile.h>
+#include <oggflacfile.h>
+#include <speexfile.h>
+#include <opusfile.h>
+#include <mpcfile.h>
+#include <wavpackfile.h>
+#include <apefile.h>
+#include <apetag.h>
+#include <trueaudiofile.h>
+#include <mp4file.h>
+#include <mp4tag.h>
+#include <asffile.h>
+#include <asftag.h>
+#include <asfpicture.h>
+#include <aifffile.h>
+#include <wavfile.h>
+
+#include "formats.h"
+#include "ogg.h"
+#include "utils.h"
+
+namespace
+{
+
+typedef TagLib::ByteVector bytes;
+
+struct options
+{
+   int m_Files;
+   unsigned int m_TagSize;
+   unsigned int m_PictureSize;
+   int m_VbrPercent;
+   unsigned int m_Seed;
+
+   options() :
+         m_Files(8), m_TagSize(512), m_PictureSize(0), m_VbrPercent(50), m_Seed(1)
+   {
+   }
+};
+
+/// xorshift, gives the same sequence on every platform
+class random_generator
+{
+public:
+   explicit random_generator(const unsigned int iSeed) :
+         State_(iSeed ? iSeed : 1)
+   {
+   }
+
+   unsigned int Next()
+   {
+      State_ ^= State_ << 13;
+      State_ ^= State_ >> 17;
+      State_ ^= State_ << 5;
+      return State_;
+   }
+
+   /// number in [iMin, iMax]
+   unsigned int Range(const unsigned int iMin, const unsigned int iMax)
+   {
+      return iMin + Next() % (iMax - iMin + 1);
+   }
+
+private:
+   unsigned int State_;
+};
+
+struct corpus_format
+{
+   const char* m_Extension;
+   wdx::format_t m_Format;
+};
+
+// every extension of the detect string, .oga holds Ogg FLAC
+const corpus_format Formats[] =
+{
+   { "mp3", wdx::fmtMPEG },
+   { "ogg", wdx::fmtOggVorbis },
+   { "oga", wdx::fmtOggFLAC },
+   { "flac", wdx::fmtFLAC },
+   { "mpc", wdx::fmtMPC },
+   { "wv", wdx::fmtWavPack },
+   { "spx", wdx::fmtSpeex },
+   { "opus", wdx::fmtOpus },
+   { "tta", wdx::fmtTrueAudio },
+   { "m4a", wdx::fmtMP4 },
+   { "m4r", wdx::fmtMP4 },
+   { "m4b", wdx::fmtMP4 },
+   { "m4p", wdx::fmtMP4 },
+   { "mp4", wdx::fmtMP4 },
+   { "3g2", wdx::fmtMP4 },
+   { "wma", wdx::fmtASF },
+   { "asf", wdx::fmtASF },
+   { "aif", wdx::fmtAIFF },
+   { "aiff", wdx::fmtAIFF },
+   { "afc", wdx::fmtAIFF },
+   { "aifc", wdx::fmtAIFF },
+   { "wav", wdx::fmtWAV },
+   { "ape", wdx::fmtAPE },
+   { "mod", wdx::fmtMod },
+   { "module", wdx::fmtMod },
+   { "nst", wdx::fmtMod },
+   { "wow", wdx::fmtMod },
+   { "s3m", wdx::fmtS3M },
+   { "it", wdx::fmtIT },
+   { "xm", wdx::fmtXM },
+};
+
+const unsigned int SampleRate = 44100;
+
+void AppendLE(bytes& data, const unsigned long long iValue, const int iBytes)
+{
+   for (int i = 0; i < iBytes; ++i)
+      data.append(bytes(1, (char) (iValue >> (8 * i))));
+}
+
+void AppendBE(bytes& data, const unsigned long long iValue, const int iBytes)
+{
+   for (int i = iBytes - 1; i >= 0; --i)
+      data.append(bytes(1, (char) (iValue >> (8 * i))));
+}
+
+void AppendText(bytes& data, const char* pText, const unsigned int iSize)
+{
+   bytes text(iSize, 0);
+   std::strncpy(text.data(), pText, iSize);
+   data.append(text);
+}
+
+bytes Payload(random_generator& rng, const unsigned int iSize)
+{
+   bytes data(iSize, 0);
+   for (unsigned int i = 0; i < iSize; ++i)
+      data[i] = (char) rng.Next();
+   return data;
+}
+
+// MPEG-1 layer III, 44100 Hz, stereo; VBR files start with a Xing frame
+bytes MakeMpeg(random_generator& rng, const bool bVbr)
+{
+   static const unsigned int Bitrates[] = { 64, 96, 128, 160, 192, 256 };
+   static const unsigned char BitrateIndexes[] = { 5, 7, 9, 10, 11, 13 };
+   const unsigned int iFrames = rng.Range(200, 800);
+
+   bytes data;
+   unsigned int iStreamSize = 0;
+   for (unsigned int i = 0; i < iFrames; ++i)
+   {
+      const int iRate = bVbr ? rng.Range(0, 5) : 2;
+      const unsigned int iFrameSize = 144 * Bitrates[iRate] * 1000 / SampleRate;
+      bytes frame;
+      AppendBE(frame, 0xFFFB0000 | (BitrateIndexes[iRate] << 12), 4);
+      frame.append(Payload(rng, iFrameSize - 4));
+      data.append(frame);
+      iStreamSize += iFrameSize;
+   }
+
+   if (!bVbr)
+      return data;
+
+   // Xing tag follows the 32 bytes of stereo side information
+   const unsigned int iXingFrameSize = 144 * 128 * 1000 / SampleRate;
+   bytes xing;
+   AppendBE(xing, 0xFFFB9000, 4);
+   xing.append(bytes(32, 0));
+   xing.append(bytes("Xing"));
+   AppendBE(xing, 3, 4); // frames and bytes fields
+   AppendBE(xing, iFrames, 4);
+   AppendBE(xing, iStreamSize + iXingFrameSize, 4);
+   xing.resize(iXingFrameSize);
+   xing.append(data);
+   return xing;
+}
+
+bytes MakeStreamInfo(const unsigned long long iSamples)
+{
+   bytes data;
+   AppendBE(data, 4096, 2); // min and max block size
+   AppendBE(data, 4096, 2);
+   AppendBE(data, 0, 3); // min and max frame size
+   AppendBE(data, 0, 3);
+   // sample rate, channels - 1, bits per sample - 1, samples
+   AppendBE(data, ((unsigned long long) SampleRate << 44) | (1ull << 41) | (15ull << 36) | iSamples, 8);
+   data.append(bytes(16, 0)); // MD5
+   return data;
+}
+
+bytes MakeFlac(random_generator& rng)
+{
+   const unsigned int iSeconds = rng.Range(5, 20);
+   bytes data("fLaC");
+   AppendBE(data, 0x80000000 | 34, 4); // last block, STREAMINFO
+   data.append(MakeStreamInfo((unsigned long long) iSeconds * SampleRate));
+   AppendBE(data, 0xFFF8, 2);
+   data.append(Payload(rng, iSeconds * 2048));
+   return data;
+}
+
+bytes MakeOggPage(const bytes& body, const unsigned char iFlags, const long long iGranule,
+      const unsigned int iSequence)
+{
+   wdx::ogg_page page;
+   page.m_Flags = iFlags;
+   page.m_Granule = iGranule;
+   page.m_Serial = 0x57445854;
+   page.m_Sequence = iSequence;
+   page.m_Lacing.assign(body.size() / 255, 255);
+   page.m_Lacing.push_back((unsigned char) (body.size() % 255));
+   return wdx::RenderOggPage(page, body);
+}
+
+/// first header alone on the first page, each other header and each audio
+/// packet on a page of its own
+bytes MakeOggStream(random_generator& rng, const wdx::format_t format)
+{
+   const unsigned int iRate = wdx::fmtOpus == format ? 48000 : wdx::fmtSpeex == format ? 16000 : SampleRate;
+   const unsigned int iSeconds = rng.Range(5, 20);
+
+   std::vector<bytes> headers(2);
+   switch (format)
+   {
+      case wdx::fmtOggVorbis:
+         headers[0].append(bytes("\x01vorbis"));
+         AppendLE(headers[0], 0, 4); // version
+         AppendLE(headers[0], 2, 1);
+         AppendLE(headers[0], iRate, 4);
+         AppendLE(headers[0], 0, 4);
+         AppendLE(headers[0], 128000, 4); // nominal bitrate
+         AppendLE(headers[0], 0, 4);
+         AppendLE(headers[0], 0xB8, 1); // block sizes
+         AppendLE(headers[0], 1, 1);
+         headers[1].append(bytes("\x03vorbis"));
+         AppendLE(headers[1], 0, 4); // vendor
+         AppendLE(headers[1], 0, 4); // fields
+         AppendLE(headers[1], 1, 1);
+         headers.push_back(bytes("\x05vorbis"));
+         headers.back().append(Payload(rng, 3000));
+         break;
+      case wdx::fmtOpus:
+         headers[0].append(bytes("OpusHead"));
+         AppendLE(headers[0], 1, 1);
+         AppendLE(headers[0], 2, 1);
+         AppendLE(headers[0], 312, 2); // pre-skip
+         AppendLE(headers[0], 44100, 4);
+         AppendLE(headers[0], 0, 2); // gain
+         AppendLE(headers[0], 0, 1);
+         headers[1].append(bytes("OpusTags"));
+         AppendLE(headers[1], 0, 4);
+         AppendLE(headers[1], 0, 4);
+         break;
+      case wdx::fmtSpeex:
+         AppendText(headers[0], "Speex   ", 8);
+         AppendText(headers[0], "1.2", 20);
+         AppendLE(headers[0], 1, 4); // version id
+         AppendLE(headers[0], 80, 4); // header size
+         AppendLE(headers[0], iRate, 4);
+         AppendLE(headers[0], 1, 4); // wideband
+         AppendLE(headers[0], 4, 4); // bitstream version
+         AppendLE(headers[0], 1, 4); // channels
+         AppendLE(headers[0], 27800, 4);
+         AppendLE(headers[0], 320, 4); // frame size
+         AppendLE(headers[0], 0, 4); // vbr
+         AppendLE(headers[0], 1, 4); // frames per packet
+         AppendLE(headers[0], 0, 4); // extra headers
+         AppendLE(headers[0], 0, 8);
+         AppendLE(headers[1], 0, 4);
+         AppendLE(headers[1], 0, 4);
+         break;
+      case wdx::fmtOggFLAC:
+         headers[0].append(bytes("\x7F" "FLAC"));
+         AppendLE(headers[0], 1, 1);
+         AppendLE(headers[0], 0, 1);
+         AppendBE(headers[0], 1, 2); // header packets
+         headers[0].append(bytes("fLaC"));
+         AppendBE(headers[0], 34, 4); // STREAMINFO
+         headers[0].append(MakeStreamInfo((unsigned long long) iSeconds * iRate));
+         AppendBE(headers[1], 0x84000008, 4); // last block, VORBIS_COMMENT
+         AppendLE(headers[1], 0, 4);
+         AppendLE(headers[1], 0, 4);
+         break;
+      default:
+         break;
+   }
+
+   bytes data;
+   unsigned int iSequence = 0;
+   for (size_t i = 0; i < headers.size(); ++i)
+      data.append(MakeOggPage(headers[i], i ? 0 : wdx::ogg_page::FirstPage, 0, iSequence++));
+
+   const unsigned int iPages = iSeconds * 4;
+   for (unsigned int i = 1; i <= iPages; ++i)
+   {
+      const unsigned char iFlags = i == iPages ? wdx::ogg_page::LastPage : 0;
+      data.append(MakeOggPage(Payload(rng, 4000), iFlags, (long long) iRate * i / 4, iSequence++));
+   }
+   return data;
+}
+
+// SV7 header
+bytes MakeMpc(random_generator& rng)
+{
+   const unsigned int iFrames = rng.Range(200, 800);
+   bytes data("MP+");
+   AppendLE(data, 0x07, 1);
+   AppendLE(data, iFrames, 4);
+   data.append(bytes(48, 0)); // 44100 Hz, no gain, no gapless info
+   data.append(Payload(rng, iFrames * 32));
+   return data;
+}
+
+bytes MakeWavPack(random_generator& rng)
+{
+   const unsigned int iSamples = rng.Range(5, 20) * SampleRate;
+   const unsigned int iBlockSize = iSamples / 64;
+   bytes data("wvpk");
+   AppendLE(data, 24 + iBlockSize, 4);
+   AppendLE(data, 0x407, 2); // version
+   AppendLE(data, 0, 2); // track and index
+   AppendLE(data, iSamples, 4);
+   AppendLE(data, 0, 4); // block index
+   AppendLE(data, iSamples, 4);
+   AppendLE(data, (9 << 23) | 1, 4); // 44100 Hz, 2 bytes per sample
+   AppendLE(data, 0, 4); // CRC
+   data.append(Payload(rng, iBlockSize));
+   return data;
+}
+
+bytes MakeTrueAudio(random_generator& rng)
+{
+   const unsigned int iSamples = rng.Range(5, 20) * SampleRate;
+   bytes data("TTA1");
+   AppendLE(data, 1, 2); // format
+   AppendLE(data, 2, 2);
+   AppendLE(data, 16, 2);
+   AppendLE(data, SampleRate, 4);
+   AppendLE(data, iSamples, 4);
+   AppendLE(data, 0, 4); // CRC
+   data.append(Payload(rng, iSamples / 64));
+   return data;
+}
+
+bytes MakeAtom(const char* pName, const bytes& body)
+{
+   bytes data;
+   AppendBE(data, 8 + body.size(), 4);
+   data.append(bytes(pName, 4));
+   data.append(body);
+   return data;
+}
+
+bytes MakeFullAtom(const char* pName, const bytes& body)
+{
+   bytes data(4, 0); // version and flags
+   data.append(body);
+   return MakeAtom(pName, data);
+}
+
+/// AAC track of fixed size samples, in a single chunk at iChunkOffset
+bytes MakeMovie(const unsigned int iSamples, const unsigned int iSampleSize, const unsigned int iChunkOffset)
+{
+   const unsigned int iDuration = iSamples * 1024;
+
+   bytes mvhd;
+   AppendBE(mvhd, 0, 8); // creation and modification time
+   AppendBE(mvhd, SampleRate, 4);
+   AppendBE(mvhd, iDuration, 4);
+   AppendBE(mvhd, 0x00010000, 4); // rate
+   AppendBE(mvhd, 0x0100, 2); // volume
+   mvhd.append(bytes(10 + 36 + 24, 0));
+   AppendBE(mvhd, 2, 4); // next track
+
+   bytes mdhd;
+   AppendBE(mdhd, 0, 8);
+   AppendBE(mdhd, SampleRate, 4);
+   AppendBE(mdhd, iDuration, 4);
+   AppendBE(mdhd, 0x55C4, 2); // undetermined language
+   AppendBE(mdhd, 0, 2);
+
+   bytes hdlr(4, 0);
+   hdlr.append(bytes("soun"));
+   hdlr.append(bytes(13, 0));
+
+   bytes mp4a(6, 0);
+   AppendBE(mp4a, 1, 2); // data reference
+   mp4a.append(bytes(8, 0));
+   AppendBE(mp4a, 2, 2);
+   AppendBE(mp4a, 16, 2);
+   AppendBE(mp4a, 0, 4);
+   AppendBE(mp4a, SampleRate << 16, 4);
+
+   bytes stsd;
+   AppendBE(stsd, 1, 4);
+   stsd.append(MakeAtom("mp4a", mp4a));
+
+   bytes stts;
+   AppendBE(stts, 1, 4);
+   AppendBE(stts, iSamples, 4);
+   AppendBE(stts, 1024, 4);
+
+   bytes stsc;
+   AppendBE(stsc, 1, 4);
+   AppendBE(stsc, 1, 4);
+   AppendBE(stsc, iSamples, 4);
+   AppendBE(stsc, 1, 4);
+
+   bytes stsz;
+   AppendBE(stsz, iSampleSize, 4);
+   AppendBE(stsz, iSamples, 4);
+
+   bytes stco;
+   AppendBE(stco, 1, 4);
+   AppendBE(stco, iChunkOffset, 4);
+
+   bytes stbl = MakeFullAtom("stsd", stsd);
+   stbl.append(MakeFullAtom("stts", stts));
+   stbl.append(MakeFullAtom("stsc", stsc));
+   stbl.append(MakeFullAtom("stsz", stsz));
+   stbl.append(MakeFullAtom("stco", stco));
+
+   bytes minf = MakeFullAtom("smhd", bytes(4, 0));
+   minf.append(MakeAtom("stbl", stbl));
+
+   bytes mdia = MakeFullAtom("mdhd", mdhd);
+   mdia.append(MakeFullAtom("hdlr", hdlr));
+   mdia.append(MakeAtom("minf", minf));
+
+   bytes moov = MakeFullAtom("mvhd", mvhd);
+   moov.append(MakeAtom("trak", MakeAtom("mdia", mdia)));
+   return MakeAtom("moov", moov);
+}
+
+bytes MakeMp4(random_generator& rng)
+{
+   const unsigned int iSamples = rng.Range(5, 20) * SampleRate / 1024;
+   const unsigned int iSampleSize = 371; // 128 kbps
+
+   bytes ftyp("M4A ");
+   AppendBE(ftyp, 0, 4);
+   ftyp.append(bytes("M4A mp42isom"));
+   bytes data = MakeAtom("ftyp", ftyp);
+
+   // the offset does not change the size of the movie atom
+   const unsigned int iChunkOffset = data.size() + MakeMovie(iSamples, iSampleSize, 0).size() + 8;
+   data.append(MakeMovie(iSamples, iSampleSize, iChunkOffset));
+   data.append(MakeAtom("mdat", Payload(rng, iSamples * iSampleSize)));
+   return data;
+}
+
+bytes MakeGuid(const char* pText)
+{
+   // first three groups are little endian
+   unsigned int iGroups[11];
+   std::sscanf(pText, "%8x-%4x-%4x-%2x%2x-%2x%2x%2x%2x%2x%2x", &iGroups[0], &iGroups[1], &iGroups[2],
+         &iGroups[3], &iGroups[4], &iGroups[5], &iGroups[6], &iGroups[7], &iGroups[8], &iGroups[9], &iGroups[10]);
+   bytes data;
+   AppendLE(data, iGroups[0], 4);
+   AppendLE(data, iGroups[1], 2);
+   AppendLE(data, iGroups[2], 2);
+   for (int i = 3; i < 11; ++i)
+      AppendLE(data, iGroups[i], 1);
+   return data;
+}
+
+bytes MakeAsfObject(const char* pGuid, const bytes& body)
+{
+   bytes data = MakeGuid(pGuid);
+   AppendLE(data, 24 + body.size(), 8);
+   data.append(body);
+   return data;
+}
+
+bytes MakeAsf(random_generator& rng)
+{
+   const unsigned int iSeconds = rng.Range(5, 20);
+   const unsigned int iPacketSize = 3200;
+   const unsigned int iPackets = iSeconds * 5;
+   const unsigned int iPreroll = 3000;
+
+   bytes data(16, 0); // file id
+   AppendLE(data, iPackets, 8);
+   AppendLE(data, 0x0101, 2);
+   data.append(Payload(rng, iPackets * iPacketSize));
+   const bytes dataObject = MakeAsfObject("75B22636-668E-11CF-A6D9-00AA0062CE6C", data);
+
+   bytes stream = MakeGuid("F8699E40-5B4D-11CF-A8FD-00805F5C442B"); // audio media
+   stream.append(MakeGuid("20FB5700-5B55-11CF-A8FD-00805F5C442B")); // no error correction
+   AppendLE(stream, 0, 8); // time offset
+   AppendLE(stream, 18, 4); // type specific data
+   AppendLE(stream, 0, 4);
+   AppendLE(stream, 1, 2); // stream number
+   AppendLE(stream, 0, 4);
+   AppendLE(stream, 0x161, 2); // WMA
+   AppendLE(stream, 2, 2);
+   AppendLE(stream, SampleRate, 4);
+   AppendLE(stream, 16000, 4); // bytes per second
+   AppendLE(stream, 2973, 2); // block align
+   AppendLE(stream, 16, 2);
+   AppendLE(stream, 0, 2);
+   const bytes streamObject = MakeAsfObject("B7DC0791-A9B7-11CF-8EE6-00C00C205365", stream);
+
+   const unsigned int iHeaderSize = 30 + 104 + streamObject.size();
+   bytes properties(16, 0); // file id
+   AppendLE(properties, iHeaderSize + dataObject.size(), 8);
+   AppendLE(properties, 0, 8); // creation date
+   AppendLE(properties, iPackets, 8);
+   AppendLE(properties, (iSeconds * 1000ull + iPreroll) * 10000, 8); // play duration
+   AppendLE(properties, iSeconds * 10000000ull, 8); // send duration
+   AppendLE(properties, iPreroll, 8);
+   AppendLE(properties, 2, 4); // seekable
+   AppendLE(properties, iPacketSize, 4);
+   AppendLE(properties, iPacketSize, 4);
+   AppendLE(properties, 128000, 4);
+
+   bytes header;
+   AppendLE(header, 2, 4); // objects
+   AppendLE(header, 1, 1);
+   AppendLE(header, 2, 1);
+   header.append(MakeAsfObject("8CABDCA1-A947-11CF-8EE4-00C00C205365", properties));
+   header.append(streamObject);
+
+   bytes file = MakeAsfObject("75B22630-668E-11CF-A6D9-00AA0062CE6C", header);
+   file.append(dataObject);
+   return file;
+}
+
+bytes MakeAiff(random_generator& rng)
+{
+   const unsigned int iFrames = rng.Range(1, 4) * SampleRate;
+
+   bytes comm;
+   AppendBE(comm, 2, 2);
+   AppendBE(comm, iFrames, 4);
+   AppendBE(comm, 16, 2);
+   AppendBE(comm, 0x400EAC44, 4); // 44100 as 80 bit float
+   AppendBE(comm, 0, 6);
+
+   bytes ssnd;
+   AppendBE(ssnd, 0, 8); // offset and block size
+   ssnd.append(Payload(rng, iFrames * 4));
+
+   bytes form("AIFF");
+   form.append(bytes("COMM"));
+   AppendBE(form, comm.size(), 4);
+   form.append(comm);
+   form.append(bytes("SSND"));
+   AppendBE(form, ssnd.size(), 4);
+   form.append(ssnd);
+
+   bytes data("FORM");
+   AppendBE(data, form.size(), 4);
+   data.append(form);
+   return data;
+}
+
+bytes MakeWav(random_generator& rng)
+{
+   const unsigned int iFrames = rng.Range(1, 4) * SampleRate;
+
+   bytes riff("WAVE");
+   riff.append(bytes("fmt "));
+   AppendLE(riff, 16, 4);
+   AppendLE(riff, 1, 2); // PCM
+   AppendLE(riff, 2, 2);
+   AppendLE(riff, SampleRate, 4);
+   AppendLE(riff, SampleRate * 4, 4);
+   AppendLE(riff, 4, 2);
+   AppendLE(riff, 16, 2);
+   riff.append(bytes("data"));
+   AppendLE(riff, iFrames * 4, 4);
+   riff.append(Payload(rng, iFrames * 4));
+
+   bytes data("RIFF");
+   AppendLE(data, riff.size(), 4);
+   data.append(riff);
+   return data;
+}
+
+// Monkey's Audio 3.99 descriptor and header
+bytes MakeApe(random_generator& rng)
+{
+   const unsigned int iBlocksPerFrame = 73728;
+   const unsigned int iFrames = rng.Range(3, 12);
+   const unsigned int iDataSize = iFrames * 4096;
+
+   bytes data("MAC ");
+   AppendLE(data, 3990, 2);
+   AppendLE(data, 0, 2);
+   AppendLE(data, 52, 4); // descriptor
+   AppendLE(data, 24, 4); // header
+   AppendLE(data, 0, 4); // seek table
+   AppendLE(data, 0, 4); // header data
+   AppendLE(data, iDataSize, 4);
+   AppendLE(data, 0, 4);
+   AppendLE(data, 0, 4); // terminating data
+   data.append(bytes(16, 0)); // MD5
+
+   AppendLE(data, 2000, 2); // compression level
+   AppendLE(data, 0, 2);
+   AppendLE(data, iBlocksPerFrame, 4);
+   AppendLE(data, iBlocksPerFrame / 2, 4); // final frame
+   AppendLE(data, iFrames, 4);
+   AppendLE(data, 16, 2);
+   AppendLE(data, 2, 2);
+   AppendLE(data, SampleRate, 4);
+   data.append(Payload(rng, iDataSize));
+   return data;
+}
+
+// ProTracker, 4 channels, a single empty pattern
+bytes MakeMod()
+{
+   bytes data(20, 0);
+   for (int i = 0; i < 31; ++i)
+   {
+      data.append(bytes(22, 0));
+      AppendBE(data, 0, 2); // length
+      AppendBE(data, 0x0040, 2); // finetune and volume
+      AppendBE(data, 0, 2);
+      AppendBE(data, 1, 2); // repeat length
+   }
+   AppendLE(data, 1, 1); // song length
+   AppendLE(data, 127, 1);
+   data.append(bytes(128, 0));
+   data.append(bytes("M.K."));
+   data.append(bytes(64 * 4 * 4, 0));
+   return data;
+}
+
+bytes MakeS3M()
+{
+   bytes data(28, 0);
+   AppendLE(data, 0x1A, 1);
+   AppendLE(data, 16, 1); // module
+   AppendLE(data, 0, 2);
+   AppendLE(data, 0, 2); // orders
+   AppendLE(data, 0, 2); // instruments
+   AppendLE(data, 0, 2); // patterns
+   AppendLE(data, 0, 2);
+   AppendLE(data, 0x1320, 2); // tracker
+   AppendLE(data, 2, 2);
+   data.append(bytes("SCRM"));
+   AppendLE(data, 64, 1); // global volume
+   AppendLE(data, 6, 1); // speed
+   AppendLE(data, 125, 1); // tempo
+   AppendLE(data, 0xB0, 1); // master volume
+   data.append(bytes(12, 0));
+   const char Channels[] = { 0, 8, 1, 9 };
+   for (int i = 0; i < 32; ++i)
+      AppendLE(data, i < 4 ? Channels[i] : 0xFF, 1);
+   return data;
+}
+
+bytes MakeIT()
+{
+   bytes data("IMPM");
+   data.append(bytes(26, 0));
+   AppendLE(data, 0x1004, 2); // pattern highlight
+   AppendLE(data, 0, 2); // orders
+   AppendLE(data, 0, 2); // instruments
+   AppendLE(data, 0, 2); // samples
+   AppendLE(data, 0, 2); // patterns
+   AppendLE(data, 0x0214, 2); // created with
+   AppendLE(data, 0x0214, 2); // compatible with
+   AppendLE(data, 9, 2); // stereo, linear slides
+   AppendLE(data, 0, 2);
+   AppendLE(data, 128, 1); // global volume
+   AppendLE(data, 48, 1); // mix volume
+   AppendLE(data, 6, 1);
+   AppendLE(data, 125, 1);
+   AppendLE(data, 128, 1); // separation
+   AppendLE(data, 0, 1);
+   AppendLE(data, 0, 2); // message length
+   AppendLE(data, 0, 4);
+   AppendLE(data, 0, 4);
+   for (int i = 0; i < 64; ++i)
+      AppendLE(data, i < 4 ? 32 : 32 + 128, 1); // panning, other channels off
+   data.append(bytes(64, 64));
+   return data;
+}
+
+bytes MakeXM()
+{
+   bytes data;
+   AppendText(data, "Extended Module: ", 17);
+   data.append(bytes(20, 0));
+   AppendLE(data, 0x1A, 1);
+   AppendText(data, "make_corpus", 20);
+   AppendLE(data, 0x0104, 2);
+   AppendLE(data, 276, 4); // header
+   AppendLE(data, 0, 2); // song length
+   AppendLE(data, 0, 2);
+   AppendLE(data, 4, 2); // channels
+   AppendLE(data, 0, 2); // patterns
+   AppendLE(data, 0, 2); // instruments
+   AppendLE(data, 1, 2); // linear frequencies
+   AppendLE(data, 6, 2);
+   AppendLE(data, 125, 2);
+   data.append(bytes(256, 0));
+   return data;
+}
+
+bytes MakeSkeleton(const wdx::format_t format, random_generator& rng, const bool bVbr)
+{
+   switch (format)
+   {
+      case wdx::fmtMPEG:
+         return MakeMpeg(rng, bVbr);
+      case wdx::fmtOggVorbis:
+      case wdx::fmtOggFLAC:
+      case wdx::fmtSpeex:
+      case wdx::fmtOpus:
+         return MakeOggStream(rng, format);
+      case wdx::fmtFLAC:
+         return MakeFlac(rng);
+      case wdx::fmtMPC:
+         return MakeMpc(rng);
+      case wdx::fmtWavPack:
+         return MakeWavPack(rng);
+      case wdx::fmtTrueAudio:
+         return MakeTrueAudio(rng);
+      case wdx::fmtMP4:
+         return MakeMp4(rng);
+      case wdx::fmtASF:
+         return MakeAsf(rng);
+      case wdx::fmtAIFF:
+         return MakeAiff(rng);
+      case wdx::fmtWAV:
+         return MakeWav(rng);
+      case wdx::fmtAPE:
+         return MakeApe(rng);
+      case wdx::fmtMod:
+         return MakeMod();
+      case wdx::fmtS3M:
+         return MakeS3M();
+      case wdx::fmtIT:
+         return MakeIT();
+      case wdx::fmtXM:
+         return MakeXM();
+      default:
+         return bytes();
+   }
+}
+
+std::wstring MakeText(random_generator& rng, const unsigned int iLength)
+{
+   // some non-Latin letters to exercise conversions
+   static const wchar_t Letters[] = L"abcdefghijklmnopqrstuvwxyz    \x0436\x00E9";
+   std::wstring sText(iLength, L' ');
+   for (unsigned int i = 0; i < iLength; ++i)
+      sText[i] = Letters[rng.Next() % (sizeof(Letters) / sizeof(Letters[0]) - 1)];
+   return sText;
+}
+
+bytes MakePicture(random_generator& rng, const unsigned int iSize)
+{
+   bytes data("\xFF\xD8\xFF\xE0", 4); // looks like JPEG
+   data.append(Payload(rng, iSize > 4 ? iSize - 4 : 0));
+   return data;
+}
+
+std::string Base64(const bytes& data)
+{
+   static const char Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+   std::string sResult;
+   for (unsigned int i = 0; i < data.size(); i += 3)
+   {
+      const unsigned int iCount = std::min(data.size() - i, 3u);
+      unsigned int iGroup = 0;
+      for (unsigned int j = 0; j < 3; ++j)
+         iGroup = (iGroup << 8) | (j < iCount ? (unsigned char) data[i + j] : 0);
+      for (unsigned int j = 0; j < 4; ++j)
+         sResult += j <= iCount ? Alphabet[(iGroup >> (18 - 6 * j)) & 0x3F] : '=';
+   }
+   return sResult;
+}
+
+void AddApePicture(TagLib::APE::Tag* pTag, const bytes& picture)
+{
+   bytes data("cover.jpg", 10); // file name with its terminator
+   data.append(picture);
+   TagLib::APE::Item item;
+   item.setKey("Cover Art (Front)");
+   item.setType(TagLib::APE::Item::Binary);
+   item.setBinaryData(data);
+   pTag->setItem("Cover Art (Front)", item);
+}
+
+void AddId3v2Picture(TagLib::ID3v2::Tag* pTag, const bytes& picture)
+{
+   TagLib::ID3v2::AttachedPictureFrame* pFrame = new TagLib::ID3v2::AttachedPictureFrame;
+   pFrame->setMimeType("image/jpeg");
+   pFrame->setType(TagLib::ID3v2::AttachedPictureFrame::FrontCover);
+   pFrame->setPicture(picture);
+   pTag->addFrame(pFrame);
+}
+
+TagLib::FLAC::Picture* MakeFlacPicture(const bytes& picture)
+{
+   TagLib::FLAC::Picture* pPicture = new TagLib::FLAC::Picture;
+   pPicture->setMimeType("image/jpeg");
+   pPicture->setType(TagLib::FLAC::Picture::FrontCover);
+   pPicture->setData(picture);
+   return pPicture;
+}
+
+/// front cover in the way the format stores it, nothing for tracker modules
+void AddPicture(const wdx::audio_file& file, const bytes& picture)
+{
+   TagLib::File* pFile = file.GetFile();
+   switch (file.GetFormat())
+   {
+      case wdx::fmtMPEG:
+         AddId3v2Picture(static_cast<TagLib::MPEG::File*>(pFile)->ID3v2Tag(true), picture);
+         break;
+      case wdx::fmtTrueAudio:
+         AddId3v2Picture(static_cast<TagLib::TrueAudio::File*>(pFile)->ID3v2Tag(true), picture);
+         break;
+      case wdx::fmtAIFF:
+         AddId3v2Picture(static_cast<TagLib::RIFF::AIFF::File*>(pFile)->tag(), picture);
+         break;
+      case wdx::fmtWAV:
+         AddId3v2Picture(static_cast<TagLib::RIFF::WAV::File*>(pFile)->ID3v2Tag(), picture);
+         break;
+      case wdx::fmtFLAC:
+         static_cast<TagLib::FLAC::File*>(pFile)->addPicture(MakeFlacPicture(picture));
+         break;
+      case wdx::fmtOggVorbis:
+      case wdx::fmtOggFLAC:
+      case wdx::fmtSpeex:
+      case wdx::fmtOpus:
+         {
+         std::unique_ptr<TagLib::FLAC::Picture> pPicture(MakeFlacPicture(picture));
+         TagLib::Ogg::XiphComment* pTag = static_cast<TagLib::Ogg::XiphComment*>(pFile->tag());
+         pTag->addField("METADATA_BLOCK_PICTURE", Base64(pPicture->render()));
+         break;
+      }
+      case wdx::fmtMPC:
+         AddApePicture(static_cast<TagLib::MPC::File*>(pFile)->APETag(true), picture);
+         break;
+      case wdx::fmtWavPack:
+         AddApePicture(static_cast<TagLib::WavPack::File*>(pFile)->APETag(true), picture);
+         break;
+      case wdx::fmtAPE:
+         AddApePicture(static_cast<TagLib::APE::File*>(pFile)->APETag(true), picture);
+         break;
+      case wdx::fmtMP4:
+         {
+         TagLib::MP4::CoverArtList covers;
+         covers.append(TagLib::MP4::CoverArt(TagLib::MP4::CoverArt::JPEG, picture));
+         static_cast<TagLib::MP4::File*>(pFile)->tag()->itemListMap()["covr"] = covers;
+         break;
+      }
+      case wdx::fmtASF:
+         {
+         TagLib::ASF::Picture cover;
+         cover.setMimeType("image/jpeg");
+         cover.setType(TagLib::ASF::Picture::FrontCover);
+         cover.setPicture(picture);
+         static_cast<TagLib::ASF::File*>(pFile)->tag()->addAttribute("WM/Picture", cover);
+         break;
+      }
+      default:
+         break;
+   }
+}
+
+bool WriteFile(const std::string& sFileName, const bytes& data)
+{
+   std::ofstream out(sFileName.c_str(), std::ios::binary | std::ios::trunc);
+   out.write(data.data(), data.size());
+   return !!out;
+}
+
+bool MakeFile(const std::string& sFileName, const wdx::format_t format, random_generator& rng,
+      const options& opts)
+{
+   const bool bVbr = (int) rng.Range(0, 99) < opts.m_VbrPercent;
+   if (!WriteFile(sFileName, MakeSkeleton(format, rng, bVbr)))
+      return false;
+
+   const std::wstring sFileNameW(sFileName.begin(), sFileName.end());
+   wdx::audio_file file(sFileNameW, new TagLib::FileStream(utils::GetNativePath(sFileNameW).c_str()));
+   if (!file.IsValid() || file.GetFormat() != format || !file.GetFile()->tag())
+      return false;
+
+   // comment takes what is left of the tag size
+   const unsigned int iTagSize = rng.Range(opts.m_TagSize / 2, opts.m_TagSize * 3 / 2);
+   const std::wstring sTitle = MakeText(rng, rng.Range(4, 40));
+   const std::wstring sArtist = MakeText(rng, rng.Range(4, 30));
+   const std::wstring sAlbum = MakeText(rng, rng.Range(4, 40));
+   const std::wstring sGenre = MakeText(rng, rng.Range(3, 12));
+   const unsigned int iUsed = sTitle.size() + sArtist.size() + sAlbum.size() + sGenre.size();
+
+   TagLib::Tag* pTag = file.GetFile()->tag();
+   pTag->setTitle(sTitle);
+   pTag->setArtist(sArtist);
+   pTag->setAlbum(sAlbum);
+   pTag->setGenre(sGenre);
+   pTag->setComment(MakeText(rng, iTagSize > iUsed ? iTagSize - iUsed : 0));
+   pTag->setYear(rng.Range(1950, 2014));
+   pTag->setTrack(rng.Range(1, 20));
+
+   if (opts.m_PictureSize)
+      AddPicture(file, MakePicture(rng, opts.m_PictureSize));
+
+   return file.GetFile()->save();
+}
+
+bool ParseOptions(int argc, char* argv[], options& opts)
+{
+   for (int i = 2; i < argc; ++i)
+   {
+      if (i + 1 >= argc)
+         return false;
+
+      const int iValue = std::max(std::atoi(argv[i + 1]), 0);
+      if (!std::strcmp(argv[i], "--files"))
+         opts.m_Files = iValue;
+      else if (!std::strcmp(argv[i], "--tag-size"))
+         opts.m_TagSize = iValue;
+      else if (!std::strcmp(argv[i], "--picture-size"))
+         opts.m_PictureSize = iValue;
+      else if (!std::strcmp(argv[i], "--vbr-percent"))
+         opts.m_VbrPercent = iValue;
+      else if (!std::strcmp(argv[i], "--seed"))
+         opts.m_Seed = iValue;
+      else
+         return false;
+      ++i;
+   }
+   return true;
+}
+}
+
+int main(int argc, char* argv[])
+{
+   options opts;
+   if (argc < 2 || !ParseOptions(argc, argv, opts))
+   {
+      std::fprintf(stderr, "usage: %s <output directory> [--files N] [--tag-size N] [--picture-size N]"
+            " [--vbr-percent N] [--seed N]\n", argv[0]);
+      return 2;
+   }
+
+   // every file depends on the seed only, not on the files made before it
+   int iFailed = 0;
+   for (size_t i = 0; i < sizeof(Formats) / sizeof(Formats[0]); ++i)
+   {
+      for (int j = 0; j < opts.m_Files; ++j)
+      {
+         char szName[32];
+         std::snprintf(szName, sizeof(szName), "/%s_%03d.%s", Formats[i].m_Extension, j, Formats[i].m_Extension);
+         random_generator rng(opts.m_Seed * 2654435761u + (unsigned int) (i * 1000 + j));
+         const std::string sFileName = argv[1] + std::string(szName);
+         if (!MakeFile(sFileName, Formats[i].m_Format, rng, opts))
+         {
+            std::fprintf(stderr, "cannot make %s\n", sFileName.c_str());
+            ++iFailed;
+         }
+      }
+   }
+
+   std::printf("%d files made, %d failed\n", (int) (sizeof(Formats) / sizeof(Formats[0])) * opts.m_Files - iFailed,
+         iFailed);
+   return iFailed ? 1 : 0;
+}
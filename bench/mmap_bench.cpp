@@ -0,0 +1,196 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// Parses every file of a directory as the plugin does, through TagLib's
+// FileStream and through the memory-mapped stream, and prints per format
+// the reads of the stream, the read system calls (syscr of /proc/self/io)
+// and the wall time per file, with warm OS cache.
+//
+// usage: mmap_bench <corpus directory> [passes]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <tag.h>
+#include <tfilestream.h>
+
+#include "duration.h"
+#include "formats.h"
+#include "stream.h"
+#include "utils.h"
+
+namespace
+{
+
+typedef std::vector<std::wstring> files_t;
+
+enum stream_mode_t
+{
+   modeFileStream,
+   modeMapped,
+   modeCount
+};
+
+const unsigned long long MaxMappedSize = 0x7FFFFFFF;
+
+/// counts reads of the stream
+class counting_stream: public wdx::stream_wrapper
+{
+public:
+   counting_stream(TagLib::IOStream* pStream, unsigned long long& iReads) :
+         wdx::stream_wrapper(pStream), Reads_(iReads)
+   {
+   }
+
+   TagLib::ByteVector readBlock(TagLib::ulong length)
+   {
+      ++Reads_;
+      return wdx::stream_wrapper::readBlock(length);
+   }
+
+private:
+   unsigned long long& Reads_;
+};
+
+struct format_counts
+{
+   unsigned int m_Files;
+   unsigned long long m_Reads[modeCount];
+   unsigned long long m_Syscalls[modeCount];
+   double m_Time[modeCount]; // microseconds
+};
+
+/// read system calls of the process so far, 0 if the kernel does not tell
+unsigned long long GetReadSyscalls()
+{
+   std::ifstream io("/proc/self/io");
+   std::string sKey;
+   unsigned long long iValue;
+   while (io >> sKey >> iValue)
+   {
+      if ("syscr:" == sKey)
+         return iValue;
+   }
+   return 0;
+}
+
+/// parses tags, audio properties and the property map like the plugin does
+void ParseFile(const std::wstring& sFileName, TagLib::IOStream* pStream)
+{
+   const wdx::audio_file file(sFileName, pStream, true, TagLib::AudioProperties::Average);
+   if (!file.IsValid())
+      return;
+
+   if (TagLib::Tag* tag = file.GetFile()->tag())
+      tag->title();
+   if (wdx::fmtMPEG == file.GetFormat())
+   {
+      wdx::mpeg_duration duration;
+      wdx::GetMPEGDuration(file.GetStream(), wdx::scanIfVBR, duration);
+   }
+   file.GetFile()->properties();
+}
+
+TagLib::IOStream* OpenStream(const std::wstring& sFileName, const stream_mode_t mode)
+{
+   if (modeMapped == mode)
+      return new wdx::mapped_stream(sFileName, MaxMappedSize);
+   return new TagLib::FileStream(utils::GetNativePath(sFileName).c_str(), true);
+}
+}
+
+int main(int argc, char* argv[])
+{
+   if (argc < 2)
+   {
+      std::fprintf(stderr, "usage: %s <corpus directory> [passes]\n", argv[0]);
+      return 2;
+   }
+
+   const int iPasses = argc > 2 ? std::max(std::atoi(argv[2]), 1) : 3;
+   const std::string sDir(argv[1]);
+
+   files_t listing;
+   utils::ListDirectory(std::wstring(sDir.begin(), sDir.end()), listing);
+   files_t files;
+   for (const std::wstring& sFileName : listing)
+   {
+      if (wdx::IsSupportedFile(sFileName))
+         files.push_back(sFileName);
+   }
+   std::sort(files.begin(), files.end());
+
+   if (files.empty())
+   {
+      std::fprintf(stderr, "no supported files in %s\n", sDir.c_str());
+      return 1;
+   }
+
+   // reading /proc/self/io takes system calls itself
+   const unsigned long long iProbe = GetReadSyscalls();
+   const unsigned long long iOverhead = GetReadSyscalls() - iProbe;
+
+   // the first pass warms the OS cache and is not counted
+   std::vector<format_counts> counts(wdx::fmtCount, format_counts());
+   for (int iPass = 0; iPass <= iPasses; ++iPass)
+   {
+      for (const std::wstring& sFileName : files)
+      {
+         format_counts& result = counts[wdx::GetFormatByExtension(sFileName)];
+         if (iPass > 0)
+            ++result.m_Files;
+         for (int i = 0; i < modeCount; ++i)
+         {
+            unsigned long long iReads = 0;
+            const unsigned long long iBefore = GetReadSyscalls();
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            ParseFile(sFileName, new counting_stream(OpenStream(sFileName, (stream_mode_t) i), iReads));
+            const std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now();
+            const unsigned long long iAfter = GetReadSyscalls();
+            if (0 == iPass)
+               continue;
+
+            result.m_Reads[i] += iReads;
+            result.m_Syscalls[i] += iAfter - iBefore > iOverhead ? iAfter - iBefore - iOverhead : 0;
+            result.m_Time[i] += std::chrono::duration<double, std::micro>(stop - start).count();
+         }
+      }
+   }
+
+   std::printf("%u files, %d passes, averages per file, times in microseconds\n", (unsigned) files.size(),
+         iPasses);
+   std::printf("%-12s %6s | %9s %9s %9s | %9s %9s %9s\n", "format", "files", "reads", "syscalls", "time",
+         "mapped", "syscalls", "time");
+   for (int i = 0; i < wdx::fmtCount; ++i)
+   {
+      const format_counts& result = counts[i];
+      if (!result.m_Files)
+         continue;
+      std::printf("%-12s %6u | %9.1f %9.1f %9.1f | %9.1f %9.1f %9.1f\n", wdx::GetFormatName((wdx::format_t) i),
+            result.m_Files / iPasses,
+            (double) result.m_Reads[modeFileStream] / result.m_Files,
+            (double) result.m_Syscalls[modeFileStream] / result.m_Files,
+            result.m_Time[modeFileStream] / result.m_Files,
+            (double) result.m_Reads[modeMapped] / result.m_Files,
+            (double) result.m_Syscalls[modeMapped] / result.m_Files,
+            result.m_Time[modeMapped] / result.m_Files);
+   }
+   return 0;
+}
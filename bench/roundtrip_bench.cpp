@@ -0,0 +1,147 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// Counts reads of the file, each a round trip to the server on a network
+// share, per file of every format while tags and audio properties are parsed
+// as the plugin does, directly and through the head and tail read windows.
+//
+// usage: roundtrip_bench <corpus directory> [head KB] [tail KB]
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <tag.h>
+#include <tfilestream.h>
+
+#include "duration.h"
+#include "formats.h"
+#include "stream.h"
+#include "utils.h"
+
+namespace
+{
+
+typedef std::vector<std::wstring> files_t;
+
+/// counts reads passed to the file
+class counting_stream: public wdx::stream_wrapper
+{
+public:
+   counting_stream(TagLib::IOStream* pStream, unsigned long long& iReads, unsigned long long& iBytes) :
+         wdx::stream_wrapper(pStream), Reads_(iReads), Bytes_(iBytes)
+   {
+   }
+
+   TagLib::ByteVector readBlock(TagLib::ulong length)
+   {
+      const TagLib::ByteVector data = wdx::stream_wrapper::readBlock(length);
+      ++Reads_;
+      Bytes_ += data.size();
+      return data;
+   }
+
+private:
+   unsigned long long& Reads_;
+   unsigned long long& Bytes_;
+};
+
+struct format_counts
+{
+   unsigned int m_Files;
+   unsigned long long m_Reads[2]; // direct, windowed
+   unsigned long long m_Bytes[2];
+};
+
+/// parses tags, audio properties and the property map like the plugin does
+void ParseFile(const std::wstring& sFileName, TagLib::IOStream* pStream)
+{
+   const wdx::audio_file file(sFileName, pStream, true, TagLib::AudioProperties::Average);
+   if (!file.IsValid())
+      return;
+
+   if (TagLib::Tag* tag = file.GetFile()->tag())
+      tag->title();
+   if (wdx::fmtMPEG == file.GetFormat())
+   {
+      wdx::mpeg_duration duration;
+      wdx::GetMPEGDuration(file.GetStream(), wdx::scanIfVBR, duration);
+   }
+   file.GetFile()->properties();
+}
+}
+
+int main(int argc, char* argv[])
+{
+   if (argc < 2)
+   {
+      std::fprintf(stderr, "usage: %s <corpus directory> [head KB] [tail KB]\n", argv[0]);
+      return 2;
+   }
+
+   const std::string sDir(argv[1]);
+   const wdx::read_windows windows((unsigned int) std::max(argc > 2 ? std::atoi(argv[2]) : 128, 0) * 1024,
+         (unsigned int) std::max(argc > 3 ? std::atoi(argv[3]) : 16, 0) * 1024);
+
+   files_t listing;
+   utils::ListDirectory(std::wstring(sDir.begin(), sDir.end()), listing);
+   files_t files;
+   for (const std::wstring& sFileName : listing)
+   {
+      if (wdx::IsSupportedFile(sFileName))
+         files.push_back(sFileName);
+   }
+   std::sort(files.begin(), files.end());
+
+   if (files.empty())
+   {
+      std::fprintf(stderr, "no supported files in %s\n", sDir.c_str());
+      return 1;
+   }
+
+   std::vector<format_counts> counts(wdx::fmtCount, format_counts());
+   for (const std::wstring& sFileName : files)
+   {
+      // formats without tags at both ends are opened directly by the plugin too
+      const wdx::format_t format = wdx::GetFormatByExtension(sFileName);
+      format_counts& result = counts[format];
+      ++result.m_Files;
+      for (int i = 0; i < 2; ++i)
+      {
+         TagLib::IOStream* pStream = new counting_stream(
+               new TagLib::FileStream(utils::GetNativePath(sFileName).c_str(), true), result.m_Reads[i],
+               result.m_Bytes[i]);
+         if (1 == i && wdx::HasTagsAtEnds(format))
+            pStream = new wdx::windowed_stream(pStream, windows);
+         ParseFile(sFileName, pStream);
+      }
+   }
+
+   std::printf("%u files, head %u KB, tail %u KB, averages per file\n", (unsigned) files.size(),
+         windows.m_Head / 1024, windows.m_Tail / 1024);
+   std::printf("%-12s %6s | %9s %12s | %9s %12s\n", "format", "files", "reads", "bytes", "windowed", "bytes");
+   for (int i = 0; i < wdx::fmtCount; ++i)
+   {
+      const format_counts& result = counts[i];
+      if (!result.m_Files)
+         continue;
+      std::printf("%-12s %6u | %9.1f %12.0f | %9.1f %12.0f\n", wdx::GetFormatName((wdx::format_t) i),
+            result.m_Files, (double) result.m_Reads[0] / result.m_Files, (double) result.m_Bytes[0] / result.m_Files,
+            (double) result.m_Reads[1] / result.m_Files, (double) result.m_Bytes[1] / result.m_Files);
+   }
+   return 0;
+}
@@ -0,0 +1,160 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// Checks that the SSE2 and AVX2 MPEG frame header searches find the same
+// offsets as the scalar one and measures their speed, then finds the length
+// of an MP3 stream behind 3 MB of junk with every scan policy. Fails if a
+// search differs or the length is wrong.
+//
+// usage: sync_bench [random buffers]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include <tbytevector.h>
+#include <tbytevectorstream.h>
+
+#include "duration.h"
+#include "sync.h"
+
+namespace
+{
+
+const wdx::sync_version_t Versions[] = { wdx::syncScalar, wdx::syncSSE2, wdx::syncAVX2 };
+const char* const VersionNames[] = { "scalar", "SSE2", "AVX2" };
+const int VersionCount = sizeof(Versions) / sizeof(Versions[0]);
+
+// MPEG-1 Layer III, 128 kbit/s, 44100 Hz, mono
+const unsigned char FrameHeader[] = { 0xFF, 0xFB, 0x90, 0xC0 };
+const long FrameSize = 144 * 128000 / 44100;
+const long SamplesPerFrame = 1152;
+
+/// random bytes with many sync bytes and header-like bytes after them
+void FillCandidates(std::mt19937& rng, std::vector<unsigned char>& buffer)
+{
+   for (unsigned char& c : buffer)
+   {
+      switch (rng() % 8)
+      {
+         case 0:
+            c = 0xFF;
+            break;
+         case 1:
+            c = (unsigned char) (0xE0 | (rng() & 0x1F));
+            break;
+         default:
+            c = (unsigned char) rng();
+            break;
+      }
+   }
+}
+
+bool CheckEquivalence(const int iBuffers)
+{
+   std::mt19937 rng(3);
+   std::vector<unsigned char> buffer(256);
+   for (int i = 0; i < iBuffers; ++i)
+   {
+      FillCandidates(rng, buffer);
+      const long iSize = (long) (rng() % buffer.size());
+      for (long iStart = 0; iStart < 3 && iStart < iSize; ++iStart)
+      {
+         long iExpected = 0;
+         wdx::FindFrameHeader(&buffer[iStart], iSize - iStart, wdx::syncScalar, iExpected);
+         for (int v = 1; v < VersionCount; ++v)
+         {
+            long iOffset = 0;
+            if (wdx::FindFrameHeader(&buffer[iStart], iSize - iStart, Versions[v], iOffset) && iOffset != iExpected)
+            {
+               std::printf("%s found %ld, scalar %ld (buffer %d, size %ld, start %ld)\n", VersionNames[v], iOffset,
+                     iExpected, i, iSize, iStart);
+               return false;
+            }
+         }
+      }
+   }
+   std::printf("%d random buffers: all versions agree\n", iBuffers);
+   return true;
+}
+
+void MeasureSpeed()
+{
+   // no sync byte is followed by a header-like byte, so the whole buffer is searched
+   std::mt19937 rng(5);
+   std::vector<unsigned char> junk(64 * 1024 * 1024);
+   for (size_t i = 0; i < junk.size(); ++i)
+      junk[i] = (0 == rng() % 64 && (0 == i || 0xFF != junk[i - 1])) ? 0xFF : (unsigned char) (rng() & 0x7F);
+
+   for (int v = 0; v < VersionCount; ++v)
+   {
+      long iOffset = 0;
+      const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      if (!wdx::FindFrameHeader(&junk[0], (long) junk.size(), Versions[v], iOffset))
+      {
+         std::printf("%-8s not available\n", VersionNames[v]);
+         continue;
+      }
+      const double fSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      std::printf("%-8s %8.0f MB/s\n", VersionNames[v], fSeconds > 0 ? junk.size() / fSeconds / (1024 * 1024) : 0);
+   }
+}
+
+bool CheckJunkPrefix()
+{
+   // random junk may hold sync words, frames are confirmed by the next one
+   const long iJunkSize = 3 * 1024 * 1024;
+   const long iFrames = 300;
+   std::mt19937 rng(1);
+   std::vector<char> data(iJunkSize + iFrames * FrameSize, 0);
+   for (long i = 0; i < iJunkSize; ++i)
+      data[i] = (char) rng();
+   for (long i = 0; i < iFrames; ++i)
+      std::copy(FrameHeader, FrameHeader + sizeof(FrameHeader), data.begin() + iJunkSize + i * FrameSize);
+
+   const TagLib::ByteVector file(&data[0], (unsigned int) data.size());
+   const wdx::scan_policy_t policies[] = { wdx::scanNever, wdx::scanIfVBR, wdx::scanAlways };
+   const char* const names[] = { "never", "if VBR", "always" };
+   const long long iExpected = iFrames * SamplesPerFrame * 1000LL / 44100;
+   bool bPassed = true;
+   for (int i = 0; i < 3; ++i)
+   {
+      TagLib::ByteVectorStream stream(file);
+      wdx::mpeg_duration duration;
+      const bool bFound = wdx::GetMPEGDuration(&stream, policies[i], duration);
+      // the estimate from the first frame counts the bytes, not the frames
+      const long long iError = duration.GetMilliseconds() - iExpected;
+      const bool bCorrect = bFound && 1 == duration.m_Channels && 44100 == duration.m_Samplerate
+            && (wdx::scanAlways == policies[i] ? 0 == iError : std::llabs(iError) <= iExpected / 100);
+      std::printf("3 MB junk, scan %-7s %6lld ms, expected %lld ms: %s\n", names[i], duration.GetMilliseconds(),
+            iExpected, bCorrect ? "ok" : "WRONG");
+      bPassed = bPassed && bCorrect;
+   }
+   return bPassed;
+}
+}
+
+int main(int argc, char* argv[])
+{
+   const int iBuffers = argc > 1 ? std::max(std::atoi(argv[1]), 1) : 200000;
+
+   const bool bEquivalent = CheckEquivalence(iBuffers);
+   MeasureSpeed();
+   const bool bJunk = CheckJunkPrefix();
+   return bEquivalent && bJunk ? 0 : 1;
+}
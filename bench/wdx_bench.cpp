@@ -0,0 +1,238 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Measures the plugin core the way Total Commander drives it: every field is
+// requested for every file of a directory, first with dropped OS file cache
+// and a new plugin instance (cold), then again from the same instance (warm).
+// Reports per field latency, files per second and peak memory use of the
+// cold and the warm passes.
+//
+// usage: wdx_bench <corpus directory> [passes]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "formats.h"
+#include "plugin.h"
+#include "utils.h"
+
+namespace
+{
+
+// same as TC passes for string fields
+const int MaxLen = 2048;
+
+struct latency
+{
+   double m_Mean;
+   double m_P50;
+   double m_P99;
+   double m_FilesPerSecond;
+};
+
+typedef std::vector<std::wstring> files_t;
+
+/// evicts file data from the OS cache, so the next read goes to the disk
+void DropFileCache(const files_t& files)
+{
+   for (const std::wstring& sFileName : files)
+   {
+      const int hFile = open(utils::GetNativePath(sFileName).c_str(), O_RDONLY);
+      if (-1 == hFile)
+         continue;
+      posix_fadvise(hFile, 0, 0, POSIX_FADV_DONTNEED);
+      close(hFile);
+   }
+}
+
+/// starts a new peak of the resident set size, false if the kernel does not
+/// allow it and the peak covers the whole run
+bool ResetPeakRss()
+{
+   std::ofstream file("/proc/self/clear_refs");
+   file << "5";
+   file.flush();
+   return file.good();
+}
+
+/// peak resident set size since the last reset, in kilobytes
+long GetPeakRss()
+{
+   std::ifstream file("/proc/self/status");
+   std::string sLine;
+   while (std::getline(file, sLine))
+   {
+      if (0 == sLine.compare(0, 6, "VmHWM:"))
+         return std::atol(sLine.c_str() + 6);
+   }
+
+   rusage usage;
+   getrusage(RUSAGE_SELF, &usage);
+   return usage.ru_maxrss;
+}
+
+latency Summarize(std::vector<double>& times)
+{
+   latency result = latency();
+   if (times.empty())
+      return result;
+
+   std::sort(times.begin(), times.end());
+   double fTotal = 0;
+   for (double fTime : times)
+      fTotal += fTime;
+
+   result.m_Mean = fTotal / times.size();
+   result.m_P50 = times[times.size() / 2];
+   result.m_P99 = times[std::min(times.size() - 1, times.size() * 99 / 100)];
+   result.m_FilesPerSecond = fTotal > 0 ? times.size() * 1e6 / fTotal : 0;
+   return result;
+}
+
+/// asks the field of every file, times in microseconds; files without the
+/// value are counted, not skipped
+void RunPass(wdx::plugin& inst, const files_t& files, const int iField, std::vector<double>& times,
+      int& iEmpty)
+{
+   std::vector<wchar_t> value(MaxLen / sizeof(wchar_t));
+   for (const std::wstring& sFileName : files)
+   {
+      const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      const int iResult = inst.GetValue(sFileName.c_str(), iField, 0, &value[0], MaxLen, 0);
+      const std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now();
+
+      times.push_back(std::chrono::duration<double, std::micro>(stop - start).count());
+      if (iResult <= 0)
+         ++iEmpty;
+   }
+}
+
+void PrintRow(const char* pszName, const latency& cold, const latency& warm, const int iEmpty,
+      const long iColdRss, const long iWarmRss)
+{
+   std::printf("%-20s %9.1f %9.1f %9.1f %9.0f | %9.1f %9.1f %9.1f %9.0f | %6d | %9ld %9ld\n", pszName,
+         cold.m_Mean, cold.m_P50, cold.m_P99, cold.m_FilesPerSecond,
+         warm.m_Mean, warm.m_P50, warm.m_P99, warm.m_FilesPerSecond, iEmpty, iColdRss, iWarmRss);
+}
+}
+
+int main(int argc, char* argv[])
+{
+   if (argc < 2)
+   {
+      std::fprintf(stderr, "usage: %s <corpus directory> [passes]\n", argv[0]);
+      return 2;
+   }
+
+   const int iPasses = argc > 2 ? std::max(std::atoi(argv[2]), 1) : 1;
+   const std::string sDir(argv[1]);
+
+   files_t listing;
+   utils::ListDirectory(std::wstring(sDir.begin(), sDir.end()), listing);
+   files_t files;
+   for (const std::wstring& sFileName : listing)
+   {
+      if (wdx::IsSupportedFile(sFileName))
+         files.push_back(sFileName);
+   }
+   std::sort(files.begin(), files.end());
+
+   if (files.empty())
+   {
+      std::fprintf(stderr, "no supported files in %s\n", sDir.c_str());
+      return 1;
+   }
+
+   // neither the persistent index nor prefetch, they would hide parsing
+   const std::string sIniName = sDir + "/wdx_bench.ini";
+   {
+      std::ofstream ini(sIniName.c_str());
+      ini << "[wdxtaglib]\nIndexSizeMB=0\nPrefetch=0\n";
+   }
+
+   // extra fields are listed only after the settings are read, as TC does
+   std::vector<std::string> names;
+   {
+      wdx::plugin inst;
+      inst.SetIniName(sIniName);
+      char szName[MaxLen];
+      char szUnits[MaxLen];
+      while (inst.GetSupportedField((int) names.size(), szName, szUnits, MaxLen) != ft_nomorefields)
+         names.push_back(szName);
+   }
+
+   std::printf("%u files, %u fields, %d passes, times in microseconds\n", (unsigned) files.size(),
+         (unsigned) names.size(), iPasses);
+   if (!ResetPeakRss())
+      std::printf("peak RSS can not be reset, it covers all passes before\n");
+   std::printf("%-20s %9s %9s %9s %9s | %9s %9s %9s %9s | %6s | %9s %9s\n", "field", "cold mean", "p50", "p99",
+         "files/s", "warm mean", "p50", "p99", "files/s", "empty", "cold KB", "warm KB");
+
+   std::vector<double> coldAll;
+   std::vector<double> warmAll;
+   int iEmptyAll = 0;
+   long iColdRssAll = 0;
+   long iWarmRssAll = 0;
+   for (int iField = 0; iField < (int) names.size(); ++iField)
+   {
+      std::vector<double> cold;
+      std::vector<double> warm;
+      int iEmpty = 0;
+      long iColdRss = 0;
+      long iWarmRss = 0;
+      for (int i = 0; i < iPasses; ++i)
+      {
+         // fresh instance has empty metadata cache
+         wdx::plugin inst;
+         inst.SetIniName(sIniName);
+         char szName[MaxLen];
+         char szUnits[MaxLen];
+         inst.GetSupportedField(iField, szName, szUnits, MaxLen);
+
+         DropFileCache(files);
+         ResetPeakRss();
+         RunPass(inst, files, iField, cold, iEmpty);
+         iColdRss = std::max(iColdRss, GetPeakRss());
+
+         ResetPeakRss();
+         int iWarmEmpty = 0;
+         RunPass(inst, files, iField, warm, iWarmEmpty);
+         iWarmRss = std::max(iWarmRss, GetPeakRss());
+      }
+
+      coldAll.insert(coldAll.end(), cold.begin(), cold.end());
+      warmAll.insert(warmAll.end(), warm.begin(), warm.end());
+      iEmptyAll += iEmpty;
+      iColdRssAll = std::max(iColdRssAll, iColdRss);
+      iWarmRssAll = std::max(iWarmRssAll, iWarmRss);
+      PrintRow(names[iField].c_str(), Summarize(cold), Summarize(warm), iEmpty / iPasses, iColdRss, iWarmRss);
+   }
+
+   PrintRow("all fields", Summarize(coldAll), Summarize(warmAll), iEmptyAll / iPasses, iColdRssAll, iWarmRssAll);
+
+   std::remove(sIniName.c_str());
+   return 0;
+}
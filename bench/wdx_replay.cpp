@@ -0,0 +1,282 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Replays a trace of Total Commander calls recorded by the plugin (see the
+// TraceFile setting) against the plugin core and reports latency of every
+// kind of call, next to the latency recorded in the user session. Results
+// which differ from the recorded ones are counted, so a trace can serve
+// as a regression test.
+//
+// usage: wdx_replay <trace file> [--ini <settings file>] [--map <from>=<to>]... [--edits]
+//   --map     replaces the beginning of recorded paths, e.g. "C:\Music\=/data/music/"
+//   --edits   replays SetValue calls too, files are changed then
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "plugin.h"
+#include "trace.h"
+
+namespace
+{
+
+const int MaxLen = 2048;
+
+struct options
+{
+   std::string m_TraceName;
+   std::string m_IniName;
+   std::vector<std::pair<std::wstring, std::wstring> > m_Maps;
+   bool m_Edits;
+
+   options() :
+         m_Edits(false)
+   {
+   }
+};
+
+struct timings
+{
+   std::vector<double> m_Recorded;
+   std::vector<double> m_Replayed;
+   int m_Mismatches;
+
+   timings() :
+         m_Mismatches(0)
+   {
+   }
+};
+
+std::wstring Widen(const std::string& sText)
+{
+   return std::wstring(sText.begin(), sText.end());
+}
+
+std::wstring MapFileName(const std::wstring& sFileName, const options& opts)
+{
+   std::wstring sResult(sFileName);
+   for (const std::pair<std::wstring, std::wstring>& map : opts.m_Maps)
+   {
+      if (sResult.compare(0, map.first.size(), map.first) == 0)
+      {
+         sResult = map.second + sResult.substr(map.first.size());
+         break;
+      }
+   }
+
+#ifndef _WIN32
+   std::replace(sResult.begin(), sResult.end(), L'\\', L'/');
+#endif
+   return sResult;
+}
+
+double Percentile(std::vector<double>& times, const int iPercent)
+{
+   if (times.empty())
+      return 0;
+   std::sort(times.begin(), times.end());
+   return times[std::min(times.size() - 1, times.size() * iPercent / 100)];
+}
+
+double Mean(const std::vector<double>& times)
+{
+   double fTotal = 0;
+   for (double fTime : times)
+      fTotal += fTime;
+   return times.empty() ? 0 : fTotal / times.size();
+}
+
+void PrintRow(const std::string& sName, timings& t)
+{
+   std::printf("%-28s %8u | %9.1f %9.1f | %9.1f %9.1f %9.1f | %6d\n", sName.c_str(), (unsigned) t.m_Replayed.size(),
+         Percentile(t.m_Recorded, 50), Percentile(t.m_Recorded, 99), Mean(t.m_Replayed),
+         Percentile(t.m_Replayed, 50), Percentile(t.m_Replayed, 99), t.m_Mismatches);
+}
+
+bool ParseOptions(int argc, char* argv[], options& opts)
+{
+   if (argc < 2)
+      return false;
+
+   opts.m_TraceName = argv[1];
+   for (int i = 2; i < argc; ++i)
+   {
+      if (!std::strcmp(argv[i], "--edits"))
+         opts.m_Edits = true;
+      else if (!std::strcmp(argv[i], "--ini") && i + 1 < argc)
+         opts.m_IniName = argv[++i];
+      else if (!std::strcmp(argv[i], "--map") && i + 1 < argc)
+      {
+         const std::string sMap(argv[++i]);
+         const std::string::size_type iEqual = sMap.find('=');
+         if (std::string::npos == iEqual)
+            return false;
+         opts.m_Maps.push_back(std::make_pair(Widen(sMap.substr(0, iEqual)), Widen(sMap.substr(iEqual + 1))));
+      }
+      else
+         return false;
+   }
+   return true;
+}
+
+const char* GetCallName(const int iCall)
+{
+   switch (iCall)
+   {
+      case wdx::callGetSupportedField:
+         return "GetSupportedField";
+      case wdx::callGetValue:
+         return "GetValue";
+      case wdx::callSetValue:
+         return "SetValue";
+      case wdx::callEndOfSetValue:
+         return "SetValue (end of batch)";
+      case wdx::callStopGetValue:
+         return "StopGetValue";
+      case wdx::callSendStateInformation:
+         return "SendStateInformation";
+      case wdx::callPluginUnloading:
+         return "PluginUnloading";
+      case wdx::callGetDefaultSortOrder:
+         return "GetDefaultSortOrder";
+      case wdx::callGetSupportedFieldFlags:
+         return "GetSupportedFieldFlags";
+      case wdx::callCompareFiles:
+         return "CompareFiles";
+      default:
+         return "unknown";
+   }
+}
+}
+
+int main(int argc, char* argv[])
+{
+   options opts;
+   if (!ParseOptions(argc, argv, opts))
+   {
+      std::fprintf(stderr, "usage: %s <trace file> [--ini <settings file>] [--map <from>=<to>]... [--edits]\n",
+            argv[0]);
+      return 2;
+   }
+
+   wdx::trace_reader reader;
+   if (!reader.Open(opts.m_TraceName))
+   {
+      std::fprintf(stderr, "cannot read trace %s\n", opts.m_TraceName.c_str());
+      return 1;
+   }
+
+   wdx::plugin inst;
+   if (!opts.m_IniName.empty())
+      inst.SetIniName(opts.m_IniName);
+
+   std::vector<std::string> fields;
+   char szName[MaxLen];
+   char szUnits[MaxLen];
+   while (inst.GetSupportedField((int) fields.size(), szName, szUnits, MaxLen) != ft_nomorefields)
+      fields.push_back(szName);
+
+   std::map<std::string, timings> stats;
+   // field values are sized for two byte characters of Windows
+   std::vector<char> value(MaxLen * sizeof(wchar_t));
+   int iRecords = 0;
+   int iSkipped = 0;
+   int iMismatches = 0;
+
+   wdx::trace_record record;
+   while (reader.Read(record))
+   {
+      ++iRecords;
+      const std::wstring sFileName = MapFileName(record.m_FileName, opts);
+      const bool bEdit = wdx::callSetValue == record.m_Call || wdx::callEndOfSetValue == record.m_Call;
+      if (bEdit && !opts.m_Edits)
+      {
+         ++iSkipped;
+         continue;
+      }
+
+      int iResult = record.m_Result;
+      const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      switch (record.m_Call)
+      {
+         case wdx::callGetSupportedField:
+            iResult = inst.GetSupportedField(record.m_FieldIndex, szName, szUnits, MaxLen);
+            break;
+         case wdx::callGetDefaultSortOrder:
+            iResult = inst.GetDefaultSortOrder(record.m_FieldIndex);
+            break;
+         case wdx::callGetSupportedFieldFlags:
+            iResult = inst.GetSupportedFieldFlags(record.m_FieldIndex);
+            break;
+         case wdx::callCompareFiles:
+            iResult = inst.CompareFiles(nullptr, record.m_FieldIndex, sFileName.c_str(),
+                  MapFileName(record.m_FileName2, opts).c_str());
+            break;
+         case wdx::callGetValue:
+            {
+            const int iMaxLen = std::min<int>(record.m_MaxLen / 2 * sizeof(wchar_t), value.size());
+            iResult = inst.GetValue(sFileName.c_str(), record.m_FieldIndex, record.m_UnitIndex, &value[0], iMaxLen,
+                  record.m_Flags);
+            break;
+         }
+         case wdx::callSetValue:
+            iResult = inst.SetValue(sFileName.c_str(), record.m_FieldIndex, record.m_UnitIndex, record.m_FieldType,
+                  record.m_Value.empty() ? nullptr : &record.m_Value[0], record.m_Flags);
+            break;
+         case wdx::callEndOfSetValue:
+            iResult = inst.SetValue(nullptr, -1, 0, 0, nullptr, 0);
+            break;
+         case wdx::callStopGetValue:
+            inst.StopGetValue(sFileName.c_str());
+            break;
+         case wdx::callSendStateInformation:
+            inst.SendStateInformation(record.m_FieldIndex, sFileName.c_str());
+            break;
+         case wdx::callPluginUnloading:
+            inst.PluginUnloading();
+            break;
+      }
+      const std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now();
+
+      std::string sName = GetCallName(record.m_Call);
+      if (wdx::callGetValue == record.m_Call && record.m_FieldIndex >= 0 && record.m_FieldIndex < (int) fields.size())
+         sName += " " + fields[record.m_FieldIndex];
+
+      timings& t = stats[sName];
+      t.m_Recorded.push_back(record.m_Duration);
+      t.m_Replayed.push_back(std::chrono::duration<double, std::micro>(stop - start).count());
+      if (iResult != record.m_Result)
+      {
+         ++t.m_Mismatches;
+         ++iMismatches;
+      }
+   }
+
+   std::printf("%d calls replayed, %d edits skipped, %d results differ, times in microseconds\n",
+         iRecords - iSkipped, iSkipped, iMismatches);
+   std::printf("%-28s %8s | %9s %9s | %9s %9s %9s | %6s\n", "call", "count", "rec p50", "rec p99", "mean", "p50",
+         "p99", "differ");
+   for (std::map<std::string, timings>::iterator iter = stats.begin(); iter != stats.end(); ++iter)
+      PrintRow(iter->first, iter->second);
+
+   return 0;
+}
@@ -45,6 +45,11 @@ void base::SetIniName(const std::string& sIniName)
    if (sIniName == IniName_)
       return;
    IniName_ = sIniName;
+   OnLoadSettings();
+}
+
+void base::OnLoadSettings()
+{
 }
 
 const std::string& base::GetIniName() const
@@ -62,18 +67,14 @@ int base::GetSupportedField(const int iFieldIndex, char* pszFieldName, char* psz
 {
    try
    {
-      if(!fields_.size())
-      {
-         OnInitFields();
-      }
-      if (iFieldIndex < 0 || iFieldIndex >= (int) fields_.size())
+      if (iFieldIndex < 0 || iFieldIndex >= OnGetFieldCount())
       {
          return ft_nomorefields;
       }
 
-      const field& field = fields_[iFieldIndex];
-      utils::strlcpy(pszFieldName, field.m_Name.c_str(), iMaxLen - 1);
-      utils::strlcpy(pszUnits, field.m_MultChoice.c_str(), iMaxLen - 1);
+      const field field = OnGetField(iFieldIndex);
+      utils::strlcpy(pszFieldName, field.m_Name, iMaxLen - 1);
+      utils::strlcpy(pszUnits, field.m_Type == ft_multiplechoice ? field.m_MultChoice : field.m_Unit, iMaxLen - 1);
       // must not return ft_stringw in this function, see wdx plugin specs
       return field.m_Type == ft_stringw ? ft_string : field.m_Type;
    }
@@ -92,10 +93,13 @@ int base::GetValue(const wchar_t* pszFileName, const int iFieldIndex,
       if (iUnitIndex < 0)
          utils::ShowError(utils::Int2Str(iUnitIndex));
 
-      if (iFieldIndex < 0 || iFieldIndex >= (int) fields_.size())
+      if (iFieldIndex < 0 || iFieldIndex >= OnGetFieldCount())
          return ft_nosuchfield;
 
-      return OnGetValue(pszFileName, iFieldIndex, iUnitIndex, pFieldValue, iMaxLen, iFlags);
+      // reused by the calls of a thread, so cached values are served without allocations
+      static thread_local std::wstring sFileName;
+      sFileName.assign(pszFileName);
+      return OnGetValue(sFileName, iFieldIndex, iUnitIndex, pFieldValue, iMaxLen, iFlags);
    }
    catch (...)
    {
@@ -115,7 +119,7 @@ int base::SetValue(const wchar_t* FileName, const int FieldIndex,
          return ft_setsuccess;
       }
 
-      if (FieldIndex < 0 || FieldIndex >= (int) fields_.size())
+      if (FieldIndex < 0 || FieldIndex >= OnGetFieldCount())
          return ft_nosuchfield;
 
       return OnSetValue(FileName, FieldIndex, UnitIndex, FieldType, FieldValue, flags);
@@ -140,20 +144,18 @@ int base::GetSupportedFieldFlags(const int iFieldIndex)
       if (-1 == iFieldIndex) // we should return a combination of all supported flags here
       {
          int iTotalFlags = 0;
-         for (const fields_t::value_type& pair : fields_)
+         const int iCount = OnGetFieldCount();
+         for (int i = 0; i < iCount; ++i)
          {
-            if (pair.second.m_Flag)
-            {
-               iTotalFlags |= pair.second.m_Flag;
-            }
+            iTotalFlags |= OnGetField(i).m_Flag;
          }
          return iTotalFlags;
       }
 
-      if (iFieldIndex < 0 || iFieldIndex >= (int) fields_.size())
+      if (iFieldIndex < 0 || iFieldIndex >= OnGetFieldCount())
          return ft_nomorefields;
 
-      return fields_[iFieldIndex].m_Flag;
+      return OnGetField(iFieldIndex).m_Flag;
    }
    catch (...)
    {
@@ -166,6 +168,100 @@ void base::OnEndOfSetValue()
 {
 }
 
+int base::GetDefaultSortOrder(const int iFieldIndex)
+{
+   try
+   {
+      return OnGetDefaultSortOrder(iFieldIndex);
+   }
+   catch (...)
+   {
+      ExceptionHandler();
+      return 1;
+   }
+}
+
+int base::OnGetDefaultSortOrder(const int iFieldIndex)
+{
+   return 1;
+}
+
+int base::CompareFiles(PROGRESSCALLBACKPROC progress, const int iCompareIndex, const wchar_t* pszFileName1,
+      const wchar_t* pszFileName2)
+{
+   try
+   {
+      if (!pszFileName1 || !pszFileName2)
+         return compareFileError;
+
+      if (iCompareIndex < 0 || iCompareIndex >= OnGetFieldCount()
+            || ft_comparecontent != OnGetField(iCompareIndex).m_Type)
+         return compareNotSupported;
+
+      return OnCompareFiles(progress, iCompareIndex, pszFileName1, pszFileName2);
+   }
+   catch (...)
+   {
+      ExceptionHandler();
+      return compareFileError;
+   }
+}
+
+int base::OnCompareFiles(PROGRESSCALLBACKPROC progress, const int iCompareIndex, const std::wstring& sFileName1,
+      const std::wstring& sFileName2)
+{
+   return compareNotSupported;
+}
+
+void base::StopGetValue(const wchar_t* pszFileName)
+{
+   try
+   {
+      if (pszFileName)
+         OnStopGetValue(pszFileName);
+   }
+   catch (...)
+   {
+      ExceptionHandler();
+   }
+}
+
+void base::OnStopGetValue(const std::wstring& sFileName)
+{
+}
+
+void base::SendStateInformation(const int iState, const wchar_t* pszPath)
+{
+   try
+   {
+      OnSendStateInformation(iState, pszPath ? pszPath : L"");
+   }
+   catch (...)
+   {
+      ExceptionHandler();
+   }
+}
+
+void base::OnSendStateInformation(const int iState, const std::wstring& sPath)
+{
+}
+
+void base::PluginUnloading()
+{
+   try
+   {
+      OnPluginUnloading();
+   }
+   catch (...)
+   {
+      ExceptionHandler();
+   }
+}
+
+void base::OnPluginUnloading()
+{
+}
+
 void base::ExceptionHandler() const
 {
    try
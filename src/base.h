@@ -17,35 +17,39 @@
 
 #pragma once
 
-#include <map>
 #include <string>
-#include <windows.h>
+#include "compat.h"
 #include "contentplug.h"
 
 namespace wdx
 {
 
+/// field as listed to TC, names point to storage which lives as long as the plugin
 struct field
 {
-   std::string m_Name;
+   const char* m_Name;
    int m_Type;
-   std::string m_Unit;
-   std::string m_MultChoice;
    int m_Flag;
+   const char* m_Unit;
+   const char* m_MultChoice;
 
-   field() :
-         m_Type(0), m_Flag(0)
-   {
-   }
-
-   field(const std::string& sName, const int iType, const int iFlag = 0, const std::string& sUnit = std::string(),
-         const std::string& sMultChoice = std::string()) :
-         m_Name(sName), m_Type(iType), m_Unit(sUnit), m_MultChoice(sMultChoice), m_Flag(iFlag)
+   constexpr field(const char* pszName, const int iType, const int iFlag = 0, const char* pszUnit = "",
+         const char* pszMultChoice = "") :
+         m_Name(pszName), m_Type(iType), m_Flag(iFlag), m_Unit(pszUnit), m_MultChoice(pszMultChoice)
    {
    }
 };
 
-typedef std::map<int, field> fields_t;
+/// results of ContentCompareFiles
+enum compare_result_t
+{
+   compareNotSupported = -3, // TC compares the files itself
+   compareFileError = -2,
+   compareAborted = -1,
+   compareDifferent = 0,
+   compareEqual = 1,
+   compareEqualContent = 2, // equal as defined by the compare function, not byte by byte
+};
 
 class base
 {
@@ -63,22 +67,37 @@ public:
    int SetValue(const wchar_t* pszFileName, const int iFieldIndex,
          const int iUnitIndex, const int iFieldType, const void* pFieldValue, const int iFlags);
    virtual int GetSupportedFieldFlags(const int iFieldIndex);
+   int GetDefaultSortOrder(const int iFieldIndex);
+   void StopGetValue(const wchar_t* pszFileName);
+   void SendStateInformation(const int iState, const wchar_t* pszPath);
+   void PluginUnloading();
+   int CompareFiles(PROGRESSCALLBACKPROC progress, const int iCompareIndex, const wchar_t* pszFileName1,
+         const wchar_t* pszFileName2);
 
 protected:
-   fields_t fields_;
    const std::string& GetIniName() const;
    const DWORD& GetInterfaceVersionHi() const;
    const DWORD& GetInterfaceVersionLow() const;
 
    void ExceptionHandler() const;
 
-   virtual void OnInitFields() = 0;
+   /// fields have indexes from 0 to the count, both are called for each request
+   virtual int OnGetFieldCount() const = 0;
+   virtual field OnGetField(const int iFieldIndex) const = 0;
    virtual int OnGetValue(const std::wstring& sFileName, const int iFieldIndex,
          const int iUnitIndex, void* pFieldValue, const int iMaxLen, const int iFlags) = 0;
    virtual int OnSetValue(const std::wstring& sFileName, const int iFieldIndex,
          const int iUnitIndex, const int iFieldType, const void* pFieldValue, const int iFlags);
    virtual std::string OnGetDetectString() const;
+   /// 1 for ascending, -1 for descending
+   virtual int OnGetDefaultSortOrder(const int iFieldIndex);
    virtual void OnEndOfSetValue();
+   virtual void OnLoadSettings();
+   virtual void OnStopGetValue(const std::wstring& sFileName);
+   virtual void OnSendStateInformation(const int iState, const std::wstring& sPath);
+   virtual void OnPluginUnloading();
+   virtual int OnCompareFiles(PROGRESSCALLBACKPROC progress, const int iCompareIndex, const std::wstring& sFileName1,
+         const std::wstring& sFileName2);
 
 private:
    std::string IniName_;
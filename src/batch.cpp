@@ -0,0 +1,169 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <system_error>
+#include <thread>
+
+#include "batch.h"
+#include "utils.h"
+
+namespace wdx
+{
+
+namespace
+{
+
+/// files of one volume which are still to be processed
+struct volume
+{
+   std::deque<size_t> m_Files;
+   int m_Running;
+
+   volume() :
+         m_Running(0)
+   {
+   }
+};
+
+/// shared state of the threads of a batch
+class batch_state
+{
+public:
+   batch_state(const std::vector<std::wstring>& files, const batch_job_t& job, const int iThreadsPerVolume) :
+         Files_(files), Job_(job), ThreadsPerVolume_(std::max(iThreadsPerVolume, 1)), Left_(files.size()),
+               Results_(files.size())
+   {
+      for (size_t i = 0; i < files.size(); ++i)
+         Volumes_[utils::GetVolumeName(files[i])].m_Files.push_back(i);
+   }
+
+   void WorkerProc()
+   {
+      std::unique_lock<std::mutex> lock(Mutex_);
+
+      while (Left_ > 0)
+      {
+         volume* pVolume = nullptr;
+         for (volumes_t::value_type& pair : Volumes_)
+         {
+            if (!pair.second.m_Files.empty() && pair.second.m_Running < ThreadsPerVolume_)
+            {
+               pVolume = &pair.second;
+               break;
+            }
+         }
+
+         // all volumes with files left are busy
+         if (!pVolume)
+         {
+            Changed_.wait(lock);
+            continue;
+         }
+
+         const size_t iFile = pVolume->m_Files.front();
+         pVolume->m_Files.pop_front();
+         pVolume->m_Running++;
+
+         lock.unlock();
+         Results_[iFile] = Run(Files_[iFile]);
+         lock.lock();
+
+         pVolume->m_Running--;
+         Left_--;
+         Changed_.notify_all();
+      }
+   }
+
+   void GetErrors(std::vector<batch_error>& errors) const
+   {
+      for (size_t i = 0; i < Files_.size(); ++i)
+      {
+         if (!Results_[i].empty())
+            errors.push_back(batch_error(Files_[i], Results_[i]));
+      }
+   }
+
+private:
+   typedef std::map<std::wstring, volume> volumes_t;
+
+   /// error text, empty on success
+   std::string Run(const std::wstring& sFileName) const
+   {
+      try
+      {
+         return Job_(sFileName) ? std::string() : std::string("Failed");
+      }
+      catch (const std::exception& e)
+      {
+         return e.what();
+      }
+      catch (...)
+      {
+         return "Unknown exception";
+      }
+   }
+
+   const std::vector<std::wstring>& Files_;
+   const batch_job_t& Job_;
+   const int ThreadsPerVolume_;
+
+   std::mutex Mutex_;
+   std::condition_variable Changed_;
+   volumes_t Volumes_;
+   size_t Left_; // files not processed yet, including running ones
+   std::vector<std::string> Results_;
+};
+}
+
+void RunBatch(const std::vector<std::wstring>& files, const batch_job_t& job,
+      const int iThreads, const int iThreadsPerVolume, std::vector<batch_error>& errors)
+{
+   if (files.empty())
+      return;
+
+   batch_state state(files, job, iThreadsPerVolume);
+
+   size_t iThreadCount = iThreads > 0 ? iThreads : std::max(std::thread::hardware_concurrency(), 2u);
+   iThreadCount = std::min(iThreadCount, files.size());
+
+   // calling thread is one of the workers
+   std::vector<std::thread> threads;
+   for (size_t i = 1; i < iThreadCount; ++i)
+   {
+      try
+      {
+         threads.push_back(std::thread(&batch_state::WorkerProc, &state));
+      }
+      catch (const std::system_error&)
+      {
+         break; // continue with the threads started so far
+      }
+   }
+   state.WorkerProc();
+
+   for (std::thread& thread : threads)
+      thread.join();
+
+   state.GetErrors(errors);
+}
+
+}
@@ -0,0 +1,48 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace wdx
+{
+
+/// failure of a single file of a batch
+struct batch_error
+{
+   std::wstring m_FileName;
+   std::string m_Text;
+
+   batch_error(const std::wstring& sFileName, const std::string& sText) :
+         m_FileName(sFileName), m_Text(sText)
+   {
+   }
+};
+
+/// job returns false or throws if the file could not be processed
+typedef std::function<bool(const std::wstring&)> batch_job_t;
+
+/// runs the job for all files in parallel and waits for it to finish.
+/// Files on different volumes are processed independently, at most
+/// iThreadsPerVolume threads work on one volume to avoid disk seek storms,
+/// iThreads limits the total number of threads, 0 means number of cores.
+/// Failures are collected into errors in the order of files.
+void RunBatch(const std::vector<std::wstring>& files, const batch_job_t& job,
+      const int iThreads, const int iThreadsPerVolume, std::vector<batch_error>& errors);
+}
@@ -0,0 +1,111 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "cache.h"
+
+namespace wdx
+{
+
+cache::cache(const size_t iMaxBytes) :
+      MaxBytes_(iMaxBytes), UsedBytes_(0)
+{
+}
+
+void cache::SetMaxBytes(const size_t iMaxBytes)
+{
+   std::lock_guard<std::mutex> lock(Mutex_);
+   MaxBytes_ = iMaxBytes;
+   Shrink();
+}
+
+bool cache::Get(const std::wstring& sFileName, const utils::file_stamp& stamp, metadata_ptr& data)
+{
+   std::lock_guard<std::mutex> lock(Mutex_);
+
+   index_t::iterator iter = Index_.find(sFileName);
+   if (Index_.end() == iter)
+      return false;
+
+   // file was changed since it was parsed
+   if (iter->second->m_Stamp != stamp)
+   {
+      Erase(iter);
+      return false;
+   }
+
+   Entries_.splice(Entries_.begin(), Entries_, iter->second);
+   data = iter->second->m_Data;
+   return true;
+}
+
+void cache::Put(const std::wstring& sFileName, const utils::file_stamp& stamp, const metadata_ptr& data)
+{
+   std::lock_guard<std::mutex> lock(Mutex_);
+
+   index_t::iterator iter = Index_.find(sFileName);
+   if (Index_.end() != iter)
+      Erase(iter);
+
+   entry e;
+   e.m_FileName = sFileName;
+   e.m_Stamp = stamp;
+   e.m_Data = data;
+   // count the key twice: it is stored in the entry and in the index
+   e.m_Size = (data ? data->GetMemSize() : 0) + 2 * (sizeof(entry) + sFileName.capacity() * sizeof(wchar_t));
+
+   Entries_.push_front(e);
+   Index_[sFileName] = Entries_.begin();
+   UsedBytes_ += e.m_Size;
+
+   Shrink();
+}
+
+void cache::Remove(const std::wstring& sFileName)
+{
+   std::lock_guard<std::mutex> lock(Mutex_);
+
+   index_t::iterator iter = Index_.find(sFileName);
+   if (Index_.end() != iter)
+      Erase(iter);
+}
+
+void cache::Clear()
+{
+   std::lock_guard<std::mutex> lock(Mutex_);
+
+   Index_.clear();
+   Entries_.clear();
+   UsedBytes_ = 0;
+}
+
+void cache::Erase(const index_t::iterator& iter)
+{
+   UsedBytes_ -= iter->second->m_Size;
+   Entries_.erase(iter->second);
+   Index_.erase(iter);
+}
+
+void cache::Shrink()
+{
+   // evict least recently used entries, but always keep the newest one
+   while (UsedBytes_ > MaxBytes_ && Entries_.size() > 1)
+   {
+      Erase(Index_.find(Entries_.back().m_FileName));
+   }
+}
+
+}
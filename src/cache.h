@@ -0,0 +1,67 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "metadata.h"
+#include "utils.h"
+
+namespace wdx
+{
+
+/// in-memory LRU cache of parsed metadata, keyed by file name and validated
+/// by file size and last write time
+class cache
+{
+public:
+   explicit cache(const size_t iMaxBytes);
+
+   void SetMaxBytes(const size_t iMaxBytes);
+
+   /// looks for data of a file which was not changed since it was stored,
+   /// stored data is null if the file could not be parsed
+   bool Get(const std::wstring& sFileName, const utils::file_stamp& stamp, metadata_ptr& data);
+   void Put(const std::wstring& sFileName, const utils::file_stamp& stamp, const metadata_ptr& data);
+   void Remove(const std::wstring& sFileName);
+   void Clear();
+
+private:
+   struct entry
+   {
+      std::wstring m_FileName;
+      utils::file_stamp m_Stamp;
+      metadata_ptr m_Data;
+      size_t m_Size;
+   };
+
+   typedef std::list<entry> entries_t;
+   typedef std::unordered_map<std::wstring, entries_t::iterator> index_t;
+
+   void Erase(const index_t::iterator& iter);
+   void Shrink();
+
+   std::mutex Mutex_;
+   entries_t Entries_; // most recently used first
+   index_t Index_;
+   size_t MaxBytes_;
+   size_t UsedBytes_;
+};
+}
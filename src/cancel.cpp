@@ -0,0 +1,106 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "cancel.h"
+
+namespace wdx
+{
+
+cancellation::scope::scope(cancellation& owner, const std::wstring& sFileName) :
+      Owner_(owner), FileName_(sFileName), Token_(false)
+{
+   std::lock_guard<std::mutex> lock(Owner_.Mutex_);
+   Token_ = Owner_.Stopped_;
+   Owner_.Tokens_.insert(tokens_t::value_type(FileName_, &Token_));
+}
+
+cancellation::scope::~scope()
+{
+   std::lock_guard<std::mutex> lock(Owner_.Mutex_);
+
+   std::pair<tokens_t::iterator, tokens_t::iterator> range = Owner_.Tokens_.equal_range(FileName_);
+   for (tokens_t::iterator iter = range.first; iter != range.second; ++iter)
+   {
+      if (iter->second == &Token_)
+      {
+         Owner_.Tokens_.erase(iter);
+         break;
+      }
+   }
+   Owner_.Released_.notify_all();
+}
+
+const cancel_token& cancellation::scope::Token() const
+{
+   return Token_;
+}
+
+cancellation::cancellation() :
+      Stopped_(false)
+{
+}
+
+void cancellation::Cancel(const std::wstring& sFileName)
+{
+   std::lock_guard<std::mutex> lock(Mutex_);
+
+   std::pair<tokens_t::iterator, tokens_t::iterator> range = Tokens_.equal_range(sFileName);
+   for (tokens_t::iterator iter = range.first; iter != range.second; ++iter)
+   {
+      *iter->second = true;
+   }
+}
+
+void cancellation::Wait(const std::wstring& sFileName)
+{
+   std::unique_lock<std::mutex> lock(Mutex_);
+
+   while (IsCancelled(sFileName))
+   {
+      Released_.wait(lock);
+   }
+}
+
+void cancellation::CancelAll()
+{
+   std::lock_guard<std::mutex> lock(Mutex_);
+
+   Stopped_ = true;
+   for (tokens_t::iterator iter = Tokens_.begin(); iter != Tokens_.end(); ++iter)
+   {
+      *iter->second = true;
+   }
+}
+
+void cancellation::Resume()
+{
+   std::lock_guard<std::mutex> lock(Mutex_);
+   Stopped_ = false;
+}
+
+bool cancellation::IsCancelled(const std::wstring& sFileName) const
+{
+   std::pair<tokens_t::const_iterator, tokens_t::const_iterator> range = Tokens_.equal_range(sFileName);
+   for (tokens_t::const_iterator iter = range.first; iter != range.second; ++iter)
+   {
+      if (*iter->second)
+         return true;
+   }
+   return false;
+}
+
+}
@@ -0,0 +1,78 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace wdx
+{
+
+typedef std::atomic<bool> cancel_token;
+
+/// tokens of parses which are in progress, allows to stop them by file name
+class cancellation
+{
+public:
+   /// registers a token for the lifetime of the object
+   class scope
+   {
+   public:
+      scope(cancellation& owner, const std::wstring& sFileName);
+      ~scope();
+
+      const cancel_token& Token() const;
+
+   private:
+      scope(const scope&);
+      scope& operator=(const scope&);
+
+      cancellation& Owner_;
+      std::wstring FileName_;
+      cancel_token Token_;
+   };
+
+   cancellation();
+
+   /// signals all parses of the file to stop
+   void Cancel(const std::wstring& sFileName);
+
+   /// waits until the stopped parses of the file have ended
+   void Wait(const std::wstring& sFileName);
+
+   /// signals all parses to stop, parses started until Resume is called are
+   /// stopped at once
+   void CancelAll();
+
+   /// lets new parses run after CancelAll
+   void Resume();
+
+private:
+   typedef std::unordered_multimap<std::wstring, cancel_token*> tokens_t;
+
+   bool IsCancelled(const std::wstring& sFileName) const;
+
+   std::mutex Mutex_;
+   std::condition_variable Released_;
+   tokens_t Tokens_;
+   bool Stopped_;
+};
+}
@@ -0,0 +1,147 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "collate.h"
+#include "hash.h"
+
+namespace wdx
+{
+
+// base letters of U+00C0..U+017F, '.' for signs without one
+static const char LatinBase[] =
+      "aaaaaaaceeeeiiiidnooooo.ouuuuyts"
+      "aaaaaaaceeeeiiiidnooooo.ouuuuyty"
+      "aaaaaaccccccccddddeeeeeeeeeegggg"
+      "gggghhhhiiiiiiiiiiiijjkkklllllll"
+      "lllnnnnnnnnnoooooooorrrrrrssssss"
+      "ssttttttuuuuuuuuuuuuwwyyyzzzzzzs";
+
+static const wchar_t LatinFirst = 0xC0;
+static const wchar_t LatinLast = 0x17F;
+
+/// simple case folding of Latin, Greek and Cyrillic letters
+static wchar_t FoldCase(const wchar_t ch)
+{
+   if ((ch >= L'A' && ch <= L'Z') || (ch >= 0xC0 && ch <= 0xDE && ch != 0xD7))
+      return ch + 0x20;
+   // Latin Extended-A pairs upper and lower case letters
+   if (ch >= 0x100 && ch <= 0x137)
+      return ch | 1;
+   if ((ch >= 0x139 && ch <= 0x148) || (ch >= 0x179 && ch <= 0x17E))
+      return (ch & 1) ? ch + 1 : ch;
+   if (ch >= 0x14A && ch <= 0x177)
+      return ch | 1;
+   if (ch >= 0x391 && ch <= 0x3AB && ch != 0x3A2)
+      return ch + 0x20;
+   if (ch >= 0x410 && ch <= 0x42F)
+      return ch + 0x20;
+   if (ch >= 0x400 && ch <= 0x40F)
+      return ch + 0x50;
+   return ch;
+}
+
+static void AppendFolded(std::wstring& sKey, const wchar_t ch, const bool bFoldDiacritics)
+{
+   if (!bFoldDiacritics || ch < LatinFirst || ch > LatinLast || '.' == LatinBase[ch - LatinFirst])
+   {
+      sKey += FoldCase(ch);
+      return;
+   }
+
+   sKey += (wchar_t) LatinBase[ch - LatinFirst];
+   // ligatures sort as two letters
+   if (0xC6 == ch || 0xE6 == ch || 0x152 == ch || 0x153 == ch)
+      sKey += L'e';
+   else if (0xDF == ch)
+      sKey += L's';
+}
+
+collation::collation() :
+      FoldDiacritics_(true), Id_(0)
+{
+   UpdateId();
+}
+
+void collation::SetArticles(const std::string& sArticles)
+{
+   Articles_.clear();
+   ArticleList_ = sArticles;
+
+   std::string::size_type iBegin = 0;
+   while (iBegin <= sArticles.size())
+   {
+      std::string::size_type iEnd = sArticles.find('|', iBegin);
+      if (std::string::npos == iEnd)
+         iEnd = sArticles.size();
+
+      std::wstring sArticle;
+      for (std::string::size_type i = iBegin; i < iEnd; ++i)
+      {
+         if (sArticles[i] != ' ')
+            sArticle += FoldCase((wchar_t) (unsigned char) sArticles[i]);
+      }
+      if (!sArticle.empty())
+         Articles_.push_back(sArticle + L' ');
+      iBegin = iEnd + 1;
+   }
+
+   UpdateId();
+}
+
+void collation::SetFoldDiacritics(const bool bFold)
+{
+   FoldDiacritics_ = bFold;
+   UpdateId();
+}
+
+void collation::UpdateId()
+{
+   xxhash64 hash;
+   hash.Update(ArticleList_.data(), ArticleList_.size());
+   hash.Update(&FoldDiacritics_, sizeof(FoldDiacritics_));
+   // 0 is never used, it marks metadata without keys
+   Id_ = (unsigned int) hash.Digest() | 1;
+}
+
+std::wstring collation::GetKey(const std::wstring& sText) const
+{
+   std::wstring sKey;
+   sKey.reserve(sText.size());
+
+   // leading and repeated spaces do not count
+   for (const wchar_t ch : sText)
+   {
+      if (L' ' == ch || L'\t' == ch)
+      {
+         if (!sKey.empty() && L' ' != sKey[sKey.size() - 1])
+            sKey += L' ';
+      }
+      else
+         AppendFolded(sKey, ch, FoldDiacritics_);
+   }
+   if (!sKey.empty() && L' ' == sKey[sKey.size() - 1])
+      sKey.erase(sKey.size() - 1);
+
+   // "The Beatles" sorts as "Beatles", but "The" stays as it is
+   for (const std::wstring& sArticle : Articles_)
+   {
+      if (sKey.size() > sArticle.size() && 0 == sKey.compare(0, sArticle.size(), sArticle))
+         return sKey.substr(sArticle.size());
+   }
+   return sKey;
+}
+}
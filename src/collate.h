@@ -0,0 +1,54 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace wdx
+{
+
+/// builds sort keys of tag values: strings which sort by plain comparison
+/// the way people expect in a music library, case-insensitive, optionally
+/// without leading articles and diacritics
+class collation
+{
+public:
+   collation();
+
+   /// articles separated by |, as in "The|A"
+   void SetArticles(const std::string& sArticles);
+   void SetFoldDiacritics(const bool bFold);
+
+   std::wstring GetKey(const std::wstring& sText) const;
+
+   /// identifies the settings, keys built with other settings must be built again
+   unsigned int GetId() const
+   {
+      return Id_;
+   }
+
+private:
+   void UpdateId();
+
+   std::vector<std::wstring> Articles_; // case folded, followed by a space
+   bool FoldDiacritics_;
+   std::string ArticleList_;
+   unsigned int Id_;
+};
+}
@@ -0,0 +1,56 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#pragma once
+
+// The plugin is built for Windows only, but its core can be built natively
+// on other systems to run benchmarks. This header provides the few Windows
+// types used by the shared headers there.
+
+#ifdef _WIN32
+
+#include <windows.h>
+
+#else
+
+#include <stdint.h>
+#include <wchar.h>
+
+typedef int BOOL;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef unsigned int UINT;
+typedef wchar_t WCHAR;
+typedef void* HWND;
+typedef void* HANDLE;
+typedef int32_t __int32;
+typedef int64_t __int64;
+
+typedef struct _FILETIME
+{
+   DWORD dwLowDateTime;
+   DWORD dwHighDateTime;
+} FILETIME;
+
+#define FALSE 0
+#define TRUE 1
+#define MAX_PATH 260
+#define __stdcall
+
+/// same as wcslcpy of cunicode.h, which is not built here
+wchar_t* wcslcpy(wchar_t* str1, const wchar_t* str2, int imaxlen);
+
+#endif
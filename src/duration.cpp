@@ -0,0 +1,328 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cstring>
+#include <tbytevector.h>
+#include "duration.h"
+#include "formats.h"
+#include "payload.h"
+#include "sync.h"
+
+namespace wdx
+{
+
+// enough for the first frames, larger reads only when all frames are counted
+static const long HeaderBlockSize = 64 * 1024;
+static const long ScanBlockSize = 1024 * 1024;
+// frames compared to tell VBR files from CBR ones
+static const int VBRCheckFrames = 16;
+
+// kbit/s by MPEG 1 or 2, layer and index
+static const int Bitrates[2][3][16] =
+{
+   {
+      { 0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448, 0 },
+      { 0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 0 },
+      { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0 },
+   },
+   {
+      { 0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256, 0 },
+      { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0 },
+      { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0 },
+   },
+};
+
+// of MPEG 1, halved for MPEG 2 and quartered for MPEG 2.5
+static const int Samplerates[] = { 44100, 48000, 32000 };
+
+struct mpeg_frame
+{
+   int m_Version; // 1, 2 or 25 for MPEG 2.5
+   int m_Layer;
+   int m_Bitrate; // kbit/s
+   int m_Samplerate;
+   int m_Samples;
+   long m_Length; // bytes including the header
+   bool m_Mono;
+};
+
+static unsigned int ReadBE32(const unsigned char* p)
+{
+   return (unsigned int) p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+/// false if the four bytes are not a frame header, free format frames are not supported
+static bool ParseFrameHeader(const unsigned char* p, mpeg_frame& frame)
+{
+   if (0xFF != p[0] || 0xE0 != (p[1] & 0xE0))
+      return false;
+
+   const int iVersionBits = (p[1] >> 3) & 3;
+   const int iLayerBits = (p[1] >> 1) & 3;
+   const int iBitrateIndex = p[2] >> 4;
+   const int iSamplerateIndex = (p[2] >> 2) & 3;
+   if (1 == iVersionBits || 0 == iLayerBits || 0 == iBitrateIndex || 15 == iBitrateIndex || 3 == iSamplerateIndex)
+      return false;
+
+   frame.m_Version = 3 == iVersionBits ? 1 : 2 == iVersionBits ? 2 : 25;
+   frame.m_Layer = 4 - iLayerBits;
+   frame.m_Bitrate = Bitrates[1 == frame.m_Version ? 0 : 1][frame.m_Layer - 1][iBitrateIndex];
+   frame.m_Samplerate = Samplerates[iSamplerateIndex] / (1 == frame.m_Version ? 1 : 2 == frame.m_Version ? 2 : 4);
+   frame.m_Samples = 1 == frame.m_Layer ? 384 : 3 == frame.m_Layer && 1 != frame.m_Version ? 576 : 1152;
+   const int iPadding = (p[2] >> 1) & 1;
+   if (1 == frame.m_Layer)
+      frame.m_Length = (12L * frame.m_Bitrate * 1000 / frame.m_Samplerate + iPadding) * 4;
+   else
+      frame.m_Length = frame.m_Samples / 8L * frame.m_Bitrate * 1000 / frame.m_Samplerate + iPadding;
+   frame.m_Mono = 3 == (p[3] >> 6);
+   return true;
+}
+
+/// frames of one stream share version, layer and sample rate
+static bool IsSameStream(const mpeg_frame& frame, const mpeg_frame& other)
+{
+   return frame.m_Version == other.m_Version && frame.m_Layer == other.m_Layer
+         && frame.m_Samplerate == other.m_Samplerate;
+}
+
+/// reads the stream forward in blocks, up to the end of the frames
+class frame_reader
+{
+public:
+   frame_reader(TagLib::IOStream* pStream, const long iEnd, const long iBlockSize) :
+         Stream_(pStream), End_(iEnd), BlockSize_(iBlockSize), Offset_(0)
+   {
+   }
+
+   void SetBlockSize(const long iBlockSize)
+   {
+      BlockSize_ = iBlockSize;
+   }
+
+   /// iSize bytes at the offset, nullptr if fewer are left
+   const unsigned char* Get(const long iOffset, const long iSize)
+   {
+      if (iOffset < Offset_ || iOffset + iSize > Offset_ + (long) Data_.size())
+      {
+         if (iOffset < 0 || iOffset + iSize > End_)
+            return nullptr;
+         Stream_->seek(iOffset);
+         Data_ = Stream_->readBlock((TagLib::ulong) std::min(std::max(iSize, BlockSize_), End_ - iOffset));
+         Offset_ = iOffset;
+         if ((long) Data_.size() < iSize)
+            return nullptr;
+      }
+      return (const unsigned char*) Data_.data() + (iOffset - Offset_);
+   }
+
+   /// bytes available from the offset on without reading
+   long GetBuffered(const long iOffset) const
+   {
+      return Offset_ + (long) Data_.size() - iOffset;
+   }
+
+private:
+   TagLib::IOStream* Stream_;
+   long End_;
+   long BlockSize_;
+   TagLib::ByteVector Data_;
+   long Offset_;
+};
+
+/// offset of the first frame header at or after the position which is
+/// followed by a frame of the same stream or by the end, -1 if there is none
+/// in front of the limit
+static long FindFrame(frame_reader& reader, long iPos, const long iLimit, const long iEnd, mpeg_frame& frame)
+{
+   while (iPos < iLimit)
+   {
+      const unsigned char* p = reader.Get(iPos, 4);
+      if (!p)
+         return -1;
+
+      // candidates of the whole buffer are checked at once
+      const long iCount = std::min(reader.GetBuffered(iPos), iLimit - iPos + 3);
+      const long iFound = FindFrameHeader(p, iCount);
+      if (iFound < 0)
+      {
+         // the last three bytes may start a header
+         iPos += iCount - 3;
+         continue;
+      }
+
+      iPos += iFound;
+      p = reader.Get(iPos, 4);
+      if (p && ParseFrameHeader(p, frame))
+      {
+         const long iNext = iPos + frame.m_Length;
+         if (iNext == iEnd)
+            return iPos;
+         mpeg_frame next;
+         p = reader.Get(iNext, 4);
+         if (p && ParseFrameHeader(p, next) && IsSameStream(frame, next))
+            return iPos;
+      }
+      ++iPos;
+   }
+   return -1;
+}
+
+/// frame count of the Xing/Info header and samples the LAME header tells to
+/// drop, false if the frame has no such header
+static bool ReadXingHeader(const unsigned char* p, const mpeg_frame& frame, bool& bHasFrames, long long& iFrames,
+      long long& iDropped)
+{
+   if (3 != frame.m_Layer)
+      return false;
+
+   // behind the side information
+   long iPos = 4 + (1 == frame.m_Version ? (frame.m_Mono ? 17 : 32) : (frame.m_Mono ? 9 : 17));
+   if (iPos + 8 > frame.m_Length || (0 != std::memcmp(p + iPos, "Xing", 4) && 0 != std::memcmp(p + iPos, "Info", 4)))
+      return false;
+
+   const unsigned int iFlags = ReadBE32(p + iPos + 4);
+   iPos += 8;
+   bHasFrames = (iFlags & 1) && iPos + 4 <= frame.m_Length;
+   if (bHasFrames)
+   {
+      iFrames = ReadBE32(p + iPos);
+      iPos += 4;
+   }
+   // bytes, table of contents, quality
+   iPos += (iFlags & 2 ? 4 : 0) + (iFlags & 4 ? 100 : 0) + (iFlags & 8 ? 4 : 0);
+
+   // encoder delay and padding, 12 bits each
+   iDropped = 0;
+   if (iPos + 24 <= frame.m_Length && (0 == std::memcmp(p + iPos, "LAME", 4) || 0 == std::memcmp(p + iPos, "Lavc", 4)
+         || 0 == std::memcmp(p + iPos, "Lavf", 4)))
+      iDropped = (p[iPos + 21] << 4 | p[iPos + 22] >> 4) + ((p[iPos + 22] & 0x0F) << 8 | p[iPos + 23]);
+   return true;
+}
+
+/// frame count of the VBRI header, which is always 32 bytes behind the frame header
+static bool ReadVBRIHeader(const unsigned char* p, const mpeg_frame& frame, long long& iFrames)
+{
+   static const long iPos = 4 + 32;
+   if (iPos + 18 > frame.m_Length || 0 != std::memcmp(p + iPos, "VBRI", 4))
+      return false;
+   iFrames = ReadBE32(p + iPos + 14);
+   return true;
+}
+
+/// bitrate varies among the first frames
+static bool IsVBR(frame_reader& reader, long iPos, const mpeg_frame& first)
+{
+   mpeg_frame frame = first;
+   for (int i = 0; i < VBRCheckFrames; ++i)
+   {
+      iPos += frame.m_Length;
+      const unsigned char* p = reader.Get(iPos, 4);
+      if (!p || !ParseFrameHeader(p, frame))
+         return false;
+      if (frame.m_Bitrate != first.m_Bitrate)
+         return true;
+   }
+   return false;
+}
+
+/// counts samples of all frames, damaged parts are skipped up to the next confirmed frame
+static bool ScanFrames(frame_reader& reader, long iPos, const long iEnd, const mpeg_frame& first,
+      mpeg_duration& duration)
+{
+   long long iSamples = 0;
+   long iBytes = 0;
+   mpeg_frame frame;
+   while (iPos + 4 <= iEnd)
+   {
+      const unsigned char* p = reader.Get(iPos, 4);
+      if (!p)
+         break;
+
+      if (!ParseFrameHeader(p, frame) || !IsSameStream(first, frame) || iPos + frame.m_Length > iEnd)
+      {
+         iPos = FindFrame(reader, iPos + 1, iEnd, iEnd, frame);
+         if (iPos < 0)
+            break;
+         continue;
+      }
+
+      iSamples += frame.m_Samples;
+      iBytes += frame.m_Length;
+      iPos += frame.m_Length;
+   }
+
+   duration.m_Samples = iSamples;
+   duration.m_Bytes = iBytes;
+   return iSamples > 0;
+}
+
+bool GetMPEGDuration(TagLib::IOStream* pStream, const scan_policy_t policy, mpeg_duration& duration)
+{
+   // frames lie between the ID3v2 tag and the ID3v1 and APE tags
+   byte_ranges_t ranges;
+   if (!GetAudioRanges(pStream, fmtMPEG, ranges) || ranges.empty())
+      return false;
+   const long iBegin = ranges[0].m_Offset;
+   const long iEnd = iBegin + ranges[0].m_Length;
+
+   // junk in front of the first frame is searched with large reads
+   frame_reader reader(pStream, iEnd, HeaderBlockSize);
+   mpeg_frame first;
+   const long iHeaderEnd = std::min(iEnd, iBegin + HeaderBlockSize);
+   long iFirst = FindFrame(reader, iBegin, iHeaderEnd, iEnd, first);
+   if (iFirst < 0)
+   {
+      reader.SetBlockSize(ScanBlockSize);
+      iFirst = FindFrame(reader, iHeaderEnd, iEnd, iEnd, first);
+      if (iFirst < 0)
+         return false;
+   }
+   duration.m_Samplerate = first.m_Samplerate;
+   duration.m_Channels = first.m_Mono ? 1 : 2;
+
+   const unsigned char* p = reader.Get(iFirst, first.m_Length);
+   if (!p)
+      return false;
+
+   // the header frame holds no audio
+   bool bHasFrames = false;
+   long long iFrames = 0;
+   long long iDropped = 0;
+   const bool bXing = ReadXingHeader(p, first, bHasFrames, iFrames, iDropped);
+   if ((bXing && bHasFrames) || (!bXing && ReadVBRIHeader(p, first, iFrames)))
+   {
+      duration.m_Samples = iFrames * first.m_Samples;
+      if (iDropped < duration.m_Samples)
+         duration.m_Samples -= iDropped;
+      duration.m_Bytes = iEnd - iFirst - first.m_Length;
+      return iFrames > 0;
+   }
+
+   const long iAudio = bXing ? iFirst + first.m_Length : iFirst;
+   if (scanNever == policy || (scanIfVBR == policy && !IsVBR(reader, iFirst, first)))
+   {
+      // right for CBR files
+      duration.m_Bytes = iEnd - iAudio;
+      duration.m_Samples = (long long) duration.m_Bytes * 8 * first.m_Samplerate / (first.m_Bitrate * 1000LL);
+      return true;
+   }
+
+   reader.SetBlockSize(ScanBlockSize);
+   return ScanFrames(reader, iAudio, iEnd, first, duration);
+}
+}
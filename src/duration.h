@@ -0,0 +1,65 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <tiostream.h>
+
+namespace wdx
+{
+
+/// when the frames of a file without a VBR header are counted one by one
+enum scan_policy_t
+{
+   scanNever,
+   scanIfVBR, // bitrate of the first frames varies, so the estimate from one frame is wrong
+   scanAlways,
+};
+
+/// length of an MPEG audio stream
+struct mpeg_duration
+{
+   long long m_Samples; // per channel, without the encoder delay and padding
+   int m_Samplerate;
+   int m_Channels;
+   long m_Bytes; // of the frames
+
+   mpeg_duration() :
+         m_Samples(0), m_Samplerate(0), m_Channels(0), m_Bytes(0)
+   {
+   }
+
+   long long GetMilliseconds() const
+   {
+      return m_Samplerate > 0 ? m_Samples * 1000 / m_Samplerate : 0;
+   }
+
+   /// average bitrate in kbit/s
+   int GetBitrate() const
+   {
+      const long long iMilliseconds = GetMilliseconds();
+      return iMilliseconds > 0 ? (int) (m_Bytes * 8LL / iMilliseconds) : 0;
+   }
+};
+
+/// duration from the Xing/Info or VBRI header of the first frame, without
+/// the encoder delay and padding told by the LAME header. Without such a
+/// header, the headers of all frames are read with large sequential reads
+/// if the policy asks for it, otherwise the length is estimated from the
+/// bitrate of the first frame. False if there are no frames.
+bool GetMPEGDuration(TagLib::IOStream* pStream, const scan_policy_t policy, mpeg_duration& duration);
+}
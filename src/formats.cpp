@@ -0,0 +1,353 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include <cstring>
+#include <cwctype>
+#include <tbytevector.h>
+#include <mpegfile.h>
+#include <vorbisfile.h>
+#include <oggflacfile.h>
+#include <flacfile.h>
+#include <mpcfile.h>
+#include <wavpackfile.h>
+#include <speexfile.h>
+#include <opusfile.h>
+#include <trueaudiofile.h>
+#include <mp4file.h>
+#include <asffile.h>
+#include <aifffile.h>
+#include <wavfile.h>
+#include <apefile.h>
+#include <modfile.h>
+#include <s3mfile.h>
+#include <itfile.h>
+#include <xmfile.h>
+
+#include "formats.h"
+
+namespace wdx
+{
+
+typedef TagLib::File* (*factory_t)(TagLib::IOStream* pStream, const bool bReadProperties,
+      const TagLib::AudioProperties::ReadStyle style);
+
+template<class T>
+static TagLib::File* Create(TagLib::IOStream* pStream, const bool bReadProperties,
+      const TagLib::AudioProperties::ReadStyle style)
+{
+   return new T(pStream, bReadProperties, style);
+}
+
+template<class T>
+static TagLib::File* CreateWithFrameFactory(TagLib::IOStream* pStream, const bool bReadProperties,
+      const TagLib::AudioProperties::ReadStyle style)
+{
+   return new T(pStream, TagLib::ID3v2::FrameFactory::instance(), bReadProperties, style);
+}
+
+/// TagLib searches MPEG frames byte by byte for the audio properties,
+/// GetMPEGDuration reads them instead
+static TagLib::File* CreateMPEG(TagLib::IOStream* pStream, const bool,
+      const TagLib::AudioProperties::ReadStyle style)
+{
+   return CreateWithFrameFactory<TagLib::MPEG::File>(pStream, false, style);
+}
+
+// in order of format_t
+static const factory_t Factories[] =
+{
+   nullptr,
+   &CreateMPEG,
+   &Create<TagLib::Ogg::Vorbis::File>,
+   &Create<TagLib::Ogg::FLAC::File>,
+   &CreateWithFrameFactory<TagLib::FLAC::File>,
+   &Create<TagLib::MPC::File>,
+   &Create<TagLib::WavPack::File>,
+   &Create<TagLib::Ogg::Speex::File>,
+   &Create<TagLib::Ogg::Opus::File>,
+   &Create<TagLib::TrueAudio::File>,
+   &Create<TagLib::MP4::File>,
+   &Create<TagLib::ASF::File>,
+   &Create<TagLib::RIFF::AIFF::File>,
+   &Create<TagLib::RIFF::WAV::File>,
+   &Create<TagLib::APE::File>,
+   &Create<TagLib::Mod::File>,
+   &Create<TagLib::S3M::File>,
+   &Create<TagLib::IT::File>,
+   &Create<TagLib::XM::File>,
+};
+
+static_assert(sizeof(Factories) / sizeof(Factories[0]) == fmtCount, "factory is missing for a format");
+
+// in order of format_t
+static const char* FormatNames[] =
+{
+   "Unknown",
+   "MPEG",
+   "Ogg Vorbis",
+   "Ogg FLAC",
+   "FLAC",
+   "MPC",
+   "WavPack",
+   "Speex",
+   "Opus",
+   "TrueAudio",
+   "MP4",
+   "ASF",
+   "AIFF",
+   "WAV",
+   "APE",
+   "MOD",
+   "S3M",
+   "IT",
+   "XM",
+};
+
+static_assert(sizeof(FormatNames) / sizeof(FormatNames[0]) == fmtCount, "name is missing for a format");
+
+struct extension
+{
+   const wchar_t* m_Name;
+   format_t m_Format;
+};
+
+// same extensions as TagLib::FileRef::create handles
+static const extension Extensions[] =
+{
+   { L"MP3", fmtMPEG },
+   { L"OGG", fmtOggVorbis },
+   { L"OGA", fmtUnknown },
+   { L"FLAC", fmtFLAC },
+   { L"MPC", fmtMPC },
+   { L"WV", fmtWavPack },
+   { L"SPX", fmtSpeex },
+   { L"OPUS", fmtOpus },
+   { L"TTA", fmtTrueAudio },
+   { L"M4A", fmtMP4 },
+   { L"M4R", fmtMP4 },
+   { L"M4B", fmtMP4 },
+   { L"M4P", fmtMP4 },
+   { L"MP4", fmtMP4 },
+   { L"3G2", fmtMP4 },
+   { L"WMA", fmtASF },
+   { L"ASF", fmtASF },
+   { L"AIF", fmtAIFF },
+   { L"AIFF", fmtAIFF },
+   { L"AFC", fmtAIFF },
+   { L"AIFC", fmtAIFF },
+   { L"WAV", fmtWAV },
+   { L"APE", fmtAPE },
+   { L"MOD", fmtMod },
+   { L"MODULE", fmtMod },
+   { L"NST", fmtMod },
+   { L"WOW", fmtMod },
+   { L"S3M", fmtS3M },
+   { L"IT", fmtIT },
+   { L"XM", fmtXM },
+};
+
+static const extension* FindExtension(const std::wstring& sFileName)
+{
+   const std::wstring::size_type iDot = sFileName.find_last_of(L".\\/");
+   if (std::wstring::npos == iDot || L'.' != sFileName[iDot])
+      return nullptr;
+
+   const wchar_t* pExt = sFileName.c_str() + iDot + 1;
+   for (const extension& ext : Extensions)
+   {
+      size_t i = 0;
+      while (ext.m_Name[i] && (wchar_t) std::towupper(pExt[i]) == ext.m_Name[i])
+         ++i;
+      if (!ext.m_Name[i] && !pExt[i])
+         return &ext;
+   }
+
+   return nullptr;
+}
+
+const char* GetFormatName(const format_t format)
+{
+   return format >= fmtUnknown && format < fmtCount ? FormatNames[format] : FormatNames[fmtUnknown];
+}
+
+format_t GetFormatByExtension(const std::wstring& sFileName)
+{
+   const extension* pExt = FindExtension(sFileName);
+   return pExt ? pExt->m_Format : fmtUnknown;
+}
+
+bool HasTagsAtEnds(const format_t format)
+{
+   switch (format)
+   {
+      case fmtMPEG:
+      case fmtMPC:
+      case fmtWavPack:
+      case fmtTrueAudio:
+      case fmtAPE:
+         return true;
+      default:
+         return false;
+   }
+}
+
+bool IsSupportedFile(const std::wstring& sFileName)
+{
+   return FindExtension(sFileName) != nullptr;
+}
+
+std::string GetDetectString()
+{
+   std::string sResult;
+
+   for (const extension& ext : Extensions)
+   {
+      if (!sResult.empty())
+         sResult += " | ";
+      sResult += "EXT=\"";
+      for (const wchar_t* p = ext.m_Name; *p; ++p)
+         sResult += (char) *p;
+      sResult += "\"";
+   }
+
+   return sResult;
+}
+
+// enough for all signatures below
+static const unsigned int SniffSize = 64;
+
+static bool HasSignature(const TagLib::ByteVector& data, const unsigned int iOffset,
+      const char* pSignature, const size_t iLength)
+{
+   return data.size() >= iOffset + iLength && 0 == std::memcmp(data.data() + iOffset, pSignature, iLength);
+}
+
+static bool HasSignature(const TagLib::ByteVector& data, const unsigned int iOffset, const char* pSignature)
+{
+   return HasSignature(data, iOffset, pSignature, std::strlen(pSignature));
+}
+
+format_t SniffFormat(TagLib::IOStream* pStream)
+{
+   pStream->seek(0);
+   TagLib::ByteVector data = pStream->readBlock(SniffSize);
+
+   // MPEG, FLAC, TTA and APE may have ID3v2 tag in front of the audio data
+   if (HasSignature(data, 0, "ID3") && data.size() >= 10)
+   {
+      const unsigned char* p = (const unsigned char*) data.data();
+      long iTagSize = 10 + ((p[6] & 0x7F) << 21 | (p[7] & 0x7F) << 14 | (p[8] & 0x7F) << 7 | (p[9] & 0x7F));
+      if (p[5] & 0x10) // footer present
+         iTagSize += 10;
+
+      pStream->seek(iTagSize);
+      data = pStream->readBlock(SniffSize);
+   }
+
+   if (HasSignature(data, 0, "OggS"))
+   {
+      // codec is defined by the first packet, it starts right after
+      // the first page header with a single segment
+      if (HasSignature(data, 28, "\x01vorbis"))
+         return fmtOggVorbis;
+      if (HasSignature(data, 28, "\x7F" "FLAC"))
+         return fmtOggFLAC;
+      if (HasSignature(data, 28, "Speex   "))
+         return fmtSpeex;
+      if (HasSignature(data, 28, "OpusHead"))
+         return fmtOpus;
+      return fmtUnknown;
+   }
+
+   if (HasSignature(data, 0, "fLaC"))
+      return fmtFLAC;
+   if (HasSignature(data, 0, "MPCK") || HasSignature(data, 0, "MP+"))
+      return fmtMPC;
+   if (HasSignature(data, 0, "wvpk"))
+      return fmtWavPack;
+   if (HasSignature(data, 0, "TTA1"))
+      return fmtTrueAudio;
+   if (HasSignature(data, 0, "MAC "))
+      return fmtAPE;
+   if (HasSignature(data, 4, "ftyp"))
+      return fmtMP4;
+   if (HasSignature(data, 0, "\x30\x26\xB2\x75\x8E\x66\xCF\x11", 8))
+      return fmtASF;
+   if (HasSignature(data, 0, "FORM") && (HasSignature(data, 8, "AIFF") || HasSignature(data, 8, "AIFC")))
+      return fmtAIFF;
+   if (HasSignature(data, 0, "RIFF") && HasSignature(data, 8, "WAVE"))
+      return fmtWAV;
+   if (HasSignature(data, 0, "Extended Module: "))
+      return fmtXM;
+   if (HasSignature(data, 0, "IMPM"))
+      return fmtIT;
+   if (HasSignature(data, 44, "SCRM"))
+      return fmtS3M;
+
+   // MPEG audio frame sync, layer bits must not be reserved
+   if (data.size() >= 2 && (unsigned char) data[0] == 0xFF
+         && ((unsigned char) data[1] & 0xE0) == 0xE0 && ((unsigned char) data[1] & 0x06) != 0)
+      return fmtMPEG;
+
+   return fmtUnknown;
+}
+
+TagLib::File* CreateTagLibFile(const format_t format, TagLib::IOStream* pStream,
+      const bool bReadProperties, const TagLib::AudioProperties::ReadStyle style)
+{
+   if (format <= fmtUnknown || format >= fmtCount)
+      return nullptr;
+
+   return Factories[format](pStream, bReadProperties, style);
+}
+
+audio_file::audio_file(const std::wstring& sFileName, TagLib::IOStream* pStream,
+      const bool bReadProperties, const TagLib::AudioProperties::ReadStyle style) :
+      Stream_(pStream),
+      Format_(fmtUnknown)
+{
+   if (!Stream_ || !Stream_->isOpen())
+      return;
+
+   const format_t extFormat = GetFormatByExtension(sFileName);
+   if (fmtUnknown != extFormat && Open(extFormat, bReadProperties, style))
+      return;
+
+   // extension does not define the format or the file is misnamed
+   Stream_->clear();
+   const format_t sniffedFormat = SniffFormat(Stream_.get());
+   Stream_->clear();
+   Stream_->seek(0);
+
+   if (sniffedFormat != extFormat)
+      Open(sniffedFormat, bReadProperties, style);
+}
+
+bool audio_file::Open(const format_t format, const bool bReadProperties,
+      const TagLib::AudioProperties::ReadStyle style)
+{
+   File_.reset(CreateTagLibFile(format, Stream_.get(), bReadProperties, style));
+   if (!File_ || !File_->isValid())
+   {
+      File_.reset();
+      return false;
+   }
+
+   Format_ = format;
+   return true;
+}
+
+}
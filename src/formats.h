@@ -0,0 +1,123 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#pragma once
+
+#include <memory>
+#include <string>
+#include <tfile.h>
+#include <tiostream.h>
+#include <audioproperties.h>
+
+namespace wdx
+{
+
+/// audio formats supported by TagLib, each one is opened by its own File class
+enum format_t
+{
+   fmtUnknown = 0,
+   fmtMPEG,
+   fmtOggVorbis,
+   fmtOggFLAC,
+   fmtFLAC,
+   fmtMPC,
+   fmtWavPack,
+   fmtSpeex,
+   fmtOpus,
+   fmtTrueAudio,
+   fmtMP4,
+   fmtASF,
+   fmtAIFF,
+   fmtWAV,
+   fmtAPE,
+   fmtMod,
+   fmtS3M,
+   fmtIT,
+   fmtXM,
+   fmtCount
+};
+
+/// human readable name of the format
+const char* GetFormatName(const format_t format);
+
+/// format defined by the file extension, fmtUnknown if the extension is not
+/// supported or does not define the format (.oga may hold any Ogg codec)
+format_t GetFormatByExtension(const std::wstring& sFileName);
+
+/// format keeps ID3v2 tag in front and ID3v1 or APE tags behind the audio
+/// data, so tags are found at both ends of the file
+bool HasTagsAtEnds(const format_t format);
+
+/// format defined by the signature in the beginning of the stream,
+/// ID3v2 tag in front of the audio data is skipped
+format_t SniffFormat(TagLib::IOStream* pStream);
+
+/// creates TagLib file of the given format on top of the stream;
+/// stream is not owned by the returned file
+TagLib::File* CreateTagLibFile(const format_t format, TagLib::IOStream* pStream,
+      const bool bReadProperties = true,
+      const TagLib::AudioProperties::ReadStyle style = TagLib::AudioProperties::Average);
+
+/// TagLib file of the format picked once by the extension, or by the content
+/// if the extension does not tell it or is wrong
+class audio_file
+{
+public:
+   /// takes ownership of the stream, audio properties of MPEG files are not
+   /// read, TagLib::MPEG::Properties can read them later if needed
+   audio_file(const std::wstring& sFileName, TagLib::IOStream* pStream,
+         const bool bReadProperties = true,
+         const TagLib::AudioProperties::ReadStyle style = TagLib::AudioProperties::Average);
+
+   /// file was recognized and parsed
+   bool IsValid() const
+   {
+      return File_ != nullptr;
+   }
+
+   format_t GetFormat() const
+   {
+      return Format_;
+   }
+
+   TagLib::File* GetFile() const
+   {
+      return File_.get();
+   }
+
+   TagLib::IOStream* GetStream() const
+   {
+      return Stream_.get();
+   }
+
+private:
+   audio_file(const audio_file&);
+   audio_file& operator=(const audio_file&);
+
+   bool Open(const format_t format, const bool bReadProperties, const TagLib::AudioProperties::ReadStyle style);
+
+   std::unique_ptr<TagLib::IOStream> Stream_;
+   // destroyed before the stream it reads from
+   std::unique_ptr<TagLib::File> File_;
+   format_t Format_;
+};
+
+/// checks if file extension is one of the supported ones
+bool IsSupportedFile(const std::wstring& sFileName);
+
+/// TC detect string matching all supported extensions
+std::string GetDetectString();
+}
@@ -0,0 +1,151 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstring>
+#include "hash.h"
+
+namespace wdx
+{
+
+static const unsigned long long Prime1 = 0x9E3779B185EBCA87ULL;
+static const unsigned long long Prime2 = 0xC2B2AE3D27D4EB4FULL;
+static const unsigned long long Prime3 = 0x165667B19E3779F9ULL;
+static const unsigned long long Prime4 = 0x85EBCA77C2B2AE63ULL;
+static const unsigned long long Prime5 = 0x27D4EB2F165667C5ULL;
+static const size_t StripeSize = 32;
+
+static unsigned long long RotateLeft(const unsigned long long iValue, const int iBits)
+{
+   return (iValue << iBits) | (iValue >> (64 - iBits));
+}
+
+// little endian on every platform the plugin runs on
+static unsigned long long Read64(const unsigned char* p)
+{
+   unsigned long long iValue;
+   std::memcpy(&iValue, p, sizeof(iValue));
+   return iValue;
+}
+
+static unsigned int Read32(const unsigned char* p)
+{
+   unsigned int iValue;
+   std::memcpy(&iValue, p, sizeof(iValue));
+   return iValue;
+}
+
+static unsigned long long Round(unsigned long long iAcc, const unsigned long long iInput)
+{
+   iAcc += iInput * Prime2;
+   iAcc = RotateLeft(iAcc, 31);
+   return iAcc * Prime1;
+}
+
+static unsigned long long MergeRound(unsigned long long iAcc, const unsigned long long iValue)
+{
+   iAcc ^= Round(0, iValue);
+   return iAcc * Prime1 + Prime4;
+}
+
+xxhash64::xxhash64(const unsigned long long iSeed) :
+      Seed_(iSeed), TotalSize_(0), Buffered_(0)
+{
+   Acc_[0] = iSeed + Prime1 + Prime2;
+   Acc_[1] = iSeed + Prime2;
+   Acc_[2] = iSeed;
+   Acc_[3] = iSeed - Prime1;
+}
+
+void xxhash64::Update(const void* pData, size_t iSize)
+{
+   const unsigned char* p = (const unsigned char*) pData;
+   TotalSize_ += iSize;
+
+   if (Buffered_ > 0)
+   {
+      const size_t iFill = iSize < StripeSize - Buffered_ ? iSize : StripeSize - Buffered_;
+      std::memcpy(Buffer_ + Buffered_, p, iFill);
+      Buffered_ += iFill;
+      p += iFill;
+      iSize -= iFill;
+      if (Buffered_ < StripeSize)
+         return;
+
+      for (int i = 0; i < 4; ++i)
+         Acc_[i] = Round(Acc_[i], Read64(Buffer_ + i * 8));
+      Buffered_ = 0;
+   }
+
+   // four independent lanes let the processor overlap the multiplications
+   unsigned long long iAcc0 = Acc_[0], iAcc1 = Acc_[1], iAcc2 = Acc_[2], iAcc3 = Acc_[3];
+   for (; iSize >= StripeSize; p += StripeSize, iSize -= StripeSize)
+   {
+      iAcc0 = Round(iAcc0, Read64(p));
+      iAcc1 = Round(iAcc1, Read64(p + 8));
+      iAcc2 = Round(iAcc2, Read64(p + 16));
+      iAcc3 = Round(iAcc3, Read64(p + 24));
+   }
+   Acc_[0] = iAcc0;
+   Acc_[1] = iAcc1;
+   Acc_[2] = iAcc2;
+   Acc_[3] = iAcc3;
+
+   std::memcpy(Buffer_, p, iSize);
+   Buffered_ = iSize;
+}
+
+unsigned long long xxhash64::Digest() const
+{
+   unsigned long long iHash;
+   if (TotalSize_ >= StripeSize)
+   {
+      iHash = RotateLeft(Acc_[0], 1) + RotateLeft(Acc_[1], 7) + RotateLeft(Acc_[2], 12) + RotateLeft(Acc_[3], 18);
+      for (int i = 0; i < 4; ++i)
+         iHash = MergeRound(iHash, Acc_[i]);
+   }
+   else
+      iHash = Seed_ + Prime5;
+
+   iHash += TotalSize_;
+
+   const unsigned char* p = Buffer_;
+   const unsigned char* pEnd = Buffer_ + Buffered_;
+   for (; p + 8 <= pEnd; p += 8)
+   {
+      iHash ^= Round(0, Read64(p));
+      iHash = RotateLeft(iHash, 27) * Prime1 + Prime4;
+   }
+   if (p + 4 <= pEnd)
+   {
+      iHash ^= (unsigned long long) Read32(p) * Prime1;
+      iHash = RotateLeft(iHash, 23) * Prime2 + Prime3;
+      p += 4;
+   }
+   for (; p < pEnd; ++p)
+   {
+      iHash ^= *p * Prime5;
+      iHash = RotateLeft(iHash, 11) * Prime1;
+   }
+
+   iHash ^= iHash >> 33;
+   iHash *= Prime2;
+   iHash ^= iHash >> 29;
+   iHash *= Prime3;
+   iHash ^= iHash >> 32;
+   return iHash;
+}
+}
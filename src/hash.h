@@ -0,0 +1,42 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstddef>
+
+namespace wdx
+{
+
+/// streaming XXH64 hash, about as fast as memory reads, for checksums
+/// of audio data
+class xxhash64
+{
+public:
+   explicit xxhash64(const unsigned long long iSeed = 0);
+
+   void Update(const void* pData, size_t iSize);
+   unsigned long long Digest() const;
+
+private:
+   unsigned long long Acc_[4];
+   unsigned long long Seed_;
+   unsigned long long TotalSize_;
+   unsigned char Buffer_[32]; // input not filling a whole stripe yet
+   size_t Buffered_;
+};
+}
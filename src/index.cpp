@@ -0,0 +1,565 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cstring>
+#include "index.h"
+#include "serial.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace wdx
+{
+
+// header: magic, format version, metadata version, generation, reserved
+static const char IndexMagic[8] = { 'W', 'D', 'X', 'I', 'D', 'X', 0, 0 };
+static const unsigned int IndexFormatVersion = 1;
+static const unsigned int HeaderSize = 32;
+
+// record: payload size, payload checksum, payload
+static const unsigned int RecordHeaderSize = 8;
+
+// files smaller than this are never compacted
+static const unsigned long long MinCompactSize = 1024 * 1024;
+
+static unsigned int Checksum(const char* pData, const size_t iSize)
+{
+   // FNV-1a, enough to detect a record torn by a crash
+   unsigned int hash = 2166136261u;
+   for (size_t i = 0; i < iSize; ++i)
+   {
+      hash = (hash ^ (unsigned char) pData[i]) * 16777619u;
+   }
+   return hash;
+}
+
+static unsigned int ReadU32(const char* pData)
+{
+   unsigned int value = 0;
+   serial_reader(pData, 4).U32(value);
+   return value;
+}
+
+#ifdef _WIN32
+const disk_index::handle_t disk_index::NoFile = INVALID_HANDLE_VALUE;
+#else
+const disk_index::handle_t disk_index::NoFile = -1;
+#endif
+
+#ifdef _WIN32
+
+/// byte range lock far beyond the end of file, serializes access of all processes
+class disk_index::file_lock
+{
+public:
+   file_lock(HANDLE hFile, const bool bExclusive) :
+         File_(hFile)
+   {
+      std::memset(&Overlapped_, 0, sizeof(Overlapped_));
+      Overlapped_.OffsetHigh = 0x7FFFFFFF;
+      Locked_ = LockFileEx(File_, bExclusive ? LOCKFILE_EXCLUSIVE_LOCK : 0, 0, 1, 0, &Overlapped_) != FALSE;
+   }
+
+   ~file_lock()
+   {
+      if (Locked_)
+         UnlockFileEx(File_, 0, 1, 0, &Overlapped_);
+   }
+
+   bool IsLocked() const
+   {
+      return Locked_;
+   }
+
+private:
+   HANDLE File_;
+   OVERLAPPED Overlapped_;
+   bool Locked_;
+};
+
+/// read-only mapping of the whole file
+class disk_index::view
+{
+public:
+   explicit view(HANDLE hFile) :
+         Mapping_(NULL), Data_(nullptr), Size_(0)
+   {
+      LARGE_INTEGER size;
+      if (!GetFileSizeEx(hFile, &size) || !size.QuadPart)
+         return;
+
+      Mapping_ = CreateFileMappingW(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+      if (!Mapping_)
+         return;
+
+      Data_ = (const char*) MapViewOfFile(Mapping_, FILE_MAP_READ, 0, 0, 0);
+      if (Data_)
+         Size_ = size.QuadPart;
+   }
+
+   ~view()
+   {
+      if (Data_)
+         UnmapViewOfFile(Data_);
+      if (Mapping_)
+         CloseHandle(Mapping_);
+   }
+
+   const char* Data() const
+   {
+      return Data_;
+   }
+
+   unsigned long long Size() const
+   {
+      return Size_;
+   }
+
+private:
+   HANDLE Mapping_;
+   const char* Data_;
+   unsigned long long Size_;
+};
+
+#else
+
+/// whole file advisory lock, serializes access of all processes
+class disk_index::file_lock
+{
+public:
+   file_lock(const int hFile, const bool bExclusive) :
+         File_(hFile)
+   {
+      Locked_ = 0 == flock(File_, bExclusive ? LOCK_EX : LOCK_SH);
+   }
+
+   ~file_lock()
+   {
+      if (Locked_)
+         flock(File_, LOCK_UN);
+   }
+
+   bool IsLocked() const
+   {
+      return Locked_;
+   }
+
+private:
+   int File_;
+   bool Locked_;
+};
+
+/// read-only mapping of the whole file
+class disk_index::view
+{
+public:
+   explicit view(const int hFile) :
+         Data_(nullptr), Size_(0)
+   {
+      struct stat data;
+      if (fstat(hFile, &data) != 0 || !data.st_size)
+         return;
+
+      void* pData = mmap(NULL, data.st_size, PROT_READ, MAP_SHARED, hFile, 0);
+      if (MAP_FAILED == pData)
+         return;
+
+      Data_ = (const char*) pData;
+      Size_ = data.st_size;
+   }
+
+   ~view()
+   {
+      if (Data_)
+         munmap((void*) Data_, Size_);
+   }
+
+   const char* Data() const
+   {
+      return Data_;
+   }
+
+   unsigned long long Size() const
+   {
+      return Size_;
+   }
+
+private:
+   const char* Data_;
+   unsigned long long Size_;
+};
+
+#endif
+
+disk_index::disk_index() :
+      File_(NoFile), MaxBytes_(0), Generation_(0), ScannedEnd_(0), LiveBytes_(0)
+{
+}
+
+disk_index::~disk_index()
+{
+   Close();
+}
+
+void disk_index::Open(const std::string& sFileName, const size_t iMaxBytes)
+{
+   Close();
+
+   std::lock_guard<std::mutex> lock(Mutex_);
+
+   MaxBytes_ = iMaxBytes;
+   if (sFileName.empty() || !MaxBytes_)
+      return;
+
+#ifdef _WIN32
+   File_ = CreateFileA(sFileName.c_str(), GENERIC_READ | GENERIC_WRITE,
+         FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_ALWAYS,
+         FILE_ATTRIBUTE_NORMAL, NULL);
+#else
+   File_ = open(sFileName.c_str(), O_RDWR | O_CREAT, 0644);
+#endif
+}
+
+void disk_index::Close()
+{
+   std::lock_guard<std::mutex> lock(Mutex_);
+
+   View_.reset();
+   if (NoFile != File_)
+#ifdef _WIN32
+      CloseHandle(File_);
+#else
+      close(File_);
+#endif
+
+   File_ = NoFile;
+   Records_.clear();
+   Generation_ = 0;
+   ScannedEnd_ = 0;
+   LiveBytes_ = 0;
+}
+
+bool disk_index::Find(const std::wstring& sFileName, const utils::file_stamp& stamp, metadata_ptr& data)
+{
+   std::lock_guard<std::mutex> lock(Mutex_);
+
+   if (NoFile == File_)
+      return false;
+
+   file_lock fileLock(File_, false);
+   if (!fileLock.IsLocked())
+      return false;
+
+   const view& file = Map();
+   if (!Sync(file))
+      return false;
+
+   records_t::const_iterator iter = Records_.find(sFileName);
+   if (Records_.end() == iter || iter->second.m_Stamp != stamp)
+      return false;
+
+   // skip the key, it was checked while scanning
+   serial_reader reader(file.Data() + iter->second.m_Offset + RecordHeaderSize, iter->second.m_Size);
+   unsigned long long iSkip = 0;
+   std::wstring sKey;
+   unsigned char bValid = 0;
+   if (!reader.U64(iSkip) || !reader.U64(iSkip) || !reader.WString(sKey) || !reader.U8(bValid))
+      return false;
+
+   if (!bValid)
+   {
+      data.reset();
+      return true;
+   }
+
+   std::shared_ptr<metadata> result = std::make_shared<metadata>();
+   if (!result->Deserialize(reader))
+      return false;
+
+   data = result;
+   return true;
+}
+
+void disk_index::Store(const std::wstring& sFileName, const utils::file_stamp& stamp, const metadata_ptr& data)
+{
+   std::vector<char> buffer(RecordHeaderSize);
+   serial_writer writer(buffer);
+   writer.U64(stamp.m_Size);
+   writer.U64(stamp.m_Time);
+   writer.WString(sFileName);
+   writer.U8(data ? 1 : 0);
+   if (data)
+      data->Serialize(writer);
+
+   const unsigned int iPayloadSize = (unsigned int) (buffer.size() - RecordHeaderSize);
+   std::vector<char> head;
+   serial_writer headWriter(head);
+   headWriter.U32(iPayloadSize);
+   headWriter.U32(Checksum(&buffer[RecordHeaderSize], iPayloadSize));
+   std::copy(head.begin(), head.end(), buffer.begin());
+
+   std::lock_guard<std::mutex> lock(Mutex_);
+
+   if (NoFile == File_)
+      return;
+
+   file_lock fileLock(File_, true);
+   if (!fileLock.IsLocked())
+      return;
+
+   unsigned long long iFileSize = 0;
+   const view& file = Map();
+   if (Sync(file))
+      iFileSize = file.Size();
+   else if (!file.Data() && GetSize())
+      return; // mapping failed, the records may still be valid
+   else
+   {
+      Reset();
+      iFileSize = GetSize();
+   }
+
+   if (!Write(ScannedEnd_, buffer))
+      return;
+
+   record& rec = Records_[sFileName];
+   if (rec.m_Size)
+      LiveBytes_ -= RecordHeaderSize + rec.m_Size;
+   rec.m_Stamp = stamp;
+   rec.m_Offset = ScannedEnd_;
+   rec.m_Size = iPayloadSize;
+   LiveBytes_ += buffer.size();
+   ScannedEnd_ += buffer.size();
+
+   // drop the rest of a tail torn by a crashed writer
+   if (iFileSize > ScannedEnd_)
+      Cut(ScannedEnd_);
+
+   if (ScannedEnd_ > MaxBytes_)
+      Compact(true);
+   else if (ScannedEnd_ > MinCompactSize && LiveBytes_ < ScannedEnd_ / 2)
+      Compact(false);
+}
+
+/// mapping of the whole file, renewed only when its size has changed
+const disk_index::view& disk_index::Map()
+{
+   if (!View_ || View_->Size() != GetSize())
+   {
+      View_.reset();
+      View_.reset(new view(File_));
+   }
+   return *View_;
+}
+
+bool disk_index::Sync(const view& file)
+{
+   if (!file.Data() || file.Size() < HeaderSize)
+      return false;
+
+   const char* pHeader = file.Data();
+   if (std::memcmp(pHeader, IndexMagic, sizeof(IndexMagic))
+         || ReadU32(pHeader + 8) != IndexFormatVersion
+         || ReadU32(pHeader + 12) != metadata::SerialVersion)
+      return false;
+
+   // file was compacted by another instance, offsets are not valid anymore
+   const unsigned int iGeneration = ReadU32(pHeader + 16);
+   if (iGeneration != Generation_ || ScannedEnd_ < HeaderSize || ScannedEnd_ > file.Size())
+   {
+      Records_.clear();
+      Generation_ = iGeneration;
+      ScannedEnd_ = HeaderSize;
+      LiveBytes_ = HeaderSize;
+   }
+
+   Scan(file);
+   return true;
+}
+
+void disk_index::Scan(const view& file)
+{
+   while (ScannedEnd_ + RecordHeaderSize <= file.Size())
+   {
+      const char* pRecord = file.Data() + ScannedEnd_;
+      const unsigned int iPayloadSize = ReadU32(pRecord);
+      if (iPayloadSize > file.Size() - ScannedEnd_ - RecordHeaderSize
+            || ReadU32(pRecord + 4) != Checksum(pRecord + RecordHeaderSize, iPayloadSize))
+         break;
+
+      serial_reader reader(pRecord + RecordHeaderSize, iPayloadSize);
+      utils::file_stamp stamp;
+      std::wstring sFileName;
+      if (!reader.U64(stamp.m_Size) || !reader.U64(stamp.m_Time) || !reader.WString(sFileName))
+         break;
+
+      record& rec = Records_[sFileName];
+      if (rec.m_Size)
+         LiveBytes_ -= RecordHeaderSize + rec.m_Size;
+      rec.m_Stamp = stamp;
+      rec.m_Offset = ScannedEnd_;
+      rec.m_Size = iPayloadSize;
+      LiveBytes_ += RecordHeaderSize + iPayloadSize;
+      ScannedEnd_ += RecordHeaderSize + iPayloadSize;
+   }
+}
+
+void disk_index::Reset()
+{
+   std::vector<char> header(IndexMagic, IndexMagic + sizeof(IndexMagic));
+   serial_writer writer(header);
+   writer.U32(IndexFormatVersion);
+   writer.U32(metadata::SerialVersion);
+   writer.U32(Generation_ + 1);
+   header.resize(HeaderSize, 0);
+
+   Records_.clear();
+   Generation_++;
+   ScannedEnd_ = HeaderSize;
+   LiveBytes_ = HeaderSize;
+
+   // old records may stay behind the header when the file can not be
+   // shortened, they must not be read with the new layout
+   Write(0, header);
+   Cut(HeaderSize);
+}
+
+void disk_index::Cut(const unsigned long long iSize)
+{
+   // a file mapped by another instance can not be shortened on Windows, then
+   // a record header which never passes the checksum ends the records
+   if (!Truncate(iSize))
+      Write(iSize, std::vector<char>(RecordHeaderSize, 0));
+}
+
+void disk_index::Compact(const bool bShrink)
+{
+   typedef std::vector<std::pair<unsigned long long, records_t::iterator> > order_t;
+
+   order_t order;
+   order.reserve(Records_.size());
+   for (records_t::iterator iter = Records_.begin(); iter != Records_.end(); ++iter)
+   {
+      order.push_back(order_t::value_type(iter->second.m_Offset, iter));
+   }
+   std::sort(order.begin(), order.end(),
+         [](const order_t::value_type& a, const order_t::value_type& b) { return a.first < b.first; });
+
+   // when the file is too big, keep only the newer half of it
+   size_t iFirst = 0;
+   if (bShrink)
+   {
+      unsigned long long iLive = LiveBytes_;
+      while (iFirst < order.size() && iLive > MaxBytes_ / 2)
+      {
+         iLive -= RecordHeaderSize + order[iFirst].second->second.m_Size;
+         ++iFirst;
+      }
+   }
+
+   std::vector<char> buffer(IndexMagic, IndexMagic + sizeof(IndexMagic));
+   serial_writer writer(buffer);
+   writer.U32(IndexFormatVersion);
+   writer.U32(metadata::SerialVersion);
+   writer.U32(Generation_ + 1);
+   buffer.resize(HeaderSize, 0);
+
+   {
+      const view& file = Map();
+      if (!file.Data() || file.Size() < ScannedEnd_)
+         return;
+
+      for (size_t i = iFirst; i < order.size(); ++i)
+      {
+         record& rec = order[i].second->second;
+         const char* pRecord = file.Data() + rec.m_Offset;
+         rec.m_Offset = buffer.size();
+         buffer.insert(buffer.end(), pRecord, pRecord + RecordHeaderSize + rec.m_Size);
+      }
+   }
+
+   for (size_t i = 0; i < iFirst; ++i)
+   {
+      Records_.erase(order[i].second);
+   }
+
+   Generation_++;
+   ScannedEnd_ = buffer.size();
+   LiveBytes_ = buffer.size();
+
+   Write(0, buffer);
+   Cut(ScannedEnd_);
+}
+
+#ifdef _WIN32
+
+bool disk_index::Write(const unsigned long long iOffset, const std::vector<char>& buffer)
+{
+   OVERLAPPED overlapped;
+   std::memset(&overlapped, 0, sizeof(overlapped));
+   overlapped.Offset = (DWORD) (iOffset & 0xFFFFFFFF);
+   overlapped.OffsetHigh = (DWORD) (iOffset >> 32);
+
+   DWORD dwWritten = 0;
+   return WriteFile(File_, &buffer[0], (DWORD) buffer.size(), &dwWritten, &overlapped)
+         && dwWritten == buffer.size();
+}
+
+unsigned long long disk_index::GetSize() const
+{
+   LARGE_INTEGER size;
+   return GetFileSizeEx(File_, &size) ? size.QuadPart : 0;
+}
+
+bool disk_index::Truncate(const unsigned long long iSize)
+{
+   // a mapped file can not be shortened
+   View_.reset();
+   LARGE_INTEGER pos;
+   pos.QuadPart = iSize;
+   return SetFilePointerEx(File_, pos, NULL, FILE_BEGIN) && SetEndOfFile(File_);
+}
+
+#else
+
+bool disk_index::Write(const unsigned long long iOffset, const std::vector<char>& buffer)
+{
+   return pwrite(File_, &buffer[0], buffer.size(), (off_t) iOffset) == (ssize_t) buffer.size();
+}
+
+unsigned long long disk_index::GetSize() const
+{
+   struct stat data;
+   return 0 == fstat(File_, &data) ? data.st_size : 0;
+}
+
+bool disk_index::Truncate(const unsigned long long iSize)
+{
+   // pages past the new end of a mapping can not be read
+   View_.reset();
+   return 0 == ftruncate(File_, (off_t) iSize);
+}
+
+#endif
+
+}
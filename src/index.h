@@ -0,0 +1,93 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "compat.h"
+#include "metadata.h"
+#include "utils.h"
+
+namespace wdx
+{
+
+/// persistent metadata storage shared by all running TC instances.
+/// Records are appended to the end of the file, the latest record of a
+/// file wins. Readers use a mapping of the file, kept between lookups,
+/// while holding a shared lock, writers append and compact while holding
+/// an exclusive one.
+class disk_index
+{
+public:
+   disk_index();
+   ~disk_index();
+
+   void Open(const std::string& sFileName, const size_t iMaxBytes);
+   void Close();
+
+   /// looks for data of a file which was not changed since it was stored
+   bool Find(const std::wstring& sFileName, const utils::file_stamp& stamp, metadata_ptr& data);
+   void Store(const std::wstring& sFileName, const utils::file_stamp& stamp, const metadata_ptr& data);
+
+private:
+   class file_lock;
+   class view;
+
+#ifdef _WIN32
+   typedef HANDLE handle_t;
+#else
+   typedef int handle_t;
+#endif
+   static const handle_t NoFile;
+
+   struct record
+   {
+      utils::file_stamp m_Stamp;
+      unsigned long long m_Offset;
+      unsigned int m_Size;
+
+      record() :
+            m_Offset(0), m_Size(0)
+      {
+      }
+   };
+
+   typedef std::unordered_map<std::wstring, record> records_t;
+
+   const view& Map();
+   bool Sync(const view& data);
+   void Scan(const view& data);
+   void Reset();
+   void Compact(const bool bShrink);
+   void Cut(const unsigned long long iSize);
+   unsigned long long GetSize() const;
+   bool Write(const unsigned long long iOffset, const std::vector<char>& buffer);
+   bool Truncate(const unsigned long long iSize);
+
+   std::mutex Mutex_;
+   handle_t File_;
+   std::unique_ptr<view> View_;
+   size_t MaxBytes_;
+   records_t Records_;
+   unsigned int Generation_;
+   unsigned long long ScannedEnd_;
+   unsigned long long LiveBytes_;
+};
+}
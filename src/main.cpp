@@ -17,10 +17,14 @@
 
 #include "main.h"
 #include "plugin.h"
+#include "timeline.h"
+#include "trace.h"
 #include "utils.h"
 #include "cunicode.h"
 
 wdx::plugin& plugin_inst = utils::singleton<wdx::plugin>::instance();
+wdx::trace_writer& trace_inst = utils::singleton<wdx::trace_writer>::instance();
+wdx::timeline& timeline_inst = utils::singleton<wdx::timeline>::instance();
 
 BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD fdwReason, LPVOID lpvReserved)
 {
@@ -56,24 +60,41 @@ extern "C" void DLL_EXPORT __stdcall ContentSetDefaultParams(ContentDefaultParam
    if (sizeof(ContentDefaultParamStruct) != dps->size)
       return;
 
+   // calls made by TC are recorded for replaying them offline
+   trace_inst.Open(utils::GetIniString(dps->DefaultIniName, "wdxtaglib", "TraceFile"));
+   // and timelines of the plugin work are written for trace viewers
+   timeline_inst.Open(utils::GetIniString(dps->DefaultIniName, "wdxtaglib", "TimelineFile"));
+
    plugin_inst.SetIniName(dps->DefaultIniName);
    plugin_inst.SetPluginInterfaceVersion(dps->PluginInterfaceVersionHi, dps->PluginInterfaceVersionLow);
 }
 
 extern "C" void DLL_EXPORT __stdcall ContentPluginUnloading(void)
 {
-   // free plugin instance here
+   {
+      wdx::trace_scope trace(trace_inst, wdx::callPluginUnloading);
+      wdx::timeline_span span(timeline_inst, "ContentPluginUnloading", "call");
+      // worker threads must be stopped here, it is too late in DllMain
+      plugin_inst.PluginUnloading();
+   }
+   trace_inst.Close();
+   timeline_inst.Close();
 }
 
 extern "C" int DLL_EXPORT __stdcall ContentGetSupportedField(int FieldIndex, char* FieldName, char* Units, int maxlen)
 {
-   return plugin_inst.GetSupportedField(FieldIndex, FieldName, Units, maxlen);
+   wdx::timeline_span span(timeline_inst, "ContentGetSupportedField", "call");
+   wdx::trace_scope trace(trace_inst, wdx::callGetSupportedField, nullptr, FieldIndex);
+   return trace.Result(plugin_inst.GetSupportedField(FieldIndex, FieldName, Units, maxlen));
 }
 
 extern "C" int DLL_EXPORT __stdcall ContentGetValueW(WCHAR* FileName, int FieldIndex,
       int UnitIndex, void* FieldValue, int maxlen, int flags)
 {
-   return plugin_inst.GetValue(FileName, FieldIndex, UnitIndex, FieldValue, maxlen, flags);
+   wdx::timeline_span span(timeline_inst, "ContentGetValueW", "call", FileName);
+   wdx::trace_scope trace(trace_inst, wdx::callGetValue, FileName, FieldIndex, UnitIndex, flags);
+   trace.SetMaxLen(maxlen);
+   return trace.Result(plugin_inst.GetValue(FileName, FieldIndex, UnitIndex, FieldValue, maxlen, flags));
 }
 
 extern "C" int DLL_EXPORT __stdcall ContentGetValue(char* FileName, int FieldIndex,
@@ -86,13 +107,28 @@ extern "C" int DLL_EXPORT __stdcall ContentGetValue(char* FileName, int FieldInd
 
 extern "C" int DLL_EXPORT __stdcall ContentGetSupportedFieldFlags(int FieldIndex)
 {
-   return plugin_inst.GetSupportedFieldFlags(FieldIndex);
+   wdx::timeline_span span(timeline_inst, "ContentGetSupportedFieldFlags", "call");
+   wdx::trace_scope trace(trace_inst, wdx::callGetSupportedFieldFlags, nullptr, FieldIndex);
+   return trace.Result(plugin_inst.GetSupportedFieldFlags(FieldIndex));
+}
+
+extern "C" int DLL_EXPORT __stdcall ContentGetDefaultSortOrder(int FieldIndex)
+{
+   wdx::timeline_span span(timeline_inst, "ContentGetDefaultSortOrder", "call");
+   wdx::trace_scope trace(trace_inst, wdx::callGetDefaultSortOrder, nullptr, FieldIndex);
+   return trace.Result(plugin_inst.GetDefaultSortOrder(FieldIndex));
 }
 
 extern "C" int DLL_EXPORT __stdcall ContentSetValueW(WCHAR* FileName, int FieldIndex,
       int UnitIndex, int FieldType, void* FieldValue, int flags)
 {
-   return plugin_inst.SetValue(FileName, FieldIndex, UnitIndex, FieldType, FieldValue, flags);
+   wdx::timeline_span span(timeline_inst, "ContentSetValueW", "call", FileName);
+   const bool bEnd = !FileName || -1 == FieldIndex;
+   wdx::trace_scope trace(trace_inst, bEnd ? wdx::callEndOfSetValue : wdx::callSetValue, FileName, FieldIndex,
+         UnitIndex, flags);
+   if (!bEnd)
+      trace.SetValue(FieldType, FieldValue);
+   return trace.Result(plugin_inst.SetValue(FileName, FieldIndex, UnitIndex, FieldType, FieldValue, flags));
 }
 
 extern "C" int DLL_EXPORT __stdcall ContentSetValue(char* FileName, int FieldIndex,
@@ -102,3 +138,46 @@ extern "C" int DLL_EXPORT __stdcall ContentSetValue(char* FileName, int FieldInd
    return ContentSetValueW(awfilenamecopy(FileNameW,FileName), FieldIndex,
          UnitIndex, FieldType, FieldValue, flags);
 }
+
+extern "C" void DLL_EXPORT __stdcall ContentStopGetValueW(WCHAR* FileName)
+{
+   wdx::timeline_span span(timeline_inst, "ContentStopGetValueW", "call", FileName);
+   wdx::trace_scope trace(trace_inst, wdx::callStopGetValue, FileName);
+   plugin_inst.StopGetValue(FileName);
+}
+
+extern "C" void DLL_EXPORT __stdcall ContentStopGetValue(char* FileName)
+{
+   WCHAR FileNameW[MAX_PATH];
+   ContentStopGetValueW(awfilenamecopy(FileNameW, FileName));
+}
+
+extern "C" void DLL_EXPORT __stdcall ContentSendStateInformationW(int state, WCHAR* path)
+{
+   wdx::timeline_span span(timeline_inst, "ContentSendStateInformationW", "call", path);
+   wdx::trace_scope trace(trace_inst, wdx::callSendStateInformation, path, state);
+   plugin_inst.SendStateInformation(state, path);
+}
+
+extern "C" void DLL_EXPORT __stdcall ContentSendStateInformation(int state, char* path)
+{
+   WCHAR pathW[MAX_PATH];
+   ContentSendStateInformationW(state, awfilenamecopy(pathW, path));
+}
+
+extern "C" int DLL_EXPORT __stdcall ContentCompareFilesW(PROGRESSCALLBACKPROC progresscallback, int compareindex,
+      WCHAR* filename1, WCHAR* filename2, FileDetailsStruct* filedetails)
+{
+   wdx::timeline_span span(timeline_inst, "ContentCompareFilesW", "call", filename1);
+   wdx::trace_scope trace(trace_inst, wdx::callCompareFiles, filename1, compareindex);
+   trace.SetFileName2(filename2);
+   return trace.Result(plugin_inst.CompareFiles(progresscallback, compareindex, filename1, filename2));
+}
+
+extern "C" int DLL_EXPORT __stdcall ContentCompareFiles(PROGRESSCALLBACKPROC progresscallback, int compareindex,
+      char* filename1, char* filename2, FileDetailsStruct* filedetails)
+{
+   WCHAR filename1W[MAX_PATH], filename2W[MAX_PATH];
+   return ContentCompareFilesW(progresscallback, compareindex, awfilenamecopy(filename1W, filename1),
+         awfilenamecopy(filename2W, filename2), filedetails);
+}
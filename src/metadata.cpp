@@ -0,0 +1,142 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "metadata.h"
+
+namespace wdx
+{
+
+static bool ReadBool(serial_reader& reader, bool& value)
+{
+   unsigned char iValue = 0;
+   if (!reader.U8(iValue))
+      return false;
+   value = iValue != 0;
+   return true;
+}
+
+void property_list::Add(const std::wstring& sKey, const std::wstring& sValue)
+{
+   // zeros inside of the strings would break the layout, cut them there
+   Data_.append(sKey.c_str()).append(1, L'\0').append(sValue.c_str()).append(1, L'\0');
+}
+
+const wchar_t* property_list::Find(const std::wstring& sKey) const
+{
+   // few properties per file, a linear scan over one block is fast enough
+   const wchar_t* p = Data_.c_str();
+   const wchar_t* pEnd = p + Data_.size();
+   while (p < pEnd)
+   {
+      const wchar_t* pValue = p + std::char_traits<wchar_t>::length(p) + 1;
+      if (0 == sKey.compare(p))
+         return pValue;
+      p = pValue + std::char_traits<wchar_t>::length(pValue) + 1;
+   }
+   return nullptr;
+}
+
+void property_list::Serialize(serial_writer& writer) const
+{
+   writer.WString(Data_);
+}
+
+bool property_list::Deserialize(serial_reader& reader)
+{
+   // the last string must be terminated for Find to stay inside
+   return reader.WString(Data_) && (Data_.empty() || L'\0' == Data_[Data_.size() - 1]);
+}
+
+size_t metadata::GetMemSize() const
+{
+   return sizeof(metadata)
+         + (m_Title.capacity() + m_Artist.capacity() + m_Album.capacity()
+               + m_Comment.capacity() + m_Genre.capacity() + m_TitleKey.capacity() + m_ArtistKey.capacity()
+               + m_AlbumKey.capacity()) * sizeof(wchar_t)
+         + m_TagType.capacity() + m_PictureMime.capacity() + m_Properties.GetMemSize();
+}
+
+void metadata::Serialize(serial_writer& writer) const
+{
+   writer.WString(m_Title);
+   writer.WString(m_Artist);
+   writer.WString(m_Album);
+   writer.WString(m_Comment);
+   writer.WString(m_Genre);
+   writer.I32(m_Year);
+   writer.I32(m_Track);
+   writer.WString(m_TitleKey);
+   writer.WString(m_ArtistKey);
+   writer.WString(m_AlbumKey);
+   writer.U32(m_CollationId);
+
+   writer.I32(m_Bitrate);
+   writer.I32(m_Samplerate);
+   writer.I32(m_Channels);
+   writer.I32(m_Length);
+   writer.I32(m_LengthMs);
+
+   writer.String(m_TagType);
+   m_Properties.Serialize(writer);
+   writer.I32(m_Format);
+
+   writer.U8(m_HasTag);
+   writer.U8(m_HasProperties);
+   writer.U64(m_AudioHash);
+   writer.I32(m_AudioHashState);
+   writer.String(m_PictureMime);
+   writer.I32(m_PictureSize);
+   writer.I32(m_PictureWidth);
+   writer.I32(m_PictureHeight);
+   writer.I32(m_PictureState);
+   writer.I32(m_PropertiesStyle);
+}
+
+bool metadata::Deserialize(serial_reader& reader)
+{
+   return reader.WString(m_Title)
+         && reader.WString(m_Artist)
+         && reader.WString(m_Album)
+         && reader.WString(m_Comment)
+         && reader.WString(m_Genre)
+         && reader.I32(m_Year)
+         && reader.I32(m_Track)
+         && reader.WString(m_TitleKey)
+         && reader.WString(m_ArtistKey)
+         && reader.WString(m_AlbumKey)
+         && reader.U32(m_CollationId)
+         && reader.I32(m_Bitrate)
+         && reader.I32(m_Samplerate)
+         && reader.I32(m_Channels)
+         && reader.I32(m_Length)
+         && reader.I32(m_LengthMs)
+         && reader.String(m_TagType)
+         && m_Properties.Deserialize(reader)
+         && reader.I32(m_Format)
+         && ReadBool(reader, m_HasTag)
+         && ReadBool(reader, m_HasProperties)
+         && reader.U64(m_AudioHash)
+         && reader.I32(m_AudioHashState)
+         && reader.String(m_PictureMime)
+         && reader.I32(m_PictureSize)
+         && reader.I32(m_PictureWidth)
+         && reader.I32(m_PictureHeight)
+         && reader.I32(m_PictureState)
+         && reader.I32(m_PropertiesStyle);
+}
+
+}
@@ -0,0 +1,131 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include "serial.h"
+
+namespace wdx
+{
+
+/// tag properties of a file packed in a single string: key, value, key,
+/// value... each terminated by zero. Keys are upper case as TagLib gives
+/// them, several values of a key are joined.
+class property_list
+{
+public:
+   void Add(const std::wstring& sKey, const std::wstring& sValue);
+
+   /// value of the key, nullptr if there is no such key
+   const wchar_t* Find(const std::wstring& sKey) const;
+
+   bool IsEmpty() const
+   {
+      return Data_.empty();
+   }
+
+   size_t GetMemSize() const
+   {
+      return Data_.capacity() * sizeof(wchar_t);
+   }
+
+   void Serialize(serial_writer& writer) const;
+   bool Deserialize(serial_reader& reader);
+
+private:
+   std::wstring Data_;
+};
+
+/// values of all plugin fields, extracted from a file with a single parse
+struct metadata
+{
+   std::wstring m_Title;
+   std::wstring m_Artist;
+   std::wstring m_Album;
+   std::wstring m_Comment;
+   std::wstring m_Genre;
+   int m_Year;
+   int m_Track;
+
+   /// sort keys of the strings above, built with the collation of m_CollationId
+   std::wstring m_TitleKey;
+   std::wstring m_ArtistKey;
+   std::wstring m_AlbumKey;
+   unsigned int m_CollationId;
+
+   int m_Bitrate;
+   int m_Samplerate;
+   int m_Channels;
+   int m_Length; // seconds
+   int m_LengthMs;
+
+   std::string m_TagType;
+   /// all tag properties, extra fields are looked up there
+   property_list m_Properties;
+   /// format_t the file was opened as
+   int m_Format;
+
+   /// XXH64 of the audio data without tags, computed only on request
+   unsigned long long m_AudioHash;
+   int m_AudioHashState;
+
+   /// embedded picture, the front cover if there are several, read only on request
+   std::string m_PictureMime;
+   int m_PictureSize; // bytes, 0 if there is no picture
+   int m_PictureWidth; // pixels, 0 if unknown
+   int m_PictureHeight;
+   int m_PictureState;
+
+   bool m_HasTag;
+   bool m_HasProperties;
+   /// TagLib::AudioProperties::ReadStyle used to read audio properties,
+   /// NoProperties if only tags were read
+   int m_PropertiesStyle;
+
+   static const int NoProperties = -1;
+
+   /// values of m_PictureState, pictures of some formats are not looked for
+   static const int PictureNotRead = 0;
+   static const int PictureNotSupported = 1;
+   static const int PictureRead = 2;
+
+   /// values of m_AudioHashState, a file which could not be hashed is not read again until it changes
+   static const int AudioHashNotRead = 0;
+   static const int AudioHashFailed = 1;
+   static const int AudioHashRead = 2;
+
+   metadata() :
+         m_Year(0), m_Track(0), m_CollationId(0), m_Bitrate(0), m_Samplerate(0), m_Channels(0), m_Length(0),
+               m_LengthMs(0), m_Format(0), m_AudioHash(0), m_AudioHashState(AudioHashNotRead), m_PictureSize(0), m_PictureWidth(0), m_PictureHeight(0),
+               m_PictureState(PictureNotRead), m_HasTag(false), m_HasProperties(false), m_PropertiesStyle(NoProperties)
+   {
+   }
+
+   /// approximate amount of heap memory held by this object
+   size_t GetMemSize() const;
+
+   /// must be incremented on every change of the serialized layout
+   static const unsigned int SerialVersion = 9;
+
+   void Serialize(serial_writer& writer) const;
+   bool Deserialize(serial_reader& reader);
+};
+
+typedef std::shared_ptr<const metadata> metadata_ptr;
+}
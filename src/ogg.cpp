@@ -0,0 +1,144 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include <algorithm>
+#include "ogg.h"
+
+namespace wdx
+{
+
+static unsigned int ReadLE32(const unsigned char* p)
+{
+   return (unsigned int) p[0] | (unsigned int) p[1] << 8 | (unsigned int) p[2] << 16 | (unsigned int) p[3] << 24;
+}
+
+static void WriteLE32(unsigned char* p, const unsigned int iValue)
+{
+   p[0] = iValue & 0xFF;
+   p[1] = (iValue >> 8) & 0xFF;
+   p[2] = (iValue >> 16) & 0xFF;
+   p[3] = (iValue >> 24) & 0xFF;
+}
+
+/// CRC-32 with polynomial 0x04C11DB7, no reflection, zero initial value
+static unsigned int OggChecksum(const unsigned char* pData, const size_t iSize, unsigned int iCrc)
+{
+   static const struct table
+   {
+      unsigned int m_Values[256];
+
+      table()
+      {
+         for (unsigned int i = 0; i < 256; ++i)
+         {
+            unsigned int r = i << 24;
+            for (int j = 0; j < 8; ++j)
+               r = (r & 0x80000000) ? (r << 1) ^ 0x04C11DB7 : r << 1;
+            m_Values[i] = r;
+         }
+      }
+   } crcTable;
+
+   for (size_t i = 0; i < iSize; ++i)
+      iCrc = (iCrc << 8) ^ crcTable.m_Values[((iCrc >> 24) ^ pData[i]) & 0xFF];
+   return iCrc;
+}
+
+const long ogg_page::FixedHeaderSize;
+const size_t ogg_page::MaxSegments;
+
+long ogg_page::GetBodySize() const
+{
+   long iSize = 0;
+   for (unsigned char iSegment : m_Lacing)
+      iSize += iSegment;
+   return iSize;
+}
+
+bool ogg_page::HasPacketEnd() const
+{
+   for (unsigned char iSegment : m_Lacing)
+   {
+      if (iSegment < 255)
+         return true;
+   }
+   return false;
+}
+
+/// fields of the fixed part of the header, false if it is not a page
+static bool ParseFixedHeader(const unsigned char* p, const long iOffset, ogg_page& page)
+{
+   if (p[0] != 'O' || p[1] != 'g' || p[2] != 'g' || p[3] != 'S' || p[4] != 0)
+      return false;
+
+   page.m_Offset = iOffset;
+   page.m_Flags = p[5];
+   page.m_Granule = (long long) ((unsigned long long) ReadLE32(p + 6) | (unsigned long long) ReadLE32(p + 10) << 32);
+   page.m_Serial = ReadLE32(p + 14);
+   page.m_Sequence = ReadLE32(p + 18);
+   return true;
+}
+
+bool ReadOggPage(TagLib::IOStream* pStream, const long iOffset, ogg_page& page)
+{
+   pStream->seek(iOffset);
+   const TagLib::ByteVector header = pStream->readBlock(ogg_page::FixedHeaderSize);
+   const unsigned char* p = (const unsigned char*) header.data();
+   if (header.size() != (TagLib::uint) ogg_page::FixedHeaderSize || !ParseFixedHeader(p, iOffset, page))
+      return false;
+
+   const TagLib::ByteVector lacing = pStream->readBlock(p[26]);
+   if (lacing.size() != p[26])
+      return false;
+   page.m_Lacing.assign((const unsigned char*) lacing.data(), (const unsigned char*) lacing.data() + lacing.size());
+
+   return true;
+}
+
+bool ParseOggPage(const char* pData, const size_t iSize, const long iOffset, ogg_page& page)
+{
+   const unsigned char* p = (const unsigned char*) pData;
+   if (iSize < (size_t) ogg_page::FixedHeaderSize || iSize < ogg_page::FixedHeaderSize + (size_t) p[26]
+         || !ParseFixedHeader(p, iOffset, page))
+      return false;
+
+   page.m_Lacing.assign(p + ogg_page::FixedHeaderSize, p + ogg_page::FixedHeaderSize + p[26]);
+   return true;
+}
+
+TagLib::ByteVector RenderOggPage(const ogg_page& page, const TagLib::ByteVector& body)
+{
+   TagLib::ByteVector data(page.GetHeaderSize() + body.size(), 0);
+   unsigned char* p = (unsigned char*) data.data();
+
+   std::copy("OggS", "OggS" + 4, p);
+   p[4] = 0; // version
+   p[5] = page.m_Flags;
+   WriteLE32(p + 6, (unsigned int) ((unsigned long long) page.m_Granule & 0xFFFFFFFF));
+   WriteLE32(p + 10, (unsigned int) ((unsigned long long) page.m_Granule >> 32));
+   WriteLE32(p + 14, page.m_Serial);
+   WriteLE32(p + 18, page.m_Sequence);
+   p[26] = (unsigned char) page.m_Lacing.size();
+   std::copy(page.m_Lacing.begin(), page.m_Lacing.end(), p + ogg_page::FixedHeaderSize);
+   std::copy(body.begin(), body.end(), (char*) p + page.GetHeaderSize());
+
+   // checksum is calculated with its own field zeroed
+   WriteLE32(p + 22, OggChecksum(p, data.size(), 0));
+
+   return data;
+}
+
+}
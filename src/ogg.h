@@ -0,0 +1,76 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#pragma once
+
+#include <vector>
+#include <tbytevector.h>
+#include <tiostream.h>
+
+namespace wdx
+{
+
+/// header of an Ogg page, see RFC 3533
+struct ogg_page
+{
+   enum flags_t
+   {
+      Continued = 0x01, // first packet on the page continues one from the previous page
+      FirstPage = 0x02,
+      LastPage = 0x04,
+   };
+
+   long m_Offset; // of the page in the stream
+   unsigned char m_Flags;
+   long long m_Granule;
+   unsigned int m_Serial;
+   unsigned int m_Sequence;
+   std::vector<unsigned char> m_Lacing; // segment table
+
+   static const long FixedHeaderSize = 27;
+   static const size_t MaxSegments = 255;
+
+   ogg_page() :
+         m_Offset(0), m_Flags(0), m_Granule(0), m_Serial(0), m_Sequence(0)
+   {
+   }
+
+   long GetHeaderSize() const
+   {
+      return FixedHeaderSize + (long) m_Lacing.size();
+   }
+
+   long GetBodySize() const;
+
+   long GetSize() const
+   {
+      return GetHeaderSize() + GetBodySize();
+   }
+
+   /// some packet is completed on this page
+   bool HasPacketEnd() const;
+};
+
+/// reads header of the page at the offset, false if there is no valid page
+bool ReadOggPage(TagLib::IOStream* pStream, const long iOffset, ogg_page& page);
+
+/// parses header of the page at the start of the data read from the offset,
+/// false if there is no valid page or the data ends inside the header
+bool ParseOggPage(const char* pData, const size_t iSize, const long iOffset, ogg_page& page);
+
+/// renders page with the body, checksum is calculated
+TagLib::ByteVector RenderOggPage(const ogg_page& page, const TagLib::ByteVector& body);
+}
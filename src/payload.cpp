@@ -0,0 +1,529 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include "hash.h"
+#include "ogg.h"
+#include "payload.h"
+
+namespace wdx
+{
+
+static const long ID3v1Size = 128;
+static const long ID3v2HeaderSize = 10;
+static const long APEFooterSize = 32;
+static const size_t HashBlockSize = 1024 * 1024;
+// reading the next block while hashing the current one pays off only for big files
+static const long long ParallelHashSize = 8 * 1024 * 1024;
+// Ogg page headers are parsed from blocks of this size
+static const long OggScanBlockSize = 1024 * 1024;
+static const long MaxOggHeaderSize = ogg_page::FixedHeaderSize + (long) ogg_page::MaxSegments;
+// ranges closer than this are read together with the bytes between them
+static const long MaxGapSize = 64 * 1024;
+
+static unsigned int ReadLE32(const unsigned char* p)
+{
+   return p[0] | p[1] << 8 | p[2] << 16 | (unsigned int) p[3] << 24;
+}
+
+static unsigned int ReadBE32(const unsigned char* p)
+{
+   return (unsigned int) p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+static unsigned long long ReadLE64(const unsigned char* p)
+{
+   return ReadLE32(p) | (unsigned long long) ReadLE32(p + 4) << 32;
+}
+
+static unsigned long long ReadBE64(const unsigned char* p)
+{
+   return (unsigned long long) ReadBE32(p) << 32 | ReadBE32(p + 4);
+}
+
+/// reads exactly the given number of bytes, false at the end of stream
+static bool ReadAt(TagLib::IOStream* pStream, const long iOffset, const long iSize, TagLib::ByteVector& data)
+{
+   if (iOffset < 0)
+      return false;
+   pStream->seek(iOffset);
+   data = pStream->readBlock(iSize);
+   return data.size() == (TagLib::uint) iSize;
+}
+
+static const unsigned char* Bytes(const TagLib::ByteVector& data)
+{
+   return (const unsigned char*) data.data();
+}
+
+/// adds range clipped to the stream
+static void AddRange(byte_ranges_t& ranges, const long iOffset, const long long iLength, const long iStreamLength)
+{
+   const long long iEnd = std::min((long long) iStreamLength, (long long) iOffset + iLength);
+   if (iEnd > iOffset)
+      ranges.push_back(byte_range(iOffset, (long) (iEnd - iOffset)));
+}
+
+/// size of the ID3v2 tags at the offset, 0 if there are none
+static long GetID3v2Size(TagLib::IOStream* pStream, const long iOffset)
+{
+   long iSize = 0;
+   TagLib::ByteVector header;
+   // some taggers stack several tags
+   while (ReadAt(pStream, iOffset + iSize, ID3v2HeaderSize, header) && header.startsWith("ID3"))
+   {
+      const unsigned char* p = Bytes(header);
+      iSize += ID3v2HeaderSize + ((p[6] & 0x7F) << 21 | (p[7] & 0x7F) << 14 | (p[8] & 0x7F) << 7 | (p[9] & 0x7F));
+      if (p[5] & 0x10) // footer present
+         iSize += ID3v2HeaderSize;
+   }
+   return iSize;
+}
+
+/// moves the end before ID3v1 and APE tags at the end of the stream
+static long GetEndWithoutTags(TagLib::IOStream* pStream, long iEnd)
+{
+   TagLib::ByteVector data;
+   for (;;)
+   {
+      if (ReadAt(pStream, iEnd - ID3v1Size, 3, data) && data == TagLib::ByteVector("TAG", 3))
+      {
+         iEnd -= ID3v1Size;
+         continue;
+      }
+
+      if (ReadAt(pStream, iEnd - APEFooterSize, APEFooterSize, data) && data.startsWith("APETAGEX"))
+      {
+         // size includes the footer but not the header
+         const unsigned char* p = Bytes(data);
+         long iSize = (long) ReadLE32(p + 12);
+         if (ReadLE32(p + 20) & 0x80000000)
+            iSize += APEFooterSize;
+         if (iSize < APEFooterSize || iSize > iEnd)
+            return iEnd;
+         iEnd -= iSize;
+         continue;
+      }
+
+      return iEnd;
+   }
+}
+
+/// formats with tags only in front of or behind the audio data
+static bool GetRawRanges(TagLib::IOStream* pStream, byte_ranges_t& ranges)
+{
+   const long iBegin = GetID3v2Size(pStream, 0);
+   const long iEnd = GetEndWithoutTags(pStream, pStream->length());
+   AddRange(ranges, iBegin, iEnd - iBegin, iEnd);
+   return true;
+}
+
+static bool GetFLACRanges(TagLib::IOStream* pStream, byte_ranges_t& ranges)
+{
+   long iPos = GetID3v2Size(pStream, 0);
+   TagLib::ByteVector data;
+   if (!ReadAt(pStream, iPos, 4, data) || data != TagLib::ByteVector("fLaC", 4))
+      return false;
+
+   // all metadata blocks, including padding and pictures, come before the frames
+   iPos += 4;
+   for (;;)
+   {
+      if (!ReadAt(pStream, iPos, 4, data))
+         return false;
+      const unsigned char* p = Bytes(data);
+      iPos += 4 + (p[1] << 16 | p[2] << 8 | p[3]);
+      if (p[0] & 0x80) // last block
+         break;
+   }
+
+   const long iEnd = GetEndWithoutTags(pStream, pStream->length());
+   AddRange(ranges, iPos, iEnd - iPos, iEnd);
+   return true;
+}
+
+/// number of header packets in front of the audio packets, 0 if unknown
+static unsigned int GetOggHeaderPackets(const format_t format, const TagLib::ByteVector& packet)
+{
+   const unsigned char* p = Bytes(packet);
+   switch (format)
+   {
+      case fmtOggVorbis:
+         return 3;
+      case fmtOpus:
+         return 2;
+      case fmtSpeex:
+         // the comment and the extra headers follow the first packet
+         return packet.size() >= 72 ? 2 + std::min(ReadLE32(p + 68), 16U) : 0;
+      case fmtOggFLAC:
+         // the first packet tells how many metadata blocks follow it
+         return packet.size() >= 9 && (p[7] << 8 | p[8]) > 0 ? 1 + (p[7] << 8 | p[8]) : 0;
+      default:
+         return 0;
+   }
+}
+
+/// bodies of the pages after the header packets. Comparing the bodies
+/// rather than the pages ignores page numbers and checksums, which change
+/// when the comment grows, and even a different pagination. Pages are a few
+/// kilobytes each, so their headers are parsed from big blocks of the stream.
+static bool GetOggRanges(TagLib::IOStream* pStream, const format_t format, byte_ranges_t& ranges)
+{
+   const long iLength = pStream->length();
+   TagLib::ByteVector block;
+   long iBlockOffset = 0;
+   ogg_page page;
+   unsigned int iHeaders = 0;
+   unsigned int iSerial = 0;
+   for (long iOffset = 0;; iOffset += page.GetSize())
+   {
+      // the header may continue behind the block
+      long iBlockEnd = iBlockOffset + (long) block.size();
+      if (iOffset >= iBlockEnd || (iOffset + MaxOggHeaderSize > iBlockEnd && iBlockEnd < iLength))
+      {
+         pStream->seek(iOffset);
+         block = pStream->readBlock(OggScanBlockSize);
+         iBlockOffset = iOffset;
+         iBlockEnd = iBlockOffset + (long) block.size();
+      }
+
+      const long iInBlock = iOffset - iBlockOffset;
+      if (!ParseOggPage(block.data() + iInBlock, iBlockEnd - iOffset, iOffset, page))
+         break;
+
+      if (0 == iOffset)
+      {
+         const long iPacketSize = std::min(page.GetBodySize(), 80L);
+         if (iInBlock + page.GetHeaderSize() + iPacketSize > (long) block.size())
+            return false;
+
+         iHeaders = GetOggHeaderPackets(format, block.mid(iInBlock + page.GetHeaderSize(), iPacketSize));
+         if (0 == iHeaders)
+            return false;
+         iSerial = page.m_Serial;
+      }
+
+      // other logical streams are not part of this codec's audio
+      if (page.m_Serial != iSerial)
+         continue;
+
+      long iBodyOffset = iOffset + page.GetHeaderSize();
+      long iBodySize = page.GetBodySize();
+      for (size_t i = 0; i < page.m_Lacing.size() && iHeaders > 0; ++i)
+      {
+         iBodyOffset += page.m_Lacing[i];
+         iBodySize -= page.m_Lacing[i];
+         if (page.m_Lacing[i] < 255)
+            --iHeaders;
+      }
+
+      if (0 == iHeaders)
+         AddRange(ranges, iBodyOffset, iBodySize, iLength);
+   }
+
+   return 0 == iHeaders;
+}
+
+/// content of mdat atoms, metadata lives in moov and may move around them
+static bool GetMP4Ranges(TagLib::IOStream* pStream, byte_ranges_t& ranges)
+{
+   const long iLength = pStream->length();
+   TagLib::ByteVector header;
+   for (long iPos = 0; iPos + 8 <= iLength;)
+   {
+      if (!ReadAt(pStream, iPos, 16, header) && !ReadAt(pStream, iPos, 8, header))
+         return false;
+
+      const unsigned char* p = Bytes(header);
+      long long iSize = ReadBE32(p);
+      long iHeaderSize = 8;
+      if (1 == iSize && header.size() >= 16)
+      {
+         iSize = (long long) ReadBE64(p + 8);
+         iHeaderSize = 16;
+      }
+      else if (0 == iSize) // atom extends to the end of file
+         iSize = iLength - iPos;
+
+      if (iSize < iHeaderSize)
+         return false;
+
+      if (0 == std::memcmp(p + 4, "mdat", 4))
+         AddRange(ranges, iPos + iHeaderSize, iSize - iHeaderSize, iLength);
+
+      if (iPos + iSize > iLength)
+         break;
+      iPos += (long) iSize;
+   }
+
+   return !ranges.empty();
+}
+
+static const char ASFHeaderGuid[] = "\x30\x26\xB2\x75\x8E\x66\xCF\x11\xA6\xD9\x00\xAA\x00\x62\xCE\x6C";
+static const char ASFDataGuid[] = "\x36\x26\xB2\x75\x8E\x66\xCF\x11\xA6\xD9\x00\xAA\x00\x62\xCE\x6C";
+// guid, size, file id, total packets, reserved
+static const long ASFDataHeaderSize = 16 + 8 + 16 + 8 + 2;
+
+/// packets of the data object, all metadata is in the header object
+static bool GetASFRanges(TagLib::IOStream* pStream, byte_ranges_t& ranges)
+{
+   TagLib::ByteVector header;
+   if (!ReadAt(pStream, 0, 24, header) || 0 != std::memcmp(header.data(), ASFHeaderGuid, 16))
+      return false;
+
+   const long iPos = (long) ReadLE64(Bytes(header) + 16);
+   if (!ReadAt(pStream, iPos, 24, header) || 0 != std::memcmp(header.data(), ASFDataGuid, 16))
+      return false;
+
+   AddRange(ranges, iPos + ASFDataHeaderSize, (long long) ReadLE64(Bytes(header) + 16) - ASFDataHeaderSize,
+         pStream->length());
+   return true;
+}
+
+/// format and sample chunks of RIFF/IFF files, tags are in other chunks
+static bool GetChunkRanges(TagLib::IOStream* pStream, const bool bBigEndian, const char* pFormatChunk,
+      const char* pDataChunk, byte_ranges_t& ranges)
+{
+   const long iLength = pStream->length();
+   TagLib::ByteVector header;
+   for (long iPos = 12; iPos + 8 <= iLength;)
+   {
+      if (!ReadAt(pStream, iPos, 8, header))
+         return false;
+
+      const unsigned char* p = Bytes(header);
+      const long long iSize = bBigEndian ? ReadBE32(p + 4) : ReadLE32(p + 4);
+      if (0 == std::memcmp(p, pFormatChunk, 4) || 0 == std::memcmp(p, pDataChunk, 4))
+         AddRange(ranges, iPos + 8, iSize, iLength);
+
+      // chunks are aligned to even offsets
+      iPos += (long) std::min(8 + iSize + (iSize & 1), (long long) iLength);
+   }
+
+   return !ranges.empty();
+}
+
+bool GetAudioRanges(TagLib::IOStream* pStream, const format_t format, byte_ranges_t& ranges)
+{
+   ranges.clear();
+
+   switch (format)
+   {
+      case fmtMPEG:
+      case fmtMPC:
+      case fmtWavPack:
+      case fmtTrueAudio:
+      case fmtAPE:
+         return GetRawRanges(pStream, ranges);
+      case fmtFLAC:
+         return GetFLACRanges(pStream, ranges);
+      case fmtOggVorbis:
+      case fmtOggFLAC:
+      case fmtSpeex:
+      case fmtOpus:
+         return GetOggRanges(pStream, format, ranges);
+      case fmtMP4:
+         return GetMP4Ranges(pStream, ranges);
+      case fmtASF:
+         return GetASFRanges(pStream, ranges);
+      case fmtAIFF:
+         return GetChunkRanges(pStream, true, "COMM", "SSND", ranges);
+      case fmtWAV:
+         return GetChunkRanges(pStream, false, "fmt ", "data", ranges);
+      default:
+         // titles of tracker modules are stored among the samples
+         return false;
+   }
+}
+
+long long GetRangesLength(const byte_ranges_t& ranges)
+{
+   long long iLength = 0;
+   for (const byte_range& range : ranges)
+      iLength += range.m_Length;
+   return iLength;
+}
+
+// bytes hashed, -1 if the token was signalled
+static long long HashSequential(range_reader& reader, const cancel_token& token, xxhash64& hash)
+{
+   std::vector<char> buffer(HashBlockSize);
+   long long iDone = 0;
+   while (const size_t iRead = reader.Read(buffer.data(), HashBlockSize))
+   {
+      if (token)
+         return -1;
+      hash.Update(buffer.data(), iRead);
+      iDone += iRead;
+   }
+   return iDone;
+}
+
+// one reader thread for the whole file fills the two buffers in turns
+// while this thread hashes the other one
+static long long HashOverlapped(range_reader& reader, const cancel_token& token, xxhash64& hash)
+{
+   std::vector<char> buffers[2] = { std::vector<char>(HashBlockSize), std::vector<char>(HashBlockSize) };
+   size_t sizes[2] = { 0, 0 };
+   bool full[2] = { false, false };
+   bool bStop = false;
+   std::mutex mutex;
+   std::condition_variable changed;
+
+   // the stream is used by the reader thread only
+   std::thread readThread([&]
+         {
+            for (int i = 0;; i ^= 1)
+            {
+               {
+                  std::unique_lock<std::mutex> lock(mutex);
+                  changed.wait(lock, [&] { return !full[i] || bStop; });
+                  if (bStop)
+                     return;
+               }
+
+               const size_t iRead = reader.Read(buffers[i].data(), HashBlockSize);
+               {
+                  std::lock_guard<std::mutex> lock(mutex);
+                  sizes[i] = iRead;
+                  full[i] = true;
+               }
+               changed.notify_all();
+               if (!iRead)
+                  return;
+            }
+         });
+
+   long long iDone = 0;
+   for (int i = 0;; i ^= 1)
+   {
+      size_t iRead = 0;
+      {
+         std::unique_lock<std::mutex> lock(mutex);
+         changed.wait(lock, [&] { return full[i]; });
+         iRead = sizes[i];
+      }
+      if (!iRead)
+         break;
+      if (token)
+      {
+         iDone = -1;
+         break;
+      }
+
+      hash.Update(buffers[i].data(), iRead);
+      iDone += iRead;
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         full[i] = false;
+      }
+      changed.notify_all();
+   }
+
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      bStop = true;
+   }
+   changed.notify_all();
+   readThread.join();
+   return iDone;
+}
+
+bool HashRanges(TagLib::IOStream* pStream, const byte_ranges_t& ranges, const cancel_token& token,
+      unsigned long long& iHash)
+{
+   const long long iLength = GetRangesLength(ranges);
+   range_reader reader(pStream, ranges);
+   xxhash64 hash;
+   const long long iDone = iLength > ParallelHashSize ? HashOverlapped(reader, token, hash)
+         : HashSequential(reader, token, hash);
+   if (iDone < 0)
+      return false;
+
+   iHash = hash.Digest();
+   return iDone == iLength;
+}
+
+range_reader::range_reader(TagLib::IOStream* pStream, const byte_ranges_t& ranges) :
+      Stream_(pStream), Ranges_(ranges), Range_(0), Position_(0)
+{
+}
+
+size_t range_reader::Read(char* pBuffer, const size_t iSize)
+{
+   size_t iDone = 0;
+   while (iDone < iSize && Range_ < Ranges_.size())
+   {
+      if (Position_ >= Ranges_[Range_].m_Length)
+      {
+         ++Range_;
+         Position_ = 0;
+         continue;
+      }
+
+      // one read covers all following ranges the request needs, with the
+      // small gaps between them, such as the headers of Ogg pages
+      const long iStart = Ranges_[Range_].m_Offset + Position_;
+      long iEnd = iStart;
+      size_t iWanted = iSize - iDone;
+      for (size_t i = Range_; i < Ranges_.size() && iWanted > 0; ++i)
+      {
+         const byte_range& range = Ranges_[i];
+         if (i > Range_ && (range.m_Offset < iEnd || range.m_Offset - iEnd > MaxGapSize))
+            break;
+
+         const long iFrom = i > Range_ ? range.m_Offset : iStart;
+         const long iTake = (long) std::min(iWanted, (size_t) (range.m_Offset + range.m_Length - iFrom));
+         iEnd = iFrom + iTake;
+         iWanted -= iTake;
+      }
+
+      Stream_->seek(iStart);
+      const TagLib::ByteVector data = Stream_->readBlock((TagLib::ulong) (iEnd - iStart));
+      const long iDataEnd = iStart + (long) data.size();
+      while (iDone < iSize && Range_ < Ranges_.size())
+      {
+         const byte_range& range = Ranges_[Range_];
+         const long iFrom = range.m_Offset + Position_;
+         if (iFrom < iStart || iFrom >= iDataEnd)
+            break;
+
+         const long iCopy = (long) std::min(iSize - iDone,
+               (size_t) std::min(range.m_Length - Position_, iDataEnd - iFrom));
+         std::memcpy(pBuffer + iDone, data.data() + (iFrom - iStart), iCopy);
+         iDone += iCopy;
+         Position_ += iCopy;
+         if (Position_ < range.m_Length)
+            break;
+         ++Range_;
+         Position_ = 0;
+      }
+
+      if (iDataEnd < iEnd)
+      {
+         // stream is shorter than it was
+         Range_ = Ranges_.size();
+         break;
+      }
+   }
+   return iDone;
+}
+}
@@ -0,0 +1,72 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <vector>
+#include <tiostream.h>
+#include "cancel.h"
+#include "formats.h"
+
+namespace wdx
+{
+
+/// part of a stream, [m_Offset, m_Offset + m_Length)
+struct byte_range
+{
+   long m_Offset;
+   long m_Length;
+
+   byte_range(const long iOffset = 0, const long iLength = 0) :
+         m_Offset(iOffset), m_Length(iLength)
+   {
+   }
+};
+
+typedef std::vector<byte_range> byte_ranges_t;
+
+/// finds parts of the stream which hold the audio data, without tags,
+/// pictures or padding, so that retagging a file does not change them.
+/// False if the format is not supported or the stream is damaged.
+bool GetAudioRanges(TagLib::IOStream* pStream, const format_t format, byte_ranges_t& ranges);
+
+/// total length of the ranges
+long long GetRangesLength(const byte_ranges_t& ranges);
+
+/// XXH64 of the ranges read as one piece, false if cancelled or the stream
+/// is shorter than the ranges
+bool HashRanges(TagLib::IOStream* pStream, const byte_ranges_t& ranges, const cancel_token& token,
+      unsigned long long& iHash);
+
+/// reads ranges of a stream as if they were one piece of data
+class range_reader
+{
+public:
+   /// stream is not owned
+   range_reader(TagLib::IOStream* pStream, const byte_ranges_t& ranges);
+
+   /// fills buffer with next bytes of the ranges, returns their number,
+   /// which is less than requested only at the end
+   size_t Read(char* pBuffer, const size_t iSize);
+
+private:
+   TagLib::IOStream* Stream_;
+   const byte_ranges_t& Ranges_;
+   size_t Range_; // current range
+   long Position_; // in the current range
+};
+}
@@ -0,0 +1,604 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <tbytevector.h>
+#include "picture.h"
+
+namespace wdx
+{
+
+static const long ID3v1Size = 128;
+static const long ID3v2HeaderSize = 10;
+static const long APEFooterSize = 32;
+// smallest read, headers of neighbouring frames and atoms come with one read
+static const long BlockSize = 4096;
+// enough for the fields in front of the image data and for the image headers
+static const long PrefixSize = 4096;
+// segments in front of the JPEG frame header, EXIF and ICC data come there
+static const int MaxJPEGSegments = 64;
+// ID3v2 picture type of the front cover, MP4 has only covers
+static const int FrontCover = 3;
+
+static unsigned int ReadLE16(const unsigned char* p)
+{
+   return p[0] | p[1] << 8;
+}
+
+static unsigned int ReadBE16(const unsigned char* p)
+{
+   return p[0] << 8 | p[1];
+}
+
+static unsigned int ReadLE32(const unsigned char* p)
+{
+   return p[0] | p[1] << 8 | p[2] << 16 | (unsigned int) p[3] << 24;
+}
+
+static unsigned int ReadBE32(const unsigned char* p)
+{
+   return (unsigned int) p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+static unsigned int ReadSyncSafe(const unsigned char* p)
+{
+   return (p[0] & 0x7F) << 21 | (p[1] & 0x7F) << 14 | (p[2] & 0x7F) << 7 | (p[3] & 0x7F);
+}
+
+/// serves small reads from one bigger block of the stream or from data read before
+class block_reader
+{
+public:
+   explicit block_reader(TagLib::IOStream* pStream) :
+         Stream_(pStream), Offset_(0)
+   {
+   }
+
+   /// data which was at the offset, nothing is read from a stream
+   block_reader(const TagLib::ByteVector& data, const long iOffset) :
+         Stream_(nullptr), Data_(data), Offset_(iOffset)
+   {
+   }
+
+   /// iSize bytes at the offset, nullptr if there are not so many
+   const unsigned char* Get(const long iOffset, const long iSize)
+   {
+      if (iOffset < Offset_ || iOffset + iSize > Offset_ + (long) Data_.size())
+      {
+         if (!Stream_ || iOffset < 0)
+            return nullptr;
+         Stream_->seek(iOffset);
+         Data_ = Stream_->readBlock((TagLib::ulong) std::max(iSize, BlockSize));
+         Offset_ = iOffset;
+         if ((long) Data_.size() < iSize)
+            return nullptr;
+      }
+      return (const unsigned char*) Data_.data() + (iOffset - Offset_);
+   }
+
+private:
+   TagLib::IOStream* Stream_;
+   TagLib::ByteVector Data_;
+   long Offset_;
+};
+
+/// picture chosen so far
+struct picture_choice
+{
+   picture_info m_Info;
+   int m_Type;
+   bool m_Found;
+
+   picture_choice() :
+         m_Type(0), m_Found(false)
+   {
+   }
+};
+
+/// dimensions and type of the image from its first bytes
+static void GetImageInfo(block_reader& reader, const long iOffset, const long iSize, picture_info& info)
+{
+   const unsigned char* p = reader.Get(iOffset, std::min(iSize, 30L));
+   if (!p || iSize < 12)
+      return;
+
+   if (iSize >= 24 && 0 == std::memcmp(p, "\x89PNG\r\n\x1A\n", 8) && 0 == std::memcmp(p + 12, "IHDR", 4))
+   {
+      info.m_Mime = "image/png";
+      info.m_Width = (int) ReadBE32(p + 16);
+      info.m_Height = (int) ReadBE32(p + 20);
+   }
+   else if (0 == std::memcmp(p, "GIF8", 4))
+   {
+      info.m_Mime = "image/gif";
+      info.m_Width = (int) ReadLE16(p + 6);
+      info.m_Height = (int) ReadLE16(p + 8);
+   }
+   else if (iSize >= 26 && 'B' == p[0] && 'M' == p[1])
+   {
+      info.m_Mime = "image/bmp";
+      info.m_Width = (int) ReadLE32(p + 18);
+      // negative height means rows stored top down
+      info.m_Height = std::abs((int) ReadLE32(p + 22));
+   }
+   else if (iSize >= 30 && 0 == std::memcmp(p, "RIFF", 4) && 0 == std::memcmp(p + 8, "WEBP", 4))
+   {
+      info.m_Mime = "image/webp";
+      if (0 == std::memcmp(p + 12, "VP8X", 4))
+      {
+         info.m_Width = 1 + (int) (p[24] | p[25] << 8 | p[26] << 16);
+         info.m_Height = 1 + (int) (p[27] | p[28] << 8 | p[29] << 16);
+      }
+      else if (0 == std::memcmp(p + 12, "VP8 ", 4))
+      {
+         info.m_Width = (int) (ReadLE16(p + 26) & 0x3FFF);
+         info.m_Height = (int) (ReadLE16(p + 28) & 0x3FFF);
+      }
+      else if (0 == std::memcmp(p + 12, "VP8L", 4))
+      {
+         info.m_Width = 1 + (int) ((p[22] & 0x3F) << 8 | p[21]);
+         info.m_Height = 1 + (int) ((p[24] & 0x0F) << 10 | p[23] << 2 | (p[22] & 0xC0) >> 6);
+      }
+   }
+   else if (0xFF == p[0] && 0xD8 == p[1])
+   {
+      info.m_Mime = "image/jpeg";
+      // walk the segments up to the frame header, each segment tells its length
+      long iPos = 2;
+      for (int i = 0; i < MaxJPEGSegments && iPos + 9 <= iSize; ++i)
+      {
+         p = reader.Get(iOffset + iPos, 9);
+         if (!p || 0xFF != p[0])
+            return;
+
+         const unsigned char iMarker = p[1];
+         if (0xFF == iMarker) // fill byte
+         {
+            ++iPos;
+            continue;
+         }
+         if (iMarker >= 0xC0 && iMarker <= 0xCF && 0xC4 != iMarker && 0xC8 != iMarker && 0xCC != iMarker)
+         {
+            info.m_Height = (int) ReadBE16(p + 5);
+            info.m_Width = (int) ReadBE16(p + 7);
+            return;
+         }
+         if (0xD9 == iMarker || 0xDA == iMarker) // end of image or start of scan
+            return;
+         if (0x01 == iMarker || (iMarker >= 0xD0 && iMarker <= 0xD8)) // no length
+            iPos += 2;
+         else
+            iPos += 2 + (long) ReadBE16(p + 2);
+      }
+   }
+}
+
+/// makes the picture the chosen one if there is none yet or if it is the
+/// front cover, image data at a negative offset cannot be read as is
+static void Choose(picture_choice& choice, block_reader& reader, const int iType, const std::string& sMime,
+      const long iOffset, const long iSize)
+{
+   if (iSize <= 0 || (choice.m_Found && (FrontCover == choice.m_Type || FrontCover != iType)))
+      return;
+
+   choice.m_Found = true;
+   choice.m_Type = iType;
+   choice.m_Info = picture_info();
+   choice.m_Info.m_Mime = sMime;
+   choice.m_Info.m_Size = (unsigned int) iSize;
+   // the image knows its type better than the tag
+   if (iOffset >= 0)
+      GetImageInfo(reader, iOffset, iSize, choice.m_Info);
+}
+
+/// offset after the zero which ends the text, wide text ends with two zeros
+/// at an even distance, -1 if there is none
+static long SkipText(const unsigned char* p, long iPos, const long iEnd, const bool bWide)
+{
+   if (bWide)
+   {
+      for (; iPos + 1 < iEnd; iPos += 2)
+      {
+         if (0 == p[iPos] && 0 == p[iPos + 1])
+            return iPos + 2;
+      }
+      return -1;
+   }
+
+   const void* pZero = std::memchr(p + iPos, 0, iEnd - iPos);
+   return pZero ? (const unsigned char*) pZero - p + 1 : -1;
+}
+
+/// ID3v2.2 stores three letter image formats instead of MIME types
+static std::string GetFormatMime(const unsigned char* p)
+{
+   if (0 == std::memcmp(p, "JPG", 3))
+      return "image/jpeg";
+   if (0 == std::memcmp(p, "PNG", 3))
+      return "image/png";
+   return std::string((const char*) p, 3);
+}
+
+/// APIC frame body: encoding, MIME type, picture type, description, image data
+static void ChooseID3v2Picture(picture_choice& choice, block_reader& reader, const int iVersion, long iPos,
+      long iSize, const bool bRaw)
+{
+   const long iPrefix = std::min(iSize, PrefixSize);
+   const unsigned char* p = reader.Get(iPos, iPrefix);
+   if (!p || iPrefix < 2)
+      return;
+
+   std::string sMime;
+   long iText = 0;
+   if (2 == iVersion)
+   {
+      if (iPrefix < 5)
+         return;
+      sMime = GetFormatMime(p + 1);
+      iText = 4;
+   }
+   else
+   {
+      iText = SkipText(p, 1, iPrefix, false);
+      if (iText < 0 || iText >= iPrefix)
+         return;
+      sMime.assign((const char*) p + 1, iText - 2);
+   }
+
+   // link to a file, not a picture
+   if ("-->" == sMime)
+      return;
+
+   const int iType = p[iText];
+   const long iData = SkipText(p, iText + 1, iPrefix, 1 == p[0] || 2 == p[0]);
+   if (iData < 0)
+   {
+      // the description does not fit in, the image is there anyway
+      Choose(choice, reader, iType, sMime, -1, iSize);
+      return;
+   }
+   Choose(choice, reader, iType, sMime, bRaw ? iPos + iData : -1, iSize - iData);
+}
+
+/// frames of a tag between the offsets
+static void ChooseID3v2Frames(picture_choice& choice, block_reader& reader, const int iVersion, const bool bUnsync,
+      long iPos, const long iEnd)
+{
+   const long iHeaderSize = 2 == iVersion ? 6 : 10;
+   while (iPos + iHeaderSize <= iEnd)
+   {
+      const unsigned char* p = reader.Get(iPos, iHeaderSize);
+      if (!p || 0 == p[0]) // padding
+         return;
+
+      long iSize = 0;
+      bool bPicture = false;
+      bool bReadable = true; // not compressed or encrypted
+      bool bRaw = !bUnsync;
+      long iSkip = 0;
+      if (2 == iVersion)
+      {
+         iSize = p[3] << 16 | p[4] << 8 | p[5];
+         bPicture = 0 == std::memcmp(p, "PIC", 3);
+      }
+      else
+      {
+         iSize = (long) (4 == iVersion ? ReadSyncSafe(p + 4) : ReadBE32(p + 4));
+         bPicture = 0 == std::memcmp(p, "APIC", 4);
+         const unsigned char iFlags = p[9];
+         if (3 == iVersion)
+         {
+            // compressed data starts with its size, encrypted with the method
+            bReadable = 0 == (iFlags & 0xC0);
+            iSkip = (iFlags & 0x80 ? 4 : 0) + (iFlags & 0x40 ? 1 : 0) + (iFlags & 0x20 ? 1 : 0);
+         }
+         else
+         {
+            bReadable = 0 == (iFlags & 0x0C);
+            bRaw = bRaw && 0 == (iFlags & 0x02);
+            iSkip = (iFlags & 0x40 ? 1 : 0) + (iFlags & 0x04 ? 1 : 0) + (iFlags & 0x01 ? 4 : 0);
+         }
+      }
+
+      if (iSize <= 0 || iPos + iHeaderSize + iSize > iEnd)
+         return;
+
+      if (bPicture && iSize > iSkip)
+      {
+         if (bReadable)
+            ChooseID3v2Picture(choice, reader, iVersion, iPos + iHeaderSize + iSkip, iSize - iSkip, bRaw);
+         else
+            Choose(choice, reader, 0, std::string(), -1, iSize - iSkip);
+      }
+      iPos += iHeaderSize + iSize;
+   }
+}
+
+/// removes the zero bytes inserted after 0xFF bytes
+static TagLib::ByteVector Resync(const TagLib::ByteVector& data)
+{
+   std::string sResult;
+   sResult.reserve(data.size());
+   for (TagLib::uint i = 0; i < data.size(); ++i)
+   {
+      sResult += data[i];
+      if ((char) 0xFF == data[i] && i + 1 < data.size() && 0 == data[i + 1])
+         ++i;
+   }
+   return TagLib::ByteVector(sResult.data(), (TagLib::uint) sResult.size());
+}
+
+/// pictures of the ID3v2 tags at the offset
+static void ChooseID3v2(picture_choice& choice, TagLib::IOStream* pStream, block_reader& reader, long iPos)
+{
+   // some taggers stack several tags
+   for (;;)
+   {
+      const unsigned char* p = reader.Get(iPos, ID3v2HeaderSize);
+      if (!p || 0 != std::memcmp(p, "ID3", 3))
+         return;
+
+      const int iVersion = p[3];
+      const unsigned char iFlags = p[5];
+      const long iSize = (long) ReadSyncSafe(p + 6);
+      const long iBegin = iPos + ID3v2HeaderSize;
+      iPos = iBegin + iSize + (iFlags & 0x10 ? ID3v2HeaderSize : 0);
+      if (iVersion < 2 || iVersion > 4)
+         continue;
+
+      if (iVersion < 4 && (iFlags & 0x80))
+      {
+         // frame sizes of older tags count the data without the inserted zeros,
+         // such tags are rare enough to read them whole
+         pStream->seek(iBegin);
+         const TagLib::ByteVector data = Resync(pStream->readBlock((TagLib::ulong) iSize));
+         block_reader tag(data, 0);
+         ChooseID3v2Frames(choice, tag, iVersion, false, 0, (long) data.size());
+         continue;
+      }
+
+      long iFrames = iBegin;
+      if (iVersion > 2 && (iFlags & 0x40)) // extended header
+      {
+         const unsigned char* pExtended = reader.Get(iFrames, 4);
+         if (!pExtended)
+            return;
+         iFrames += 3 == iVersion ? 4 + (long) ReadBE32(pExtended) : (long) ReadSyncSafe(pExtended);
+      }
+      ChooseID3v2Frames(choice, reader, iVersion, 4 == iVersion && (iFlags & 0x80), iFrames, iBegin + iSize);
+   }
+}
+
+/// APE item keys are case insensitive ASCII
+static bool StartsWithNoCase(const std::string& sText, const char* pszPrefix)
+{
+   for (size_t i = 0; pszPrefix[i]; ++i)
+   {
+      if (i >= sText.size() || std::tolower((unsigned char) sText[i]) != std::tolower((unsigned char) pszPrefix[i]))
+         return false;
+   }
+   return true;
+}
+
+/// binary items of the APE tag at the end, their names tell the picture type
+static void ChooseAPE(picture_choice& choice, block_reader& reader, const long iLength)
+{
+   long iEnd = iLength;
+   const unsigned char* p = reader.Get(iEnd - ID3v1Size, 3);
+   if (p && 0 == std::memcmp(p, "TAG", 3))
+      iEnd -= ID3v1Size;
+
+   p = reader.Get(iEnd - APEFooterSize, APEFooterSize);
+   if (!p || 0 != std::memcmp(p, "APETAGEX", 8))
+      return;
+
+   // size includes the footer but not the header
+   const long iSize = (long) ReadLE32(p + 12);
+   const unsigned int iCount = ReadLE32(p + 16);
+   if (iSize < APEFooterSize || iSize > iEnd)
+      return;
+
+   long iPos = iEnd - iSize;
+   const long iItemsEnd = iEnd - APEFooterSize;
+   for (unsigned int i = 0; i < iCount && iPos + 9 <= iItemsEnd; ++i)
+   {
+      const long iPrefix = std::min(iItemsEnd - iPos, PrefixSize);
+      p = reader.Get(iPos, iPrefix);
+      if (!p)
+         return;
+
+      const long iValueSize = (long) ReadLE32(p);
+      const unsigned int iFlags = ReadLE32(p + 4);
+      const long iValue = SkipText(p, 8, iPrefix, false);
+      if (iValue < 0 || iValueSize < 0 || iPos + iValue + iValueSize > iItemsEnd)
+         return;
+
+      // binary value: file name, zero, image data
+      const std::string sKey((const char*) p + 8, iValue - 9);
+      if (1 == ((iFlags >> 1) & 3) && StartsWithNoCase(sKey, "Cover Art ("))
+      {
+         const long iData = SkipText(p, iValue, std::min(iPrefix, iValue + iValueSize), false);
+         const int iType = StartsWithNoCase(sKey, "Cover Art (Front)") ? FrontCover : 0;
+         if (iData < 0)
+            Choose(choice, reader, iType, std::string(), -1, iValueSize);
+         else
+            Choose(choice, reader, iType, std::string(), iPos + iData, iValueSize - (iData - iValue));
+      }
+      iPos += iValue + iValueSize;
+   }
+}
+
+/// PICTURE metadata blocks in front of the frames
+static bool ChooseFLAC(picture_choice& choice, block_reader& reader, long iPos)
+{
+   const unsigned char* p = reader.Get(iPos, 4);
+   if (!p || 0 != std::memcmp(p, "fLaC", 4))
+      return false;
+
+   iPos += 4;
+   for (;;)
+   {
+      p = reader.Get(iPos, 4);
+      if (!p)
+         return false;
+      const bool bLast = 0 != (p[0] & 0x80);
+      const long iSize = p[1] << 16 | p[2] << 8 | p[3];
+      const long iBody = iPos + 4;
+
+      // type, MIME type, description, width, height, depth, colors, data
+      const long iPrefix = std::min(iSize, PrefixSize);
+      const unsigned char* pBody = 6 == (p[0] & 0x7F) && iPrefix >= 8 ? reader.Get(iBody, iPrefix) : nullptr;
+      if (pBody)
+      {
+         const int iType = (int) ReadBE32(pBody);
+         const long iMimeSize = (long) ReadBE32(pBody + 4);
+         long iField = 8 + iMimeSize;
+         if (iMimeSize >= 0 && iField + 4 <= iPrefix)
+         {
+            const std::string sMime((const char*) pBody + 8, iMimeSize);
+            iField += 4 + (long) ReadBE32(pBody + iField);
+            if (iField >= 0 && iField + 20 <= iPrefix)
+            {
+               const int iWidth = (int) ReadBE32(pBody + iField);
+               const int iHeight = (int) ReadBE32(pBody + iField + 4);
+               const long iDataSize = std::min((long) ReadBE32(pBody + iField + 16), iSize - iField - 20);
+               const bool bChosen = choice.m_Found;
+               Choose(choice, reader, iType, sMime, iBody + iField + 20, iDataSize);
+               // the image headers are preferred, the block tells the size of broken ones
+               if (choice.m_Found && !bChosen && 0 == choice.m_Info.m_Width)
+               {
+                  choice.m_Info.m_Width = iWidth;
+                  choice.m_Info.m_Height = iHeight;
+               }
+            }
+         }
+      }
+
+      iPos = iBody + iSize;
+      if (bLast)
+         return true;
+   }
+}
+
+/// content of the first child atom with the name, false if there is none
+static bool FindAtom(block_reader& reader, long iPos, const long iEnd, const char* pszName, long& iBegin,
+      long& iContentEnd)
+{
+   while (iPos + 8 <= iEnd)
+   {
+      const unsigned char* p = reader.Get(iPos, 8);
+      if (!p)
+         return false;
+
+      long long iSize = ReadBE32(p);
+      long iHeaderSize = 8;
+      if (1 == iSize)
+      {
+         const unsigned char* pLarge = reader.Get(iPos + 8, 8);
+         if (!pLarge)
+            return false;
+         iSize = (long long) ReadBE32(pLarge) << 32 | ReadBE32(pLarge + 4);
+         iHeaderSize = 16;
+      }
+      else if (0 == iSize) // atom extends to the end
+         iSize = iEnd - iPos;
+
+      if (iSize < iHeaderSize || iPos + iSize > iEnd)
+         return false;
+
+      if (0 == std::memcmp(p + 4, pszName, 4))
+      {
+         iBegin = iPos + iHeaderSize;
+         iContentEnd = (long) (iPos + iSize);
+         return true;
+      }
+      iPos += (long) iSize;
+   }
+   return false;
+}
+
+/// data atoms of moov.udta.meta.ilst.covr, the type of data tells the image type
+static bool ChooseMP4(picture_choice& choice, block_reader& reader, const long iLength)
+{
+   long iBegin = 0;
+   long iEnd = iLength;
+   if (!FindAtom(reader, iBegin, iEnd, "moov", iBegin, iEnd))
+      return false;
+
+   // meta has version and flags in front of its children
+   if (!FindAtom(reader, iBegin, iEnd, "udta", iBegin, iEnd) || !FindAtom(reader, iBegin, iEnd, "meta", iBegin, iEnd)
+         || !FindAtom(reader, iBegin + 4, iEnd, "ilst", iBegin, iEnd)
+         || !FindAtom(reader, iBegin, iEnd, "covr", iBegin, iEnd))
+      return true;
+
+   long iData = 0;
+   long iDataEnd = 0;
+   if (!FindAtom(reader, iBegin, iEnd, "data", iData, iDataEnd))
+      return true;
+
+   // type and locale in front of the image
+   const unsigned char* p = reader.Get(iData, 8);
+   if (!p)
+      return false;
+   const unsigned int iClass = ReadBE32(p) & 0xFFFFFF;
+   const char* pszMime = 13 == iClass ? "image/jpeg" : 14 == iClass ? "image/png" : 27 == iClass ? "image/bmp" : "";
+   Choose(choice, reader, FrontCover, pszMime, iData + 8, iDataEnd - iData - 8);
+   return true;
+}
+
+bool GetPictureInfo(TagLib::IOStream* pStream, const format_t format, picture_info& info)
+{
+   block_reader reader(pStream);
+   picture_choice choice;
+
+   switch (format)
+   {
+      case fmtMPEG:
+      case fmtMPC:
+      case fmtWavPack:
+      case fmtTrueAudio:
+      case fmtAPE:
+         ChooseID3v2(choice, pStream, reader, 0);
+         ChooseAPE(choice, reader, pStream->length());
+         break;
+      case fmtFLAC:
+         {
+         // skip ID3v2 tags in front of the stream marker
+         long iPos = 0;
+         for (const unsigned char* p = reader.Get(iPos, ID3v2HeaderSize); p && 0 == std::memcmp(p, "ID3", 3);
+               p = reader.Get(iPos, ID3v2HeaderSize))
+            iPos += ID3v2HeaderSize + (long) ReadSyncSafe(p + 6) + (p[5] & 0x10 ? ID3v2HeaderSize : 0);
+         if (!ChooseFLAC(choice, reader, iPos))
+            return false;
+         break;
+      }
+      case fmtMP4:
+         if (!ChooseMP4(choice, reader, pStream->length()))
+            return false;
+         break;
+      default:
+         // Ogg and ASF pictures are encoded in the comments, they are read only whole
+         return false;
+   }
+
+   info = choice.m_Found ? choice.m_Info : picture_info();
+   return true;
+}
+}
@@ -0,0 +1,46 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <string>
+#include <tiostream.h>
+#include "formats.h"
+
+namespace wdx
+{
+
+/// embedded picture as described by the headers of its tag
+struct picture_info
+{
+   std::string m_Mime;
+   unsigned int m_Size; // bytes of the image data, 0 if there is no picture
+   int m_Width; // pixels, 0 if unknown
+   int m_Height;
+
+   picture_info() :
+         m_Size(0), m_Width(0), m_Height(0)
+   {
+   }
+};
+
+/// finds the embedded picture, the front cover if there are several. Only
+/// headers of the tags and the first bytes of the image are read, never the
+/// whole image. False if the format is not supported or the stream is
+/// damaged, true with zero size if there is no picture.
+bool GetPictureInfo(TagLib::IOStream* pStream, const format_t format, picture_info& info);
+}
@@ -15,26 +15,38 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <string>
 #include <sstream>
 
 #include <tag.h>
+#include <tpropertymap.h>
 #include <mpegfile.h>
 #include <id3v2tag.h>
 #include <id3v2header.h>
 #include <id3v1tag.h>
 #include <apetag.h>
 #include <flacfile.h>
-#include <oggflacfile.h>
 #include <mpcfile.h>
 #include <oggfile.h>
 #include <trueaudiofile.h>
 #include <wavpackfile.h>
+#include <apefile.h>
+#include <tfilestream.h>
 
+#include "duration.h"
+#include "payload.h"
+#include "picture.h"
 #include "plugin.h"
+#include "stream.h"
 #include "utils.h"
+#ifdef _WIN32
 #include "cunicode.h"
+#endif
 
 namespace wdx
 {
@@ -52,10 +64,333 @@ typedef enum FieldIndexes
    fiChannels,
    fiLength_s,
    fiLength_m,
+   fiLength_ms,
    fiTagType,
+   fiCover,
+   fiCoverType,
+   fiCoverSize,
+   fiCoverWidth,
+   fiCoverHeight,
+   fiWriteMode,
+   fiAudioHash,
+   fiCompareAudio,
+   fiTitleKey,
+   fiArtistKey,
+   fiAlbumKey,
+   fiExtra, // first of the fields configured in the ini
 } CFieldIndexes;
 
-plugin::plugin()
+// units of audio properties fields, TagLib::AudioProperties::ReadStyle
+// in order of unit indexes
+static constexpr const char* PropertiesUnits = "Average|Fast|Accurate";
+static const TagLib::AudioProperties::ReadStyle PropertiesStyles[] =
+{
+   TagLib::AudioProperties::Average,
+   TagLib::AudioProperties::Fast,
+   TagLib::AudioProperties::Accurate,
+};
+
+/// frames of MPEG files without a VBR header are counted as far as the style allows
+static scan_policy_t GetScanPolicy(const int iLevel)
+{
+   switch (iLevel)
+   {
+      case TagLib::AudioProperties::Fast:
+         return scanNever;
+      case TagLib::AudioProperties::Accurate:
+         return scanAlways;
+      default:
+         return scanIfVBR;
+   }
+}
+
+static void SetProperties(metadata& data, const TagLib::AudioProperties& prop)
+{
+   data.m_HasProperties = true;
+   data.m_Bitrate = prop.bitrate();
+   data.m_Samplerate = prop.sampleRate();
+   data.m_Channels = prop.channels();
+   data.m_Length = prop.length();
+   data.m_LengthMs = data.m_Length * 1000;
+}
+
+/// cached data is sufficient if properties were read at least as accurate as requested
+static bool IsSufficient(const metadata_ptr& data, const int iLevel)
+{
+   // files which could not be parsed are not parsed again
+   return !data || data->m_PropertiesStyle >= iLevel;
+}
+
+/// copies text into TC's buffer of iMaxLen bytes, truncated and terminated
+static void CopyValue(char* pszValue, const char* pszText, const int iMaxLen)
+{
+   if (iMaxLen <= 0)
+      return;
+
+   size_t iLength = std::strlen(pszText);
+   if (iLength >= (size_t) iMaxLen)
+      iLength = iMaxLen - 1;
+   std::memcpy(pszValue, pszText, iLength);
+   pszValue[iLength] = 0;
+}
+
+/// copies wide text into TC's buffer of iMaxLen bytes, a surrogate pair is
+/// either copied whole or not at all
+static void CopyValue(wchar_t* pszValue, const wchar_t* pszText, const size_t iTextLength, const int iMaxLen)
+{
+   const size_t iCapacity = iMaxLen / sizeof(wchar_t);
+   if (0 == iCapacity)
+      return;
+
+   size_t iLength = iTextLength;
+   if (iLength >= iCapacity)
+   {
+      iLength = iCapacity - 1;
+      if (iLength > 0 && pszText[iLength - 1] >= 0xD800 && pszText[iLength - 1] < 0xDC00)
+         --iLength;
+   }
+   std::memcpy(pszValue, pszText, iLength * sizeof(wchar_t));
+   pszValue[iLength] = 0;
+}
+
+static void CopyValue(void* pFieldValue, const std::wstring& sText, const int iMaxLen)
+{
+   CopyValue((wchar_t*) pFieldValue, sText.c_str(), sText.size(), iMaxLen);
+}
+
+/// where the value of a field comes from, decides what is read before the field is filled
+enum field_source_t
+{
+   srcTag, // tags, empty if the file has none
+   srcProperties, // audio properties, read in the style of the unit
+   srcFile, // parsed file, present even without tags
+   srcHash, // hash of the audio data, computed on demand
+   srcPicture, // headers of the embedded pictures, read on demand
+   srcSession, // state of this session, the file is not parsed
+   srcCompare, // only used by the compare function
+};
+
+/// copies the value of a field from parsed data into TC's buffer, false if the field is empty
+typedef bool (*extractor_t)(const metadata& data, const collation& coll, void* pFieldValue, const int iMaxLen);
+
+/// built-in field, everything TC and the plugin need to know about it
+struct field_def
+{
+   int m_Index;
+   field m_Field;
+   field_source_t m_Source;
+   extractor_t m_Extract;
+   int m_SortOrder; // 1 for ascending, -1 for descending
+};
+
+template<std::wstring metadata::*Text>
+static bool ExtractText(const metadata& data, const collation&, void* pFieldValue, const int iMaxLen)
+{
+   CopyValue(pFieldValue, data.*Text, iMaxLen);
+   return true;
+}
+
+/// tags store zero when there is no number, audio properties are shown as read
+template<int metadata::*Number, bool bZeroIsEmpty>
+static bool ExtractNumber(const metadata& data, const collation&, void* pFieldValue, const int)
+{
+   if (bZeroIsEmpty && !(data.*Number))
+      return false;
+   *(__int32*) pFieldValue = data.*Number;
+   return true;
+}
+
+template<std::wstring metadata::*Text, std::wstring metadata::*Key>
+static bool ExtractSortKey(const metadata& data, const collation& coll, void* pFieldValue, const int iMaxLen)
+{
+   // keys stored with other settings are built again
+   if (coll.GetId() == data.m_CollationId)
+      CopyValue(pFieldValue, data.*Key, iMaxLen);
+   else
+      CopyValue(pFieldValue, coll.GetKey(data.*Text), iMaxLen);
+   return true;
+}
+
+static bool ExtractLength(const metadata& data, const collation&, void* pFieldValue, const int iMaxLen)
+{
+   char szLength[32];
+   snprintf(szLength, sizeof(szLength), "%dm %02ds", data.m_Length / 60, data.m_Length % 60);
+   CopyValue((char*) pFieldValue, szLength, iMaxLen);
+   return true;
+}
+
+static bool ExtractTagType(const metadata& data, const collation&, void* pFieldValue, const int iMaxLen)
+{
+   CopyValue((char*) pFieldValue, data.m_TagType.c_str(), iMaxLen);
+   return true;
+}
+
+static bool ExtractAudioHash(const metadata& data, const collation&, void* pFieldValue, const int iMaxLen)
+{
+   char szHash[17];
+   snprintf(szHash, sizeof(szHash), "%016llx", data.m_AudioHash);
+   CopyValue((char*) pFieldValue, szHash, iMaxLen);
+   return true;
+}
+
+static bool ExtractCover(const metadata& data, const collation&, void* pFieldValue, const int)
+{
+   if (metadata::PictureRead != data.m_PictureState)
+      return false;
+   *(int*) pFieldValue = data.m_PictureSize > 0;
+   return true;
+}
+
+static bool ExtractCoverType(const metadata& data, const collation&, void* pFieldValue, const int iMaxLen)
+{
+   if (data.m_PictureMime.empty())
+      return false;
+   CopyValue((char*) pFieldValue, data.m_PictureMime.c_str(), iMaxLen);
+   return true;
+}
+
+// higher quality and longer tracks are sorted first
+static constexpr field_def Fields[] =
+{
+   { fiTitle, field("Title", ft_stringw, contflags_edit), srcTag, &ExtractText<&metadata::m_Title>, 1 },
+   { fiArtist, field("Artist", ft_stringw, contflags_edit), srcTag, &ExtractText<&metadata::m_Artist>, 1 },
+   { fiAlbum, field("Album", ft_stringw, contflags_edit), srcTag, &ExtractText<&metadata::m_Album>, 1 },
+   { fiYear, field("Year", ft_numeric_32, contflags_edit), srcTag, &ExtractNumber<&metadata::m_Year, true>, 1 },
+   { fiTracknumber, field("Tracknumber", ft_numeric_32, contflags_edit), srcTag,
+         &ExtractNumber<&metadata::m_Track, true>, 1 },
+   { fiComment, field("Comment", ft_stringw, contflags_edit), srcTag, &ExtractText<&metadata::m_Comment>, 1 },
+   { fiGenre, field("Genre", ft_stringw, contflags_edit), srcTag, &ExtractText<&metadata::m_Genre>, 1 },
+   { fiBitrate, field("Bitrate", ft_numeric_32, 0, PropertiesUnits), srcProperties,
+         &ExtractNumber<&metadata::m_Bitrate, false>, -1 },
+   { fiSamplerate, field("Sample rate", ft_numeric_32, 0, PropertiesUnits), srcProperties,
+         &ExtractNumber<&metadata::m_Samplerate, false>, -1 },
+   { fiChannels, field("Channels", ft_numeric_32, 0, PropertiesUnits), srcProperties,
+         &ExtractNumber<&metadata::m_Channels, false>, -1 },
+   { fiLength_s, field("Length", ft_numeric_32, 0, PropertiesUnits), srcProperties,
+         &ExtractNumber<&metadata::m_Length, false>, -1 },
+   { fiLength_m, field("Length (formatted)", ft_string, 0, PropertiesUnits), srcProperties, &ExtractLength, -1 },
+   { fiLength_ms, field("Length (ms)", ft_numeric_32, 0, PropertiesUnits), srcProperties,
+         &ExtractNumber<&metadata::m_LengthMs, false>, -1 },
+   { fiTagType, field("Tag type", ft_string), srcFile, &ExtractTagType, 1 },
+   { fiCover, field("Cover", ft_boolean), srcPicture, &ExtractCover, -1 },
+   { fiCoverType, field("Cover type", ft_string), srcPicture, &ExtractCoverType, 1 },
+   { fiCoverSize, field("Cover size", ft_numeric_32), srcPicture,
+         &ExtractNumber<&metadata::m_PictureSize, true>, -1 },
+   { fiCoverWidth, field("Cover width", ft_numeric_32), srcPicture,
+         &ExtractNumber<&metadata::m_PictureWidth, true>, -1 },
+   { fiCoverHeight, field("Cover height", ft_numeric_32), srcPicture,
+         &ExtractNumber<&metadata::m_PictureHeight, true>, -1 },
+   { fiWriteMode, field("Write mode", ft_string), srcSession, nullptr, 1 },
+   { fiAudioHash, field("Audio hash", ft_string), srcHash, &ExtractAudioHash, 1 },
+   { fiCompareAudio, field("Audio data (ignore tags)", ft_comparecontent), srcCompare, nullptr, 1 },
+   { fiTitleKey, field("Title (sort)", ft_stringw), srcTag,
+         &ExtractSortKey<&metadata::m_Title, &metadata::m_TitleKey>, 1 },
+   { fiArtistKey, field("Artist (sort)", ft_stringw), srcTag,
+         &ExtractSortKey<&metadata::m_Artist, &metadata::m_ArtistKey>, 1 },
+   { fiAlbumKey, field("Album (sort)", ft_stringw), srcTag,
+         &ExtractSortKey<&metadata::m_Album, &metadata::m_AlbumKey>, 1 },
+};
+
+static constexpr int FieldCount = sizeof(Fields) / sizeof(Fields[0]);
+
+/// true if the fields from iIndex on are declared in the order of their indexes
+static constexpr bool IsDeclaredInOrder(const int iIndex)
+{
+   return FieldCount == iIndex || (Fields[iIndex].m_Index == iIndex && IsDeclaredInOrder(iIndex + 1));
+}
+
+static_assert(fiExtra == FieldCount, "every built-in field must be declared");
+static_assert(IsDeclaredInOrder(0), "fields must be declared in the order of their indexes");
+
+/// fields configured in the ini are tags
+static field_source_t GetSource(const int iFieldIndex)
+{
+   return iFieldIndex < fiExtra ? Fields[iFieldIndex].m_Source : srcTag;
+}
+
+/// what must be read to get the field: audio properties style or tags only
+static int GetReadLevel(const field_source_t source, const int iUnitIndex)
+{
+   if (srcProperties != source)
+      return metadata::NoProperties;
+
+   if (iUnitIndex > 0 && iUnitIndex < (int) (sizeof(PropertiesStyles) / sizeof(PropertiesStyles[0])))
+      return PropertiesStyles[iUnitIndex];
+   return TagLib::AudioProperties::Average;
+}
+
+static const char* SettingsSection = "wdxtaglib";
+static const int DefaultCacheSizeMb = 32;
+static const int DefaultIndexSizeMb = 64;
+static const int DefaultSaveThreadsPerVolume = 2;
+static const int DefaultPaddingReserveKb = 4;
+static const int DefaultPaddingGrowthPercent = 10;
+static const int DefaultHeadReadKb = 128;
+static const int DefaultTailReadKb = 16;
+static const size_t MaxSaveErrorsShown = 20;
+// files which differ usually do so in the beginning, blocks grow up to the maximum
+static const size_t MinCompareBlock = 64 * 1024;
+static const size_t MaxCompareBlock = 1024 * 1024;
+static const char* DefaultSortArticles = "The";
+static const char* DefaultExtraFields = "ALBUMARTIST:Album artist|COMPOSER:Composer|DISCNUMBER:Disc|BPM:BPM"
+      "|REPLAYGAIN_TRACK_GAIN:Track gain|REPLAYGAIN_ALBUM_GAIN:Album gain";
+static const char* IndexFileName = "wdxtaglib.idx";
+static const char* StatsFileName = "wdxtaglib.stats";
+
+static std::string Trim(const std::string& sText)
+{
+   const std::string::size_type iBegin = sText.find_first_not_of(" \t");
+   if (std::string::npos == iBegin)
+      return std::string();
+   return sText.substr(iBegin, sText.find_last_not_of(" \t") - iBegin + 1);
+}
+
+/// parses list of property keys with optional field names: KEY:Name|KEY...
+static void ParseExtraFields(const std::string& sList, std::vector<extra_field>& fields)
+{
+   fields.clear();
+
+   std::string::size_type iBegin = 0;
+   while (iBegin <= sList.size())
+   {
+      std::string::size_type iEnd = sList.find('|', iBegin);
+      if (std::string::npos == iEnd)
+         iEnd = sList.size();
+
+      const std::string sItem = sList.substr(iBegin, iEnd - iBegin);
+      const std::string::size_type iColon = sItem.find(':');
+      std::string sKey = Trim(sItem.substr(0, iColon));
+      if (!sKey.empty())
+      {
+         // TagLib property keys are upper case ASCII
+         std::transform(sKey.begin(), sKey.end(), sKey.begin(), ::toupper);
+
+         extra_field extra;
+         extra.m_Key.assign(sKey.begin(), sKey.end());
+         extra.m_Name = std::string::npos == iColon ? sKey : Trim(sItem.substr(iColon + 1));
+         if (extra.m_Name.empty())
+            extra.m_Name = sKey;
+         fields.push_back(extra);
+      }
+      iBegin = iEnd + 1;
+   }
+}
+
+plugin::plugin() :
+      ExtraFieldsLoaded_(false),
+      PrefetchEnabled_(true),
+      Threads_(0),
+      SaveThreadsPerVolume_(DefaultSaveThreadsPerVolume),
+      Padding_(DefaultPaddingReserveKb * 1024, DefaultPaddingGrowthPercent),
+      ReadWindows_(DefaultHeadReadKb * 1024, DefaultTailReadKb * 1024),
+      PrefetchLevel_(metadata::NoProperties),
+      Timeline_(utils::singleton<timeline>::instance()),
+      Cache_(DefaultCacheSizeMb * 1024 * 1024),
+      Pool_([this](const std::wstring& sFileName, const int iLevel)
+            {
+               cancellation::scope scope(Cancellation_, sFileName);
+               GetMetadata(sFileName, iLevel, scope.Token());
+            })
 {
 }
 
@@ -63,47 +398,125 @@ plugin::~plugin()
 {
 }
 
-void plugin::OnInitFields()
+int plugin::OnGetFieldCount() const
 {
-   fields_[fiTitle] = field("Title", ft_stringw, contflags_edit);
-   fields_[fiArtist] = field("Artist", ft_stringw, contflags_edit);
-   fields_[fiAlbum] = field("Album", ft_stringw, contflags_edit);
-   fields_[fiYear] = field("Year", ft_numeric_32, contflags_edit);
-   fields_[fiTracknumber] = field("Tracknumber", ft_numeric_32, contflags_edit);
-   fields_[fiComment] = field("Comment", ft_stringw, contflags_edit);
-   fields_[fiGenre] = field("Genre", ft_stringw, contflags_edit);
-   fields_[fiBitrate] = field("Bitrate", ft_numeric_32);
-   fields_[fiSamplerate] = field("Sample rate", ft_numeric_32);
-   fields_[fiChannels] = field("Channels", ft_numeric_32);
-   fields_[fiLength_s] = field("Length", ft_numeric_32);
-   fields_[fiLength_m] = field("Length (formatted)", ft_string);
-   fields_[fiTagType] = field("Tag type", ft_string);
+   return fiExtra + (int) ExtraFields_.size();
+}
+
+field plugin::OnGetField(const int iFieldIndex) const
+{
+   if (iFieldIndex < fiExtra)
+      return Fields[iFieldIndex].m_Field;
+   return field(ExtraFields_[iFieldIndex - fiExtra].m_Name.c_str(), ft_stringw);
 }
 
 std::string plugin::OnGetDetectString() const
 {
    //return "EXT=\"OGG\" | EXT=\"FLAC\" | EXT=\"OGA\"| EXT=\"MP3\"| EXT=\"MPC\"| EXT=\"WV\"| EXT=\"SPX\"| EXT=\"TTA\"";
 
-   TagLib::String sExtList;
-   const TagLib::String sOpen("EXT=\"");
-   const TagLib::String sClose("\"");
-   const TagLib::String sOr(" | ");
+   // unqualified, the name finds base::GetDetectString which calls this again
+   return ::wdx::GetDetectString();
+}
 
-   for (const TagLib::String& str : TagLib::FileRef::defaultFileExtensions())
+int plugin::OnGetDefaultSortOrder(const int iFieldIndex)
+{
+   if (iFieldIndex >= 0 && iFieldIndex < fiExtra)
+      return Fields[iFieldIndex].m_SortOrder;
+   return 1;
+}
+
+void plugin::OnLoadSettings()
+{
+   const int iCacheSizeMb = utils::GetIniInt(GetIniName(), SettingsSection, "CacheSizeMB", DefaultCacheSizeMb);
+   Cache_.SetMaxBytes((size_t) std::max(iCacheSizeMb, 0) * 1024 * 1024);
+   Threads_ = utils::GetIniInt(GetIniName(), SettingsSection, "Threads", 0);
+   Pool_.SetThreadCount(Threads_);
+   SaveThreadsPerVolume_ = utils::GetIniInt(GetIniName(), SettingsSection, "SaveThreadsPerVolume",
+         DefaultSaveThreadsPerVolume);
+   Padding_.m_Reserve = std::max(utils::GetIniInt(GetIniName(), SettingsSection, "PaddingReserveKB",
+         DefaultPaddingReserveKb), 0) * 1024;
+   Padding_.m_GrowthPercent = std::max(utils::GetIniInt(GetIniName(), SettingsSection, "PaddingGrowthPercent",
+         DefaultPaddingGrowthPercent), 0);
+   ReadWindows_.m_Head = std::max(utils::GetIniInt(GetIniName(), SettingsSection, "HeadReadKB",
+         DefaultHeadReadKb), 0) * 1024;
+   ReadWindows_.m_Tail = std::max(utils::GetIniInt(GetIniName(), SettingsSection, "TailReadKB",
+         DefaultTailReadKb), 0) * 1024;
+   PrefetchEnabled_ = utils::GetIniInt(GetIniName(), SettingsSection, "Prefetch", 1) != 0;
+   Collation_.SetArticles(utils::GetIniString(GetIniName(), SettingsSection, "SortArticles", DefaultSortArticles));
+   Collation_.SetFoldDiacritics(utils::GetIniInt(GetIniName(), SettingsSection, "SortFoldDiacritics", 1) != 0);
+   // fields are listed to TC once, later changes need a restart
+   if (!ExtraFieldsLoaded_)
    {
-      sExtList += sOpen + str.upper() + sClose + sOr;
+      ParseExtraFields(utils::GetIniString(GetIniName(), SettingsSection, "ExtraFields", DefaultExtraFields),
+            ExtraFields_);
+      ExtraFieldsLoaded_ = true;
+
+      const int iCount = OnGetFieldCount();
+      for (int i = 0; i < iCount; ++i)
+         Stats_.SetFieldName(i, OnGetField(i).m_Name);
    }
 
-   // remove last sOr
-   if (!sExtList.isEmpty())
+   // index and statistics are stored next to the ini file
+   const std::string::size_type iSlash = GetIniName().find_last_of("\\/");
+   const int iIndexSizeMb = utils::GetIniInt(GetIniName(), SettingsSection, "IndexSizeMB", DefaultIndexSizeMb);
+   if (std::string::npos == iSlash)
    {
-      sExtList = sExtList.substr(0, sExtList.size() - sOr.size());
+      Index_.Close();
+      StatsFileName_.clear();
    }
+   else
+   {
+      Index_.Open(GetIniName().substr(0, iSlash + 1) + IndexFileName, (size_t) std::max(iIndexSizeMb, 0) * 1024 * 1024);
+      StatsFileName_ = GetIniName().substr(0, iSlash + 1) + StatsFileName;
+   }
+
+   Stats_.SetSnapshots(StatsFileName_, StatsFileName_.empty() ? 0 :
+         utils::GetIniInt(GetIniName(), SettingsSection, "StatsIntervalSec", 0));
+}
+
+void plugin::OnSendStateInformation(const int iState, const std::wstring& sPath)
+{
+   if (contst_refreshpressed == iState)
+      Cache_.Clear();
+
+   if ((contst_readnewdir == iState || contst_refreshpressed == iState) && PrefetchEnabled_)
+      Prefetch(sPath);
+}
+
+void plugin::Prefetch(const std::wstring& sPath)
+{
+   std::vector<std::wstring> files;
+   utils::ListDirectory(sPath, files);
+
+   // keep listing order, TC asks for the files from the top of the list first
+   files.erase(std::remove_if(files.begin(), files.end(),
+         [](const std::wstring& sFileName) { return !IsSupportedFile(sFileName); }), files.end());
+
+   // columns of the previous directory are most probably shown in this one too
+   Pool_.Prefetch(files, PrefetchLevel_);
+}
+
+void plugin::OnStopGetValue(const std::wstring& sFileName)
+{
+   Pool_.Cancel(sFileName);
+   Cancellation_.Cancel(sFileName);
+}
+
+void plugin::OnPluginUnloading()
+{
+   // parses which are running must not keep TC from closing, queued ones
+   // are dropped by Stop
+   Cancellation_.CancelAll();
+   Pool_.Stop();
+   Cancellation_.Resume();
+   Index_.Close();
 
-   return sExtList.toCString();
+   Stats_.StopSnapshots();
+   if (!StatsFileName_.empty())
+      Stats_.Write(StatsFileName_);
 }
 
-TagLib::FileRef& plugin::OpenFile(const std::wstring& sFileName)
+audio_file& plugin::OpenFile(const std::wstring& sFileName)
 {
    // if there is no such file then insert it
    // otherwise find its reference
@@ -111,139 +524,382 @@ TagLib::FileRef& plugin::OpenFile(const std::wstring& sFileName)
 
    if (Files2Write_.end() == iter)
    {
-      Files2Write_[sFileName] = TagLib::FileRef(sFileName.c_str());
-      return Files2Write_[sFileName];
+      TagLib::IOStream* pStream;
+      {
+         timeline_span span(Timeline_, "Open", "taglib", sFileName.c_str());
+         stopwatch open(Stats_.GetPath(stats::pathOpen));
+         pStream = new write_tracking_stream(new TagLib::FileStream(utils::GetNativePath(sFileName).c_str()));
+      }
+
+      std::unique_ptr<audio_file>& file = Files2Write_[sFileName];
+      timeline_span span(Timeline_, "Parse", "taglib", sFileName.c_str());
+      stopwatch parse(Stats_.GetPath(stats::pathParseProperties));
+      file.reset(new audio_file(sFileName, pStream));
+      return *file;
    }
    else
    {
-      return (*iter).second;
+      return *(*iter).second;
    }
 }
 
-int plugin::OnGetValue(const std::wstring& sFileName, const int iFieldIndex,
-      const int iUnitIndex, void* pFieldValue, const int iMaxLen, const int iFlags)
+bool plugin::FindMetadata(const std::wstring& sFileName, const int iLevel, metadata_ptr& data)
 {
-   TagLib::FileRef file(sFileName.c_str());
+   utils::file_stamp stamp;
+   if (!utils::GetFileStamp(sFileName, stamp))
+   {
+      data.reset();
+      return true;
+   }
 
-   if (file.isNull() || !file.tag() || !file.audioProperties())
-      return ft_fileerror;
+   if (Cache_.Get(sFileName, stamp, data) && IsSufficient(data, iLevel))
+      return true;
 
-   TagLib::Tag *tag = file.tag();
-   TagLib::AudioProperties *prop = file.audioProperties();
+   // after a restart files known to the index are served without waiting for a worker
+   if (!Index_.Find(sFileName, stamp, data) || !IsSufficient(data, iLevel))
+      return false;
+   Cache_.Put(sFileName, stamp, data);
+   return true;
+}
 
-   switch (iFieldIndex)
+metadata_ptr plugin::GetMetadata(const std::wstring& sFileName, const int iLevel, const cancel_token& token)
+{
+   utils::file_stamp stamp;
+   if (!utils::GetFileStamp(sFileName, stamp))
+      return metadata_ptr();
+
+   metadata_ptr data;
+   if (Cache_.Get(sFileName, stamp, data) && IsSufficient(data, iLevel))
+      return data;
+
+   if (!Index_.Find(sFileName, stamp, data) || !IsSufficient(data, iLevel))
    {
-      case fiTitle:
-         wcslcpy((wchar_t*) pFieldValue, tag->title().toWString().c_str(), iMaxLen / 2);
-         break;
-      case fiArtist:
-         wcslcpy((wchar_t*) pFieldValue, tag->artist().toWString().c_str(), iMaxLen / 2);
-         break;
-      case fiAlbum:
-         wcslcpy((wchar_t*) pFieldValue, tag->album().toWString().c_str(), iMaxLen / 2);
-         break;
-      case fiYear:
-         {
-         if (!tag->year())
-            return ft_fieldempty;
-         *(__int32*) pFieldValue = tag->year();
-         break;
-      }
-      case fiTracknumber:
-         {
-         if (!tag->track())
-            return ft_fieldempty;
-         *(__int32*) pFieldValue = tag->track();
-         break;
+      // read properties at least as accurate as they were read before
+      const int iReadLevel = data ? std::max(iLevel, data->m_PropertiesStyle) : iLevel;
+      const metadata_ptr known = data;
+      data = ReadMetadata(sFileName, iReadLevel, token);
+
+      // result of a stopped parse is incomplete,
+      // but files which could not be parsed are stored too
+      if (token)
+         return metadata_ptr();
+
+      // audio hash and pictures do not depend on the level, they are read on request only
+      if (data && known && (metadata::AudioHashNotRead != known->m_AudioHashState
+            || metadata::PictureNotRead != known->m_PictureState))
+      {
+         std::shared_ptr<metadata> copy = std::make_shared<metadata>(*data);
+         copy->m_AudioHash = known->m_AudioHash;
+         copy->m_AudioHashState = known->m_AudioHashState;
+         copy->m_PictureMime = known->m_PictureMime;
+         copy->m_PictureSize = known->m_PictureSize;
+         copy->m_PictureWidth = known->m_PictureWidth;
+         copy->m_PictureHeight = known->m_PictureHeight;
+         copy->m_PictureState = known->m_PictureState;
+         data = copy;
       }
-      case fiComment:
-         wcslcpy((wchar_t*) pFieldValue, tag->comment().toWString().c_str(), iMaxLen / 2);
-         break;
-      case fiGenre:
-         wcslcpy((wchar_t*) pFieldValue, tag->genre().toWString().c_str(), iMaxLen / 2);
-         break;
-      case fiBitrate:
-         *(__int32*) pFieldValue = prop->bitrate();
-         break;
-      case fiSamplerate:
-         *(__int32*) pFieldValue = prop->sampleRate();
-         break;
-      case fiChannels:
-         *(__int32*) pFieldValue = prop->channels();
-         break;
-      case fiLength_s:
-         *(__int32*) pFieldValue = prop->length();
-         break;
-      case fiLength_m:
-         {
-         int seconds = prop->length() % 60;
-         int minutes = (prop->length() - seconds) / 60;
+      Index_.Store(sFileName, stamp, data);
+   }
 
-         utils::strlcpy((char*) pFieldValue,
-               std::string(utils::Int2Str(minutes) + "m " +
-                     utils::formatSeconds(seconds) + "s").c_str(), iMaxLen);
-         break;
+   Cache_.Put(sFileName, stamp, data);
+   return data;
+}
+
+metadata_ptr plugin::ReadMetadata(const std::wstring& sFileName, const int iLevel, const cancel_token& token)
+{
+   // some formats scan the whole stream to get audio properties, skip that
+   // when only tags are needed
+   const bool bReadProperties = metadata::NoProperties != iLevel;
+
+   bool bMap;
+   {
+      std::lock_guard<std::mutex> lock(SavingMutex_);
+      bMap = !Saving_.count(sFileName);
+   }
+
+   read_tracking_stream* pStream;
+   {
+      timeline_span span(Timeline_, "Open", "taglib", sFileName.c_str());
+      stopwatch open(Stats_.GetPath(stats::pathOpen));
+      pStream = new read_tracking_stream(OpenReadStream(sFileName, ReadWindows_, bMap));
+   }
+
+   timeline_span span(Timeline_, bReadProperties ? "Parse" : "Parse tags", "taglib", sFileName.c_str());
+   // TagLib parses tags and audio properties in the same call
+   stopwatch parse(Stats_.GetPath(bReadProperties ? stats::pathParseProperties : stats::pathParseTags));
+   // reads through the stream stop as soon as the parse is cancelled
+   const audio_file file(sFileName, new cancellable_stream(pStream, token), bReadProperties,
+         bReadProperties ? (TagLib::AudioProperties::ReadStyle) iLevel : TagLib::AudioProperties::Average);
+   parse.Stop();
+   span.Stop();
+
+   if (!file.IsValid())
+   {
+      Stats_.AddFileRead(file.GetFormat(), pStream->GetBytesRead());
+      return metadata_ptr();
+   }
+
+   std::shared_ptr<metadata> data = std::make_shared<metadata>();
+   data->m_PropertiesStyle = iLevel;
+   data->m_Format = file.GetFormat();
+
+   TagLib::Tag *tag = file.GetFile()->tag();
+   if (tag)
+   {
+      data->m_HasTag = true;
+      data->m_Title = tag->title().toWString();
+      data->m_Artist = tag->artist().toWString();
+      data->m_Album = tag->album().toWString();
+      data->m_Comment = tag->comment().toWString();
+      data->m_Genre = tag->genre().toWString();
+      data->m_Year = tag->year();
+      data->m_Track = tag->track();
+
+      // keys are built once here rather than each time TC sorts or searches
+      data->m_TitleKey = Collation_.GetKey(data->m_Title);
+      data->m_ArtistKey = Collation_.GetKey(data->m_Artist);
+      data->m_AlbumKey = Collation_.GetKey(data->m_Album);
+      data->m_CollationId = Collation_.GetId();
+   }
+
+   TagLib::AudioProperties *prop = bReadProperties ? file.GetFile()->audioProperties() : nullptr;
+   if (prop)
+      SetProperties(*data, *prop);
+
+   // TagLib searches MPEG frames byte by byte and knows only Xing headers, it reads no properties of them
+   if (bReadProperties && fmtMPEG == file.GetFormat())
+   {
+      timeline_span span(Timeline_, "MPEG properties", "taglib", sFileName.c_str());
+      mpeg_duration duration;
+      if (GetMPEGDuration(file.GetStream(), GetScanPolicy(iLevel), duration))
+      {
+         data->m_HasProperties = true;
+         data->m_Samplerate = duration.m_Samplerate;
+         data->m_Channels = duration.m_Channels;
+         data->m_LengthMs = (int) duration.GetMilliseconds();
+         data->m_Length = data->m_LengthMs / 1000;
+         data->m_Bitrate = duration.GetBitrate();
       }
-      case fiTagType:
-         {
-         utils::strlcpy((char*) pFieldValue, GetTagType(file.file()).c_str(), iMaxLen);
-         break;
+      else if (TagLib::MPEG::File* pFile = dynamic_cast<TagLib::MPEG::File*>(file.GetFile()))
+      {
+         // free format streams and damaged files, TagLib's search may still find frames in them
+         const TagLib::MPEG::Properties properties(pFile, (TagLib::AudioProperties::ReadStyle) iLevel);
+         SetProperties(*data, properties);
       }
-      default:
-         return ft_nosuchfield;
-         break;
    }
 
-   return fields_[iFieldIndex].m_Type;
+   Stats_.AddFileRead(file.GetFormat(), pStream->GetBytesRead());
+
+   // all properties are kept, so any extra field is served without parsing the file again
+   const TagLib::PropertyMap properties = file.GetFile()->properties();
+   for (TagLib::PropertyMap::ConstIterator iter = properties.begin(); iter != properties.end(); ++iter)
+      data->m_Properties.Add(iter->first.toWString(), iter->second.toString("; ").toWString());
+
+   data->m_TagType = GetTagType(file);
+
+   return data;
 }
 
-std::string plugin::GetTagType(TagLib::File* pFile) const
-      {
-   std::ostringstream osResult;
-   TagLib::ID3v2::Tag *pId3v2 = nullptr;
-   TagLib::ID3v1::Tag *pId3v1 = nullptr;
-   TagLib::APE::Tag *pApe = nullptr;
-   TagLib::Ogg::XiphComment *pXiph = nullptr;
+metadata_ptr plugin::AddAudioHash(const std::wstring& sFileName, const metadata_ptr& data, const cancel_token& token)
+{
+   utils::file_stamp stamp;
+   if (!utils::GetFileStamp(sFileName, stamp))
+      return data;
+
+   timeline_span span(Timeline_, "Hash", "taglib", sFileName.c_str());
+   TagLib::FileStream stream(utils::GetNativePath(sFileName).c_str(), true);
+   byte_ranges_t ranges;
+   unsigned long long iHash = 0;
+   const bool bHashed = stream.isOpen() && GetAudioRanges(&stream, (format_t) data->m_Format, ranges)
+         && HashRanges(&stream, ranges, token, iHash);
+   // a stopped hash is tried again, a failed one only when the file changes
+   if (token)
+      return data;
+
+   // stored with the stamp taken before reading, a file changed meanwhile is hashed again
+   std::shared_ptr<metadata> result = std::make_shared<metadata>(*data);
+   result->m_AudioHashState = bHashed ? metadata::AudioHashRead : metadata::AudioHashFailed;
+   result->m_AudioHash = iHash;
+   Index_.Store(sFileName, stamp, result);
+   Cache_.Put(sFileName, stamp, result);
+   return result;
+}
+
+metadata_ptr plugin::AddPictureInfo(const std::wstring& sFileName, const metadata_ptr& data)
+{
+   utils::file_stamp stamp;
+   if (!utils::GetFileStamp(sFileName, stamp))
+      return data;
 
-   // get pointers to tags
-   TagLib::MPEG::File* pMpegFile = dynamic_cast<TagLib::MPEG::File*>(pFile);
-   if (pMpegFile && pMpegFile->isValid())
+   timeline_span span(Timeline_, "Picture", "taglib", sFileName.c_str());
+   TagLib::FileStream stream(utils::GetNativePath(sFileName).c_str(), true);
+   if (!stream.isOpen())
+      return data;
+
+   // formats without support are remembered too, so they are not opened again
+   picture_info info;
+   std::shared_ptr<metadata> result = std::make_shared<metadata>(*data);
+   if (GetPictureInfo(&stream, (format_t) data->m_Format, info))
    {
-      pId3v2 = pMpegFile->ID3v2Tag();
-      pId3v1 = pMpegFile->ID3v1Tag();
-      pApe = pMpegFile->APETag();
+      result->m_PictureState = metadata::PictureRead;
+      result->m_PictureMime = info.m_Mime;
+      result->m_PictureSize = (int) info.m_Size;
+      result->m_PictureWidth = info.m_Width;
+      result->m_PictureHeight = info.m_Height;
    }
+   else
+      result->m_PictureState = metadata::PictureNotSupported;
+
+   // stored with the stamp taken before reading, a file changed meanwhile is read again
+   Index_.Store(sFileName, stamp, result);
+   Cache_.Put(sFileName, stamp, result);
+   return result;
+}
+
+int plugin::OnGetValue(const std::wstring& sFileName, const int iFieldIndex,
+      const int iUnitIndex, void* pFieldValue, const int iMaxLen, const int iFlags)
+{
+   stopwatch watch(Stats_.GetField(iFieldIndex));
+
+   const field_source_t source = GetSource(iFieldIndex);
 
-   TagLib::FLAC::File* pFlacFile = dynamic_cast<TagLib::FLAC::File*>(pFile);
-   if (pFlacFile && pFlacFile->isValid())
+   // only used by the compare function
+   if (srcCompare == source)
+      return ft_nosuchfield;
+
+   // not a property of the file content
+   if (srcSession == source)
+      return GetWriteMode(sFileName, (char*) pFieldValue, iMaxLen);
+
+   const int iLevel = GetReadLevel(source, iUnitIndex);
+   metadata_ptr data;
+
+   // remember the most detailed request
+   int iPrefetchLevel = PrefetchLevel_;
+   while (iLevel > iPrefetchLevel && !PrefetchLevel_.compare_exchange_weak(iPrefetchLevel, iLevel))
    {
-      pId3v2 = pFlacFile->ID3v2Tag();
-      pId3v1 = pFlacFile->ID3v1Tag();
-      pXiph = pFlacFile->xiphComment();
    }
 
-   TagLib::MPC::File* pMpcFile = dynamic_cast<TagLib::MPC::File*>(pFile);
-   if (pMpcFile && pMpcFile->isValid())
+   if (!FindMetadata(sFileName, iLevel, data))
    {
-      pId3v1 = pMpcFile->ID3v1Tag();
-      pApe = pMpcFile->APETag();
+      // parse in background, TC will ask again from its background thread
+      if (iFlags & CONTENT_DELAYIFSLOW)
+      {
+         Pool_.Push(sFileName, iLevel);
+         return ft_delayed;
+      }
+
+      // TC may stop this request while the file is parsed by a worker
+      cancellation::scope scope(Cancellation_, sFileName);
+      Pool_.Wait(sFileName);
+      data = GetMetadata(sFileName, iLevel, scope.Token());
    }
 
-   TagLib::Ogg::File* pOggFile = dynamic_cast<TagLib::Ogg::File*>(pFile);
-   bool bJustSayXiph = pOggFile && pOggFile->isValid(); // ogg files could have only xiph comments
+   if (!data)
+      return ft_fileerror;
+
+   if (srcHash == source && metadata::AudioHashNotRead == data->m_AudioHashState)
+   {
+      // the whole file is read, TC asks again from its background thread
+      if (iFlags & CONTENT_DELAYIFSLOW)
+         return ft_delayed;
+
+      cancellation::scope scope(Cancellation_, sFileName);
+      data = AddAudioHash(sFileName, data, scope.Token());
+   }
+   if (srcHash == source && metadata::AudioHashRead != data->m_AudioHashState)
+      return ft_fieldempty;
 
-   TagLib::TrueAudio::File* pTAFile = dynamic_cast<TagLib::TrueAudio::File*>(pFile);
-   if (pTAFile && pTAFile->isValid())
+   if (srcPicture == source && metadata::PictureNotRead == data->m_PictureState)
    {
-      pId3v2 = pTAFile->ID3v2Tag();
-      pId3v1 = pTAFile->ID3v1Tag();
+      // a few reads of tag headers, still too slow for the main thread on network drives
+      if (iFlags & CONTENT_DELAYIFSLOW)
+         return ft_delayed;
+
+      data = AddPictureInfo(sFileName, data);
    }
 
-   TagLib::WavPack::File* pWPFile = dynamic_cast<TagLib::WavPack::File*>(pFile);
-   if (pWPFile && pWPFile->isValid())
+   if (srcProperties == source ? !data->m_HasProperties : (srcTag == source && !data->m_HasTag))
+      return ft_fieldempty;
+
+   const field info = OnGetField(iFieldIndex);
+   timeline_span span(Timeline_, info.m_Name, "field");
+   if (iFieldIndex < fiExtra)
+      return Fields[iFieldIndex].m_Extract(*data, Collation_, pFieldValue, iMaxLen) ? info.m_Type : ft_fieldempty;
+
+   const wchar_t* pszValue = data->m_Properties.Find(ExtraFields_[iFieldIndex - fiExtra].m_Key);
+   if (!pszValue)
+      return ft_fieldempty;
+   CopyValue((wchar_t*) pFieldValue, pszValue, std::char_traits<wchar_t>::length(pszValue), iMaxLen);
+   return info.m_Type;
+}
+
+std::string plugin::GetTagType(const audio_file& file) const
+{
+   std::ostringstream osResult;
+   TagLib::ID3v2::Tag *pId3v2 = nullptr;
+   TagLib::ID3v1::Tag *pId3v1 = nullptr;
+   TagLib::APE::Tag *pApe = nullptr;
+   TagLib::Ogg::XiphComment *pXiph = nullptr;
+   bool bJustSayXiph = false;
+
+   // get pointers to tags, the class of the file is defined by its format
+   TagLib::File* pFile = file.GetFile();
+   switch (file.GetFormat())
    {
-      pId3v1 = pWPFile->ID3v1Tag();
-      pApe = pWPFile->APETag();
+      case fmtMPEG:
+         {
+         TagLib::MPEG::File* pMpegFile = static_cast<TagLib::MPEG::File*>(pFile);
+         pId3v2 = pMpegFile->ID3v2Tag();
+         pId3v1 = pMpegFile->ID3v1Tag();
+         pApe = pMpegFile->APETag();
+         break;
+      }
+      case fmtFLAC:
+         {
+         TagLib::FLAC::File* pFlacFile = static_cast<TagLib::FLAC::File*>(pFile);
+         pId3v2 = pFlacFile->ID3v2Tag();
+         pId3v1 = pFlacFile->ID3v1Tag();
+         pXiph = pFlacFile->xiphComment();
+         break;
+      }
+      case fmtMPC:
+         {
+         TagLib::MPC::File* pMpcFile = static_cast<TagLib::MPC::File*>(pFile);
+         pId3v1 = pMpcFile->ID3v1Tag();
+         pApe = pMpcFile->APETag();
+         break;
+      }
+      case fmtOggVorbis:
+      case fmtOggFLAC:
+      case fmtSpeex:
+      case fmtOpus:
+         // ogg files could have only xiph comments
+         bJustSayXiph = true;
+         break;
+      case fmtTrueAudio:
+         {
+         TagLib::TrueAudio::File* pTAFile = static_cast<TagLib::TrueAudio::File*>(pFile);
+         pId3v2 = pTAFile->ID3v2Tag();
+         pId3v1 = pTAFile->ID3v1Tag();
+         break;
+      }
+      case fmtWavPack:
+         {
+         TagLib::WavPack::File* pWPFile = static_cast<TagLib::WavPack::File*>(pFile);
+         pId3v1 = pWPFile->ID3v1Tag();
+         pApe = pWPFile->APETag();
+         break;
+      }
+      case fmtAPE:
+         {
+         TagLib::APE::File* pApeFile = static_cast<TagLib::APE::File*>(pFile);
+         pId3v1 = pApeFile->ID3v1Tag();
+         pApe = pApeFile->APETag();
+         break;
+      }
+      default:
+         break;
    }
 
    // format text
@@ -275,15 +931,17 @@ std::string plugin::GetTagType(TagLib::File* pFile) const
 int plugin::OnSetValue(const std::wstring& sFileName, const int iFieldIndex,
       const int iUnitIndex, const int iFieldType, const void* pFieldValue, const int iFlags)
 {
+   stopwatch watch(Stats_.GetPath(stats::pathSetValue));
+
 //	if ( !TagLib::File::isWritable(sFileName.c_str()) )
 //		return ft_fileerror;
 
-   TagLib::FileRef& file = OpenFile(sFileName);
+   audio_file& file = OpenFile(sFileName);
 
-   if (file.isNull() || !file.tag())
+   if (!file.IsValid() || !file.GetFile()->tag())
       return ft_fileerror;
 
-   TagLib::Tag *tag = file.tag();
+   TagLib::Tag *tag = file.GetFile()->tag();
 
    switch (iFieldIndex)
    {
@@ -318,12 +976,142 @@ int plugin::OnSetValue(const std::wstring& sFileName, const int iFieldIndex,
 
 void plugin::OnEndOfSetValue()
 {
-   for (files_t::value_type& pair : Files2Write_)
+   // files which could not be opened were already reported by OnSetValue
+   std::vector<std::wstring> files;
+   for (const files_t::value_type& pair : Files2Write_)
    {
-      pair.second.save();
+      if (pair.second->IsValid())
+         files.push_back(pair.first);
+      Cache_.Remove(pair.first);
    }
 
+   // saves are mostly waiting for disks, so run them in parallel;
+   // Files2Write_ is not changed until all of them are done
+   std::vector<batch_error> errors;
+   RunBatch(files, [this](const std::wstring& sFileName)
+         {
+            return SaveFile(sFileName);
+         }, Threads_, SaveThreadsPerVolume_, errors);
+
    Files2Write_.clear();
+
+   if (!errors.empty())
+      ShowSaveErrors(errors);
+}
+
+bool plugin::SaveFile(const std::wstring& sFileName)
+{
+   const audio_file& file = *Files2Write_.find(sFileName)->second;
+
+   // Windows does not let a mapped file be shortened, so parses of the file
+   // are stopped and the ones started during the save do not map it
+   {
+      std::lock_guard<std::mutex> lock(SavingMutex_);
+      Saving_.insert(sFileName);
+   }
+   Pool_.Cancel(sFileName);
+   Cancellation_.Cancel(sFileName);
+   Cancellation_.Wait(sFileName);
+
+   bool bSaved;
+   {
+      timeline_span span(Timeline_, "Save", "taglib", sFileName.c_str());
+      stopwatch save(Stats_.GetPath(stats::pathSave));
+      bSaved = SaveTags(file, Padding_);
+   }
+
+   {
+      std::lock_guard<std::mutex> lock(SavingMutex_);
+      Saving_.erase(sFileName);
+   }
+
+   // streams of files to write are created by OpenFile
+   const write_tracking_stream* pStream = static_cast<const write_tracking_stream*>(file.GetStream());
+   Stats_.AddFileWritten(file.GetFormat(), pStream->GetBytesWritten() + pStream->GetBytesMoved());
+   if (pStream->GetBytesWritten() > 0 || pStream->GetBytesMoved() > 0)
+   {
+      std::lock_guard<std::mutex> lock(WriteModesMutex_);
+      WriteModes_[sFileName] = pStream->GetBytesMoved() > 0 ? "Rewrite" : "In-place";
+   }
+
+   return bSaved;
+}
+
+/// format by extension, by content if the extension does not tell it
+static format_t DetectFormat(const std::wstring& sFileName, TagLib::IOStream* pStream)
+{
+   const format_t format = GetFormatByExtension(sFileName);
+   return fmtUnknown != format ? format : SniffFormat(pStream);
+}
+
+int plugin::OnCompareFiles(PROGRESSCALLBACKPROC progress, const int iCompareIndex, const std::wstring& sFileName1,
+      const std::wstring& sFileName2)
+{
+   timeline_span span(Timeline_, "Compare", "taglib", sFileName1.c_str());
+
+   TagLib::FileStream stream1(utils::GetNativePath(sFileName1).c_str(), true);
+   TagLib::FileStream stream2(utils::GetNativePath(sFileName2).c_str(), true);
+   if (!stream1.isOpen() || !stream2.isOpen())
+      return compareFileError;
+
+   const format_t format1 = DetectFormat(sFileName1, &stream1);
+   const format_t format2 = DetectFormat(sFileName2, &stream2);
+   byte_ranges_t ranges1, ranges2;
+   if (!GetAudioRanges(&stream1, format1, ranges1) || !GetAudioRanges(&stream2, format2, ranges2))
+      return compareNotSupported;
+
+   // no need to read anything when the audio sizes differ
+   if (format1 != format2 || GetRangesLength(ranges1) != GetRangesLength(ranges2))
+      return compareDifferent;
+
+   range_reader reader1(&stream1, ranges1);
+   range_reader reader2(&stream2, ranges2);
+   std::vector<char> buffer1(MaxCompareBlock), buffer2(MaxCompareBlock);
+   for (size_t iBlock = MinCompareBlock;; iBlock = std::min(iBlock * 2, MaxCompareBlock))
+   {
+      const size_t iRead1 = reader1.Read(buffer1.data(), iBlock);
+      const size_t iRead2 = reader2.Read(buffer2.data(), iBlock);
+      // memcmp compares whole vector registers at a time
+      if (iRead1 != iRead2 || 0 != std::memcmp(buffer1.data(), buffer2.data(), iRead1))
+         return compareDifferent;
+      if (0 == iRead1)
+         break;
+
+      // TC shows progress in bytes and returns non-zero when the user aborts
+      if (progress && progress((int) iRead1))
+         return compareAborted;
+   }
+
+   return compareEqualContent;
+}
+
+int plugin::GetWriteMode(const std::wstring& sFileName, char* pszValue, const int iMaxLen)
+{
+   std::lock_guard<std::mutex> lock(WriteModesMutex_);
+
+   write_modes_t::const_iterator iter = WriteModes_.find(sFileName);
+   if (WriteModes_.end() == iter)
+      return ft_fieldempty;
+
+   CopyValue(pszValue, iter->second.c_str(), iMaxLen);
+   return ft_string;
+}
+
+void plugin::ShowSaveErrors(const std::vector<batch_error>& errors) const
+{
+   std::wostringstream osText;
+   osText << L"Could not save " << errors.size() << L" file(s):\n";
+
+   for (size_t i = 0; i < errors.size() && i < MaxSaveErrorsShown; ++i)
+   {
+      osText << L"\n" << errors[i].m_FileName << L": "
+            << std::wstring(errors[i].m_Text.begin(), errors[i].m_Text.end());
+   }
+
+   if (errors.size() > MaxSaveErrorsShown)
+      osText << L"\n... and " << errors.size() - MaxSaveErrorsShown << L" more";
+
+   utils::ShowError(osText.str());
 }
 
 }
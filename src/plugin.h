@@ -17,12 +17,34 @@
 
 #pragma once
 
+#include <atomic>
 #include <map>
-#include <fileref.h>
+#include <mutex>
+#include <set>
+#include <vector>
 #include "base.h"
+#include "batch.h"
+#include "cache.h"
+#include "cancel.h"
+#include "collate.h"
+#include "formats.h"
+#include "index.h"
+#include "pool.h"
+#include "stats.h"
+#include "stream.h"
+#include "timeline.h"
+#include "writer.h"
 
 namespace wdx
 {
+
+/// field served from the tag properties of a file
+struct extra_field
+{
+   std::wstring m_Key;
+   std::string m_Name;
+};
+
 class plugin: public base
 {
 public:
@@ -30,20 +52,59 @@ public:
    virtual ~plugin();
 
 private:
-   void OnInitFields();
+   int OnGetFieldCount() const;
+   field OnGetField(const int iFieldIndex) const;
    int OnGetValue(const std::wstring& sFileName, const int FieldIndex,
          const int UnitIndex, void* FieldValue, const int maxlen, const int flags);
    int OnSetValue(const std::wstring& sFileName, const int FieldIndex,
          const int UnitIndex, const int FieldType, const void* FieldValue, const int flags);
 
    std::string OnGetDetectString() const;
+   int OnGetDefaultSortOrder(const int iFieldIndex);
    void OnEndOfSetValue();
+   void OnLoadSettings();
+   void OnStopGetValue(const std::wstring& sFileName);
+   void OnSendStateInformation(const int iState, const std::wstring& sPath);
+   void OnPluginUnloading();
+   int OnCompareFiles(PROGRESSCALLBACKPROC progress, const int iCompareIndex, const std::wstring& sFileName1,
+         const std::wstring& sFileName2);
 
-   TagLib::FileRef& OpenFile(const std::wstring& sFileName);
-   std::string GetTagType(TagLib::File* pFile) const;
+   audio_file& OpenFile(const std::wstring& sFileName);
+   std::string GetTagType(const audio_file& file) const;
+   bool FindMetadata(const std::wstring& sFileName, const int iLevel, metadata_ptr& data);
+   metadata_ptr GetMetadata(const std::wstring& sFileName, const int iLevel, const cancel_token& token);
+   metadata_ptr AddAudioHash(const std::wstring& sFileName, const metadata_ptr& data, const cancel_token& token);
+   metadata_ptr AddPictureInfo(const std::wstring& sFileName, const metadata_ptr& data);
+   metadata_ptr ReadMetadata(const std::wstring& sFileName, const int iLevel, const cancel_token& token);
+   void Prefetch(const std::wstring& sPath);
+   void ShowSaveErrors(const std::vector<batch_error>& errors) const;
+   bool SaveFile(const std::wstring& sFileName);
+   int GetWriteMode(const std::wstring& sFileName, char* pszValue, const int iMaxLen);
 
-   typedef std::map<std::wstring, TagLib::FileRef> files_t;
+   typedef std::map<std::wstring, std::unique_ptr<audio_file> > files_t;
+   typedef std::map<std::wstring, std::string> write_modes_t;
+   typedef std::set<std::wstring> saving_t;
 
    files_t Files2Write_;
+   std::vector<extra_field> ExtraFields_;
+   bool ExtraFieldsLoaded_;
+   bool PrefetchEnabled_;
+   int Threads_;
+   int SaveThreadsPerVolume_;
+   padding_policy Padding_;
+   read_windows ReadWindows_;
+   collation Collation_;
+   std::mutex WriteModesMutex_;
+   write_modes_t WriteModes_; // how files were saved during this session
+   std::mutex SavingMutex_;
+   saving_t Saving_; // files which are being saved, they are not mapped for reading
+   std::atomic<int> PrefetchLevel_;
+   stats Stats_;
+   timeline& Timeline_;
+   std::string StatsFileName_; // empty if there is no place for the file
+   cache Cache_;
+   disk_index Index_;
+   cancellation Cancellation_;
+   pool Pool_;
 };
 }
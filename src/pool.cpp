@@ -0,0 +1,251 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include "pool.h"
+
+namespace wdx
+{
+
+pool::pool(const job_t& job) :
+      Job_(job), ThreadCount_(0), Stopping_(false)
+{
+}
+
+pool::~pool()
+{
+   Stop();
+}
+
+void pool::SetThreadCount(const int iThreads)
+{
+   std::lock_guard<std::mutex> lock(Mutex_);
+   ThreadCount_ = std::max(iThreads, 0);
+}
+
+void pool::Push(const std::wstring& sFileName, const int iLevel)
+{
+   std::lock_guard<std::mutex> lock(Mutex_);
+
+   if (Stopping_)
+      return;
+
+   queued_t::iterator iter = Queued_.find(sFileName);
+   if (Queued_.end() != iter)
+   {
+      iter->second->second = std::max(iter->second->second, iLevel);
+      Queue_.splice(Queue_.begin(), Queue_, iter->second);
+      return;
+   }
+
+   // a file which is being processed may be queued again, its job may need a higher level
+   Queue_.push_front(job_args_t(sFileName, iLevel));
+   Queued_[sFileName] = Queue_.begin();
+   Prefetched_.erase(sFileName);
+
+   // threads are started on demand, not while the dll is being loaded
+   if (Threads_.empty())
+      Start();
+
+   QueueChanged_.notify_one();
+}
+
+void pool::Prefetch(const std::vector<std::wstring>& files, const int iLevel)
+{
+   std::lock_guard<std::mutex> lock(Mutex_);
+
+   if (Stopping_)
+      return;
+
+   PrefetchQueue_.clear();
+   Prefetched_.clear();
+
+   for (const std::wstring& sFileName : files)
+   {
+      if (!Queued_.count(sFileName) && !Running_.count(sFileName)
+            && Prefetched_.insert(prefetched_t::value_type(sFileName, iLevel)).second)
+         PrefetchQueue_.push_back(sFileName);
+   }
+
+   if (PrefetchQueue_.empty())
+      return;
+
+   if (Threads_.empty())
+      Start();
+
+   QueueChanged_.notify_all();
+}
+
+void pool::Wait(const std::wstring& sFileName)
+{
+   std::unique_lock<std::mutex> lock(Mutex_);
+
+   job_args_t args(sFileName, 0);
+   bool bTaken = false;
+
+   queued_t::iterator iter = Queued_.find(sFileName);
+   if (Queued_.end() != iter)
+   {
+      args.second = iter->second->second;
+      Queue_.erase(iter->second);
+      Queued_.erase(iter);
+      bTaken = true;
+   }
+
+   prefetched_t::iterator iterPrefetched = Prefetched_.find(sFileName);
+   if (Prefetched_.end() != iterPrefetched)
+   {
+      args.second = bTaken ? std::max(args.second, iterPrefetched->second) : iterPrefetched->second;
+      Prefetched_.erase(iterPrefetched);
+      bTaken = true;
+   }
+
+   // do not wait for a free worker, caller is waiting for this file anyway
+   if (bTaken)
+   {
+      Running_[sFileName]++;
+      lock.unlock();
+
+      Run(args);
+
+      lock.lock();
+      if (!--Running_[sFileName])
+         Running_.erase(sFileName);
+      JobDone_.notify_all();
+   }
+
+   while (Running_.count(sFileName))
+   {
+      JobDone_.wait(lock);
+   }
+}
+
+void pool::Cancel(const std::wstring& sFileName)
+{
+   std::lock_guard<std::mutex> lock(Mutex_);
+
+   queued_t::iterator iter = Queued_.find(sFileName);
+   if (Queued_.end() != iter)
+   {
+      Queue_.erase(iter->second);
+      Queued_.erase(iter);
+   }
+   Prefetched_.erase(sFileName);
+}
+
+void pool::Stop()
+{
+   {
+      std::lock_guard<std::mutex> lock(Mutex_);
+      Stopping_ = true;
+      Queue_.clear();
+      Queued_.clear();
+      PrefetchQueue_.clear();
+      Prefetched_.clear();
+      QueueChanged_.notify_all();
+   }
+
+   for (std::thread& thread : Threads_)
+   {
+      thread.join();
+   }
+
+   std::lock_guard<std::mutex> lock(Mutex_);
+   Threads_.clear();
+   Stopping_ = false;
+}
+
+void pool::Start()
+{
+   int iThreads = ThreadCount_;
+   if (!iThreads)
+      iThreads = std::max((int) std::thread::hardware_concurrency(), 2);
+
+   for (int i = 0; i < iThreads; ++i)
+   {
+      Threads_.push_back(std::thread(&pool::WorkerProc, this));
+   }
+}
+
+void pool::WorkerProc()
+{
+   std::unique_lock<std::mutex> lock(Mutex_);
+
+   for (;;)
+   {
+      job_args_t args;
+      while (!Stopping_ && !Take(args))
+      {
+         QueueChanged_.wait(lock);
+      }
+
+      if (Stopping_)
+         return;
+
+      Running_[args.first]++;
+      lock.unlock();
+
+      Run(args);
+
+      lock.lock();
+      if (!--Running_[args.first])
+         Running_.erase(args.first);
+      JobDone_.notify_all();
+   }
+}
+
+bool pool::Take(job_args_t& args)
+{
+   if (!Queue_.empty())
+   {
+      args = Queue_.front();
+      Queue_.pop_front();
+      Queued_.erase(args.first);
+      return true;
+   }
+
+   while (!PrefetchQueue_.empty())
+   {
+      const std::wstring sFileName = PrefetchQueue_.front();
+      PrefetchQueue_.pop_front();
+
+      // skip files which were requested or cancelled meanwhile
+      prefetched_t::iterator iter = Prefetched_.find(sFileName);
+      if (Prefetched_.end() != iter)
+      {
+         args = *iter;
+         Prefetched_.erase(iter);
+         return true;
+      }
+   }
+
+   return false;
+}
+
+void pool::Run(const job_args_t& args)
+{
+   try
+   {
+      Job_(args.first, args.second);
+   }
+   catch (...)
+   {
+      // errors are reported when the file is requested in foreground
+   }
+}
+
+}
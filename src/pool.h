@@ -0,0 +1,92 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace wdx
+{
+
+/// pool of worker threads which process files in background,
+/// files requested last are processed first, prefetched files are
+/// processed in their order when there are no requested ones.
+/// Each file is queued with a level of detail passed to the job, when a
+/// file is queued twice the higher level is used.
+class pool
+{
+public:
+   typedef std::function<void(const std::wstring&, const int)> job_t;
+
+   explicit pool(const job_t& job);
+   ~pool();
+
+   /// sets number of worker threads, 0 means number of cores
+   void SetThreadCount(const int iThreads);
+
+   /// queues file for processing, moves it to the top if it is queued already
+   void Push(const std::wstring& sFileName, const int iLevel);
+
+   /// waits until file is processed; if it is still queued then it is
+   /// processed in the calling thread
+   void Wait(const std::wstring& sFileName);
+
+   /// replaces prefetch queue with the given files
+   void Prefetch(const std::vector<std::wstring>& files, const int iLevel);
+
+   /// removes file from the queue if it is not being processed yet
+   void Cancel(const std::wstring& sFileName);
+
+   /// drops queued files and waits for worker threads to finish
+   void Stop();
+
+private:
+   typedef std::pair<std::wstring, int> job_args_t;
+   typedef std::list<job_args_t> queue_t;
+   typedef std::unordered_map<std::wstring, queue_t::iterator> queued_t;
+   typedef std::unordered_map<std::wstring, int> running_t;
+   typedef std::deque<std::wstring> prefetch_t;
+   typedef std::unordered_map<std::wstring, int> prefetched_t;
+
+   void Start();
+   void WorkerProc();
+   void Run(const job_args_t& args);
+   bool Take(job_args_t& args);
+
+   job_t Job_;
+   int ThreadCount_;
+   bool Stopping_;
+
+   std::mutex Mutex_;
+   std::condition_variable QueueChanged_;
+   std::condition_variable JobDone_;
+   queue_t Queue_; // top is in front
+   queued_t Queued_;
+   running_t Running_; // number of jobs running for a file
+   prefetch_t PrefetchQueue_;
+   prefetched_t Prefetched_; // files from PrefetchQueue_ which are still to be processed
+   std::vector<std::thread> Threads_;
+};
+}
@@ -0,0 +1,163 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "serial.h"
+
+namespace wdx
+{
+
+serial_writer::serial_writer(std::vector<char>& buffer) :
+      Buffer_(buffer)
+{
+}
+
+void serial_writer::U8(const unsigned char value)
+{
+   Buffer_.push_back((char) value);
+}
+
+void serial_writer::U32(const unsigned int value)
+{
+   for (int i = 0; i < 4; ++i)
+   {
+      Buffer_.push_back((char) ((value >> (8 * i)) & 0xFF));
+   }
+}
+
+void serial_writer::U64(const unsigned long long value)
+{
+   U32((unsigned int) (value & 0xFFFFFFFF));
+   U32((unsigned int) (value >> 32));
+}
+
+void serial_writer::I32(const int value)
+{
+   U32((unsigned int) value);
+}
+
+void serial_writer::String(const std::string& value)
+{
+   U32((unsigned int) value.size());
+   Buffer_.insert(Buffer_.end(), value.begin(), value.end());
+}
+
+void serial_writer::WString(const std::wstring& value)
+{
+   std::vector<unsigned short> units;
+   units.reserve(value.size());
+   for (const wchar_t ch : value)
+   {
+      const unsigned int code = (unsigned int) ch;
+      if (code > 0xFFFF) // wchar_t is 32 bit wide, store a surrogate pair
+      {
+         units.push_back((unsigned short) (0xD800 + ((code - 0x10000) >> 10)));
+         units.push_back((unsigned short) (0xDC00 + ((code - 0x10000) & 0x3FF)));
+      }
+      else
+         units.push_back((unsigned short) code);
+   }
+
+   U32((unsigned int) units.size());
+   for (const unsigned short unit : units)
+   {
+      Buffer_.push_back((char) (unit & 0xFF));
+      Buffer_.push_back((char) (unit >> 8));
+   }
+}
+
+serial_reader::serial_reader(const char* pData, const size_t iSize) :
+      Data_((const unsigned char*) pData), End_((const unsigned char*) pData + iSize)
+{
+}
+
+bool serial_reader::U8(unsigned char& value)
+{
+   if (Left() < 1)
+      return false;
+   value = *Data_++;
+   return true;
+}
+
+bool serial_reader::U32(unsigned int& value)
+{
+   if (Left() < 4)
+      return false;
+   value = Data_[0] | (Data_[1] << 8) | (Data_[2] << 16) | ((unsigned int) Data_[3] << 24);
+   Data_ += 4;
+   return true;
+}
+
+bool serial_reader::U64(unsigned long long& value)
+{
+   unsigned int iLow = 0, iHigh = 0;
+   if (!U32(iLow) || !U32(iHigh))
+      return false;
+   value = ((unsigned long long) iHigh << 32) | iLow;
+   return true;
+}
+
+bool serial_reader::I32(int& value)
+{
+   unsigned int iValue = 0;
+   if (!U32(iValue))
+      return false;
+   value = (int) iValue;
+   return true;
+}
+
+bool serial_reader::String(std::string& value)
+{
+   unsigned int iSize = 0;
+   if (!U32(iSize) || Left() < iSize)
+      return false;
+   value.assign((const char*) Data_, iSize);
+   Data_ += iSize;
+   return true;
+}
+
+bool serial_reader::WString(std::wstring& value)
+{
+   unsigned int iUnits = 0;
+   if (!U32(iUnits) || Left() / 2 < iUnits)
+      return false;
+
+   value.clear();
+   value.reserve(iUnits);
+   for (unsigned int i = 0; i < iUnits; ++i, Data_ += 2)
+   {
+      unsigned int code = Data_[0] | (Data_[1] << 8);
+      if (sizeof(wchar_t) > 2 && code >= 0xD800 && code < 0xDC00 && i + 1 < iUnits)
+      {
+         const unsigned int low = Data_[2] | (Data_[3] << 8);
+         if (low >= 0xDC00 && low < 0xE000)
+         {
+            code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+            Data_ += 2;
+            ++i;
+         }
+      }
+      value.push_back((wchar_t) code);
+   }
+   return true;
+}
+
+size_t serial_reader::Left() const
+{
+   return End_ - Data_;
+}
+
+}
@@ -0,0 +1,64 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace wdx
+{
+
+/// appends values to a byte buffer in a platform independent layout:
+/// little endian integers, strings as UTF-16 code units prefixed with length
+class serial_writer
+{
+public:
+   explicit serial_writer(std::vector<char>& buffer);
+
+   void U8(const unsigned char value);
+   void U32(const unsigned int value);
+   void U64(const unsigned long long value);
+   void I32(const int value);
+   void String(const std::string& value);
+   void WString(const std::wstring& value);
+
+private:
+   std::vector<char>& Buffer_;
+};
+
+/// reads values written by serial_writer, fails on the first read
+/// beyond the end of data
+class serial_reader
+{
+public:
+   serial_reader(const char* pData, const size_t iSize);
+
+   bool U8(unsigned char& value);
+   bool U32(unsigned int& value);
+   bool U64(unsigned long long& value);
+   bool I32(int& value);
+   bool String(std::string& value);
+   bool WString(std::wstring& value);
+
+   size_t Left() const;
+
+private:
+   const unsigned char* Data_;
+   const unsigned char* End_;
+};
+}
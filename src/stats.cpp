@@ -0,0 +1,279 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include "stats.h"
+
+namespace wdx
+{
+
+static const char* PathNames[] =
+{
+   "Open",
+   "Parse tags",
+   "Parse tags and properties",
+   "Set value",
+   "Save",
+};
+
+static_assert(sizeof(PathNames) / sizeof(PathNames[0]) == stats::pathCount, "name is missing for a path");
+
+histogram::histogram() :
+      Count_(0), Total_(0), Max_(0)
+{
+   for (std::atomic<unsigned long long>& bucket : Buckets_)
+      bucket.store(0, std::memory_order_relaxed);
+}
+
+unsigned int histogram::GetBucket(const unsigned long long iValue)
+{
+   if (iValue < SubBuckets)
+      return (unsigned int) iValue;
+
+   // position of the highest bit defines the group, next bits the bucket in it
+   unsigned int iBit = SubBucketBits;
+   while (iBit < MaxBits && (iValue >> (iBit + 1)) != 0)
+      ++iBit;
+   if ((iValue >> (iBit + 1)) != 0)
+      return BucketCount - 1;
+
+   return (iBit - SubBucketBits + 1) * SubBuckets + (unsigned int) ((iValue >> (iBit - SubBucketBits)) & (SubBuckets - 1));
+}
+
+unsigned long long histogram::GetBucketValue(const unsigned int iBucket)
+{
+   if (iBucket < SubBuckets)
+      return iBucket;
+
+   // middle of the bucket
+   const unsigned int iShift = iBucket / SubBuckets - 1;
+   const unsigned long long iLower = (unsigned long long) (SubBuckets + iBucket % SubBuckets) << iShift;
+   return iLower + ((1ULL << iShift) >> 1);
+}
+
+void histogram::Record(const unsigned long long iNanoseconds)
+{
+   Buckets_[GetBucket(iNanoseconds)].fetch_add(1, std::memory_order_relaxed);
+   Count_.fetch_add(1, std::memory_order_relaxed);
+   Total_.fetch_add(iNanoseconds, std::memory_order_relaxed);
+
+   unsigned long long iMax = Max_.load(std::memory_order_relaxed);
+   while (iNanoseconds > iMax && !Max_.compare_exchange_weak(iMax, iNanoseconds, std::memory_order_relaxed))
+   {
+   }
+}
+
+unsigned long long histogram::GetCount() const
+{
+   return Count_.load(std::memory_order_relaxed);
+}
+
+unsigned long long histogram::GetTotal() const
+{
+   return Total_.load(std::memory_order_relaxed);
+}
+
+unsigned long long histogram::GetMax() const
+{
+   return Max_.load(std::memory_order_relaxed);
+}
+
+unsigned long long histogram::GetPercentile(const double fPercent) const
+{
+   // buckets are summed up again rather than using Count_, both change concurrently
+   unsigned long long iCount = 0;
+   for (const std::atomic<unsigned long long>& bucket : Buckets_)
+      iCount += bucket.load(std::memory_order_relaxed);
+   if (0 == iCount)
+      return 0;
+
+   const unsigned long long iRank = std::max(1ULL, (unsigned long long) (iCount * fPercent / 100.0 + 0.5));
+   unsigned long long iSeen = 0;
+   for (unsigned int i = 0; i < BucketCount; ++i)
+   {
+      iSeen += Buckets_[i].load(std::memory_order_relaxed);
+      if (iSeen >= iRank)
+         return std::min(GetBucketValue(i), GetMax());
+   }
+   return GetMax();
+}
+
+stopwatch::stopwatch(histogram& hist) :
+      Histogram_(hist), Start_(std::chrono::steady_clock::now()), Stopped_(false)
+{
+}
+
+stopwatch::~stopwatch()
+{
+   Stop();
+}
+
+void stopwatch::Stop()
+{
+   if (Stopped_)
+      return;
+
+   Stopped_ = true;
+   Histogram_.Record((unsigned long long) std::chrono::duration_cast<std::chrono::nanoseconds>(
+         std::chrono::steady_clock::now() - Start_).count());
+}
+
+stats::stats() :
+      Start_(std::chrono::steady_clock::now()), Stopping_(false), IntervalSec_(0)
+{
+}
+
+stats::~stats()
+{
+   StopSnapshots();
+}
+
+histogram& stats::GetPath(const path_t path)
+{
+   return Paths_[path];
+}
+
+histogram& stats::GetField(const int iFieldIndex)
+{
+   // fields beyond the limit share the last histogram
+   return Fields_[std::min(std::max(iFieldIndex, 0), MaxFields - 1)];
+}
+
+void stats::SetFieldName(const int iFieldIndex, const std::string& sName)
+{
+   if (iFieldIndex < 0 || iFieldIndex >= MaxFields)
+      return;
+
+   std::lock_guard<std::mutex> lock(Mutex_);
+   if (FieldNames_.size() <= (size_t) iFieldIndex)
+      FieldNames_.resize(iFieldIndex + 1);
+   FieldNames_[iFieldIndex] = sName;
+}
+
+void stats::AddFileRead(const format_t format, const unsigned long long iBytes)
+{
+   format_counters& counters = Formats_[format < fmtCount ? format : fmtUnknown];
+   counters.m_FilesRead.fetch_add(1, std::memory_order_relaxed);
+   counters.m_BytesRead.fetch_add(iBytes, std::memory_order_relaxed);
+}
+
+void stats::AddFileWritten(const format_t format, const unsigned long long iBytes)
+{
+   format_counters& counters = Formats_[format < fmtCount ? format : fmtUnknown];
+   counters.m_FilesWritten.fetch_add(1, std::memory_order_relaxed);
+   counters.m_BytesWritten.fetch_add(iBytes, std::memory_order_relaxed);
+}
+
+static void WriteHistogram(std::ostream& out, const std::string& sName, const histogram& hist)
+{
+   const unsigned long long iCount = hist.GetCount();
+   if (0 == iCount)
+      return;
+
+   char buf[256];
+   snprintf(buf, sizeof(buf), "%-32s %10llu %10.1f %10.1f %10.1f %10.1f %10.1f\n", sName.c_str(), iCount,
+         hist.GetTotal() / 1000.0 / iCount, hist.GetPercentile(50) / 1000.0, hist.GetPercentile(90) / 1000.0,
+         hist.GetPercentile(99) / 1000.0, hist.GetMax() / 1000.0);
+   out << buf;
+}
+
+bool stats::Write(const std::string& sFileName)
+{
+   std::vector<std::string> names;
+   {
+      std::lock_guard<std::mutex> lock(Mutex_);
+      names = FieldNames_;
+   }
+
+   std::ofstream out(sFileName.c_str(), std::ios::out | std::ios::trunc);
+   if (!out)
+      return false;
+
+   char buf[256];
+   snprintf(buf, sizeof(buf), "WDXTagLib statistics, %lld s since load\n\n", (long long) std::chrono::duration_cast<
+         std::chrono::seconds>(std::chrono::steady_clock::now() - Start_).count());
+   out << buf;
+
+   snprintf(buf, sizeof(buf), "%-32s %10s %10s %10s %10s %10s %10s\n", "Call, us", "count", "mean", "p50", "p90", "p99",
+         "max");
+   out << buf;
+   for (int i = 0; i < pathCount; ++i)
+      WriteHistogram(out, PathNames[i], Paths_[i]);
+   for (int i = 0; i < MaxFields; ++i)
+      WriteHistogram(out, "Get value: " + ((size_t) i < names.size() ? names[i] : std::to_string(i)), Fields_[i]);
+
+   snprintf(buf, sizeof(buf), "\n%-32s %14s %14s %14s %14s\n", "Format", "files read", "bytes read", "files written",
+         "bytes written");
+   out << buf;
+   for (int i = 0; i < fmtCount; ++i)
+   {
+      const format_counters& counters = Formats_[i];
+      if (0 == counters.m_FilesRead && 0 == counters.m_FilesWritten)
+         continue;
+
+      snprintf(buf, sizeof(buf), "%-32s %14llu %14llu %14llu %14llu\n", GetFormatName((format_t) i),
+            counters.m_FilesRead.load(), counters.m_BytesRead.load(), counters.m_FilesWritten.load(),
+            counters.m_BytesWritten.load());
+      out << buf;
+   }
+
+   return out.good();
+}
+
+void stats::SetSnapshots(const std::string& sFileName, const int iIntervalSec)
+{
+   StopSnapshots();
+
+   if (iIntervalSec <= 0)
+      return;
+
+   std::lock_guard<std::mutex> lock(Mutex_);
+   FileName_ = sFileName;
+   IntervalSec_ = iIntervalSec;
+   Stopping_ = false;
+   Thread_ = std::thread(&stats::SnapshotProc, this);
+}
+
+void stats::StopSnapshots()
+{
+   {
+      std::lock_guard<std::mutex> lock(Mutex_);
+      Stopping_ = true;
+   }
+   Stop_.notify_all();
+
+   if (Thread_.joinable())
+      Thread_.join();
+}
+
+void stats::SnapshotProc()
+{
+   std::unique_lock<std::mutex> lock(Mutex_);
+   while (!Stop_.wait_for(lock, std::chrono::seconds(IntervalSec_), [this]
+         {
+            return Stopping_;
+         }))
+   {
+      const std::string sFileName = FileName_;
+      lock.unlock();
+      Write(sFileName);
+      lock.lock();
+   }
+}
+}
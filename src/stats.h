@@ -0,0 +1,150 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "formats.h"
+
+namespace wdx
+{
+
+/// lock-free latency histogram with buckets of constant relative width
+/// (16 per power of two, about 6% precision) in the HDR histogram manner
+class histogram
+{
+public:
+   histogram();
+
+   void Record(const unsigned long long iNanoseconds);
+
+   unsigned long long GetCount() const;
+   unsigned long long GetTotal() const;
+   unsigned long long GetMax() const;
+
+   /// value below which the given percent of recorded values lie
+   unsigned long long GetPercentile(const double fPercent) const;
+
+private:
+   histogram(const histogram&);
+   histogram& operator=(const histogram&);
+
+   static const unsigned int SubBucketBits = 4;
+   static const unsigned int SubBuckets = 1 << SubBucketBits;
+   // values up to 2^40 ns, about 18 minutes
+   static const unsigned int MaxBits = 40;
+   static const unsigned int BucketCount = (MaxBits - SubBucketBits + 2) * SubBuckets;
+
+   static unsigned int GetBucket(const unsigned long long iValue);
+   static unsigned long long GetBucketValue(const unsigned int iBucket);
+
+   std::atomic<unsigned long long> Buckets_[BucketCount];
+   std::atomic<unsigned long long> Count_;
+   std::atomic<unsigned long long> Total_;
+   std::atomic<unsigned long long> Max_;
+};
+
+/// records time of its lifetime, or until Stop, into a histogram
+class stopwatch
+{
+public:
+   explicit stopwatch(histogram& hist);
+   ~stopwatch();
+
+   void Stop();
+
+private:
+   stopwatch(const stopwatch&);
+   stopwatch& operator=(const stopwatch&);
+
+   histogram& Histogram_;
+   std::chrono::steady_clock::time_point Start_;
+   bool Stopped_;
+};
+
+/// counters and latency histograms of the main plugin paths, snapshots of
+/// them are written to a text file
+class stats
+{
+public:
+   enum path_t
+   {
+      pathOpen = 0, // opening a file stream
+      pathParseTags, // TagLib parse without audio properties
+      pathParseProperties, // TagLib parse of tags and audio properties
+      pathSetValue,
+      pathSave,
+      pathCount
+   };
+
+   static const int MaxFields = 64;
+
+   stats();
+   ~stats();
+
+   histogram& GetPath(const path_t path);
+   /// histogram of OnGetValue calls of the field
+   histogram& GetField(const int iFieldIndex);
+   void SetFieldName(const int iFieldIndex, const std::string& sName);
+
+   void AddFileRead(const format_t format, const unsigned long long iBytes);
+   void AddFileWritten(const format_t format, const unsigned long long iBytes);
+
+   /// writes snapshot of all counters, replaces the file
+   bool Write(const std::string& sFileName);
+
+   /// writes snapshots every given number of seconds from a background
+   /// thread, 0 stops it
+   void SetSnapshots(const std::string& sFileName, const int iIntervalSec);
+   void StopSnapshots();
+
+private:
+   struct format_counters
+   {
+      std::atomic<unsigned long long> m_FilesRead;
+      std::atomic<unsigned long long> m_BytesRead;
+      std::atomic<unsigned long long> m_FilesWritten;
+      std::atomic<unsigned long long> m_BytesWritten;
+
+      format_counters() :
+            m_FilesRead(0), m_BytesRead(0), m_FilesWritten(0), m_BytesWritten(0)
+      {
+      }
+   };
+
+   void SnapshotProc();
+
+   histogram Paths_[pathCount];
+   histogram Fields_[MaxFields];
+   format_counters Formats_[fmtCount];
+   std::chrono::steady_clock::time_point Start_;
+
+   std::mutex Mutex_;
+   std::vector<std::string> FieldNames_;
+   std::condition_variable Stop_;
+   bool Stopping_;
+   std::string FileName_;
+   int IntervalSec_;
+   std::thread Thread_;
+};
+}
@@ -0,0 +1,568 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cstring>
+#include <tfilestream.h>
+#include "formats.h"
+#include "stream.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <unistd.h>
+#endif
+
+namespace wdx
+{
+
+stream_wrapper::stream_wrapper(TagLib::IOStream* pStream) :
+      Stream_(pStream)
+{
+}
+
+stream_wrapper::~stream_wrapper()
+{
+}
+
+TagLib::FileName stream_wrapper::name() const
+{
+   return Stream_->name();
+}
+
+TagLib::ByteVector stream_wrapper::readBlock(TagLib::ulong length)
+{
+   return Stream_->readBlock(length);
+}
+
+void stream_wrapper::writeBlock(const TagLib::ByteVector& data)
+{
+   Stream_->writeBlock(data);
+}
+
+void stream_wrapper::insert(const TagLib::ByteVector& data, TagLib::ulong start, TagLib::ulong replace)
+{
+   Stream_->insert(data, start, replace);
+}
+
+void stream_wrapper::removeBlock(TagLib::ulong start, TagLib::ulong length)
+{
+   Stream_->removeBlock(start, length);
+}
+
+bool stream_wrapper::readOnly() const
+{
+   return Stream_->readOnly();
+}
+
+bool stream_wrapper::isOpen() const
+{
+   return Stream_->isOpen();
+}
+
+void stream_wrapper::seek(long offset, Position p)
+{
+   Stream_->seek(offset, p);
+}
+
+void stream_wrapper::clear()
+{
+   Stream_->clear();
+}
+
+long stream_wrapper::tell() const
+{
+   return Stream_->tell();
+}
+
+long stream_wrapper::length()
+{
+   return Stream_->length();
+}
+
+void stream_wrapper::truncate(long length)
+{
+   Stream_->truncate(length);
+}
+
+cancellable_stream::cancellable_stream(TagLib::IOStream* pStream, const cancel_token& token) :
+      stream_wrapper(pStream), Token_(token)
+{
+}
+
+TagLib::ByteVector cancellable_stream::readBlock(TagLib::ulong length)
+{
+   if (Token_)
+      return TagLib::ByteVector();
+   return stream_wrapper::readBlock(length);
+}
+
+void cancellable_stream::seek(long offset, Position p)
+{
+   // parsers stop at the end of file, so jump there
+   if (Token_)
+      stream_wrapper::seek(0, End);
+   else
+      stream_wrapper::seek(offset, p);
+}
+
+read_tracking_stream::read_tracking_stream(TagLib::IOStream* pStream) :
+      stream_wrapper(pStream), BytesRead_(0)
+{
+}
+
+TagLib::ByteVector read_tracking_stream::readBlock(TagLib::ulong length)
+{
+   const TagLib::ByteVector data = stream_wrapper::readBlock(length);
+   BytesRead_ += data.size();
+   return data;
+}
+
+write_tracking_stream::write_tracking_stream(TagLib::IOStream* pStream) :
+      stream_wrapper(pStream), BytesWritten_(0), BytesMoved_(0)
+{
+}
+
+void write_tracking_stream::writeBlock(const TagLib::ByteVector& data)
+{
+   BytesWritten_ += data.size();
+   stream_wrapper::writeBlock(data);
+}
+
+void write_tracking_stream::insert(const TagLib::ByteVector& data, TagLib::ulong start, TagLib::ulong replace)
+{
+   const long iLength = length();
+   BytesWritten_ += data.size();
+   if (data.size() != replace && (long) (start + replace) < iLength)
+      BytesMoved_ += iLength - (start + replace);
+   stream_wrapper::insert(data, start, replace);
+}
+
+void write_tracking_stream::removeBlock(TagLib::ulong start, TagLib::ulong length)
+{
+   const long iLength = stream_wrapper::length();
+   if ((long) (start + length) < iLength)
+      BytesMoved_ += iLength - (start + length);
+   stream_wrapper::removeBlock(start, length);
+}
+
+// one read of the stream, appended to the buffer
+static bool AppendRange(TagLib::IOStream* pStream, const long iOffset, const long iSize, std::vector<char>& buffer)
+{
+   pStream->seek(iOffset);
+   const TagLib::ByteVector data = pStream->readBlock((TagLib::ulong) iSize);
+   buffer.insert(buffer.end(), data.data(), data.data() + data.size());
+   return (long) data.size() == iSize;
+}
+
+static unsigned long GetLittleEndian(const char* pData)
+{
+   const unsigned char* p = (const unsigned char*) pData;
+   return (unsigned long) p[0] | ((unsigned long) p[1] << 8) | ((unsigned long) p[2] << 16)
+         | ((unsigned long) p[3] << 24);
+}
+
+// windows grow at most by this, bigger tags are read through to the file
+static const long MaxWindowGrowth = 16 * 1024 * 1024;
+
+windowed_stream::windowed_stream(TagLib::IOStream* pStream, const read_windows& windows) :
+      stream_wrapper(pStream), Windows_(windows), TailStart_(0), Length_(-1), Position_(0), Loaded_(false)
+{
+}
+
+TagLib::ByteVector windowed_stream::readBlock(TagLib::ulong length)
+{
+   Load();
+   if (!length || Position_ >= Length_)
+      return TagLib::ByteVector();
+
+   const long iLength = (long) std::min<TagLib::ulong>(length, Length_ - Position_);
+   const long iStart = Position_;
+   Position_ += iLength;
+   if (iStart + iLength <= (long) Head_.size())
+      return TagLib::ByteVector(&Head_[iStart], iLength);
+   // the tail window reaches the end of file
+   if (iStart >= TailStart_ && !Tail_.empty())
+      return TagLib::ByteVector(&Tail_[iStart - TailStart_], iLength);
+
+   Stream_->seek(iStart);
+   const TagLib::ByteVector data = Stream_->readBlock(iLength);
+   Position_ = iStart + data.size();
+   return data;
+}
+
+void windowed_stream::writeBlock(const TagLib::ByteVector& data)
+{
+   Stream_->seek(Position_);
+   Stream_->writeBlock(data);
+   Reset();
+}
+
+void windowed_stream::insert(const TagLib::ByteVector& data, TagLib::ulong start, TagLib::ulong replace)
+{
+   Stream_->insert(data, start, replace);
+   Reset();
+}
+
+void windowed_stream::removeBlock(TagLib::ulong start, TagLib::ulong length)
+{
+   Stream_->removeBlock(start, length);
+   Reset();
+}
+
+void windowed_stream::seek(long offset, Position p)
+{
+   switch (p)
+   {
+      case Beginning:
+         Position_ = offset;
+         break;
+      case Current:
+         Position_ += offset;
+         break;
+      case End:
+         Position_ = length() + offset;
+         break;
+   }
+
+   if (Position_ < 0)
+      Position_ = 0;
+}
+
+long windowed_stream::tell() const
+{
+   return Position_;
+}
+
+long windowed_stream::length()
+{
+   if (Length_ < 0)
+      Length_ = Stream_->length();
+   return Length_;
+}
+
+void windowed_stream::truncate(long length)
+{
+   Stream_->truncate(length);
+   Reset();
+}
+
+void windowed_stream::Load()
+{
+   if (Loaded_)
+      return;
+   Loaded_ = true;
+
+   const long iLength = length();
+   const long iHead = std::min<long>(Windows_.m_Head, iLength);
+   if (iHead > 0 && AppendRange(Stream_.get(), 0, iHead, Head_))
+   {
+      // the window is kept behind a bigger tag, where the audio data starts;
+      // a size which does not fit the file is damage, not a tag to fetch
+      const long iTagEnd = GetHeadTagEnd();
+      if (iTagEnd > iHead && iTagEnd <= iLength && iTagEnd - iHead <= MaxWindowGrowth)
+         AppendRange(Stream_.get(), iHead, std::min<long>(iTagEnd + Windows_.m_Head, iLength) - iHead, Head_);
+   }
+
+   // the windows do not overlap, a small file is read at once
+   TailStart_ = std::max<long>(Head_.size(), iLength - (long) Windows_.m_Tail);
+   if (TailStart_ >= iLength || !AppendRange(Stream_.get(), TailStart_, iLength - TailStart_, Tail_))
+   {
+      Tail_.clear();
+      TailStart_ = iLength;
+      return;
+   }
+
+   const long iTagStart = std::max<long>(GetTailTagStart(), Head_.size());
+   if (iTagStart < TailStart_ && TailStart_ - iTagStart <= MaxWindowGrowth)
+   {
+      std::vector<char> tail;
+      if (AppendRange(Stream_.get(), iTagStart, TailStart_ - iTagStart, tail))
+      {
+         tail.insert(tail.end(), Tail_.begin(), Tail_.end());
+         Tail_.swap(tail);
+         TailStart_ = iTagStart;
+      }
+   }
+
+   // windows which meet are joined, so reads over both are served too
+   if (TailStart_ == (long) Head_.size())
+   {
+      Head_.insert(Head_.end(), Tail_.begin(), Tail_.end());
+      Tail_.clear();
+      TailStart_ = iLength;
+   }
+}
+
+long windowed_stream::GetHeadTagEnd() const
+{
+   // ID3v2 header with a synchsafe size, which excludes the header and the footer
+   if (Head_.size() < 10 || Head_[0] != 'I' || Head_[1] != 'D' || Head_[2] != '3')
+      return 0;
+
+   const unsigned char* p = (const unsigned char*) &Head_[0];
+   if ((p[6] | p[7] | p[8] | p[9]) & 0x80)
+      return 0;
+
+   const long iSize = ((long) p[6] << 21) | ((long) p[7] << 14) | ((long) p[8] << 7) | (long) p[9];
+   return 10 + iSize + ((p[5] & 0x10) ? 10 : 0);
+}
+
+long windowed_stream::GetTailTagStart() const
+{
+   // APE tag ends with a footer, before ID3v1 if there is one
+   long iEnd = Length_;
+   const char* pID3v1 = GetTail(iEnd - 128, 3);
+   if (pID3v1 && 0 == std::memcmp(pID3v1, "TAG", 3))
+      iEnd -= 128;
+
+   const char* pFooter = GetTail(iEnd - 32, 32);
+   if (!pFooter || std::memcmp(pFooter, "APETAGEX", 8) != 0)
+      return iEnd;
+
+   // size includes the footer but not the header
+   const unsigned long iSize = GetLittleEndian(pFooter + 12);
+   const bool bHeader = (GetLittleEndian(pFooter + 20) & 0x80000000UL) != 0;
+   const unsigned long long iTotal = (unsigned long long) iSize + (bHeader ? 32 : 0);
+   // a tag bigger than the file is damage, it is not fetched
+   return iTotal > (unsigned long long) iEnd ? iEnd : iEnd - (long) iTotal;
+}
+
+const char* windowed_stream::GetTail(const long iOffset, const long iSize) const
+{
+   if (iOffset < TailStart_ || iOffset + iSize > TailStart_ + (long) Tail_.size())
+      return nullptr;
+   return &Tail_[iOffset - TailStart_];
+}
+
+void windowed_stream::Reset()
+{
+   Head_.clear();
+   Tail_.clear();
+   TailStart_ = 0;
+   Length_ = -1;
+   Position_ = Stream_->tell();
+   Loaded_ = false;
+}
+
+// every worker maps a file, in a 32-bit process mappings of big files would
+// use up the address space; bigger files are read through the windows
+#if defined(_WIN64) || (!defined(_WIN32) && defined(__LP64__))
+static const unsigned long long MaxMappedSize = 0x7FFFFFFF;
+#else
+static const unsigned long long MaxMappedSize = 16 * 1024 * 1024;
+#endif
+
+#ifdef _WIN32
+
+mapped_stream::mapped_stream(const std::wstring& sFileName, const unsigned long long iMaxSize) :
+      FileName_(sFileName), File_(INVALID_HANDLE_VALUE), Mapping_(NULL), Data_(nullptr), Size_(0), Position_(0)
+{
+   File_ = CreateFileW(FileName_.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+         NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+   if (INVALID_HANDLE_VALUE == File_)
+      return;
+
+   // empty files can not be mapped
+   LARGE_INTEGER size;
+   if (!GetFileSizeEx(File_, &size) || !size.QuadPart || (unsigned long long) size.QuadPart > iMaxSize)
+      return;
+
+   Mapping_ = CreateFileMappingW(File_, NULL, PAGE_READONLY, 0, 0, NULL);
+   if (!Mapping_)
+      return;
+
+   Data_ = (const char*) MapViewOfFile(Mapping_, FILE_MAP_READ, 0, 0, 0);
+   if (Data_)
+      Size_ = (long) size.QuadPart;
+}
+
+mapped_stream::~mapped_stream()
+{
+   if (Data_)
+      UnmapViewOfFile(Data_);
+   if (Mapping_)
+      CloseHandle(Mapping_);
+   if (INVALID_HANDLE_VALUE != File_)
+      CloseHandle(File_);
+}
+
+#else
+
+mapped_stream::mapped_stream(const std::wstring& sFileName, const unsigned long long iMaxSize) :
+      FileName_(utils::GetNativePath(sFileName)), File_(-1), Data_(nullptr), Size_(0), Position_(0)
+{
+   File_ = open(FileName_.c_str(), O_RDONLY);
+   if (-1 == File_)
+      return;
+
+   // empty files can not be mapped
+   struct stat data;
+   if (fstat(File_, &data) != 0 || !data.st_size || (unsigned long long) data.st_size > iMaxSize)
+      return;
+
+   void* pData = mmap(NULL, data.st_size, PROT_READ, MAP_SHARED, File_, 0);
+   if (MAP_FAILED == pData)
+      return;
+
+   Data_ = (const char*) pData;
+   Size_ = (long) data.st_size;
+}
+
+mapped_stream::~mapped_stream()
+{
+   if (Data_)
+      munmap((void*) Data_, Size_);
+   if (-1 != File_)
+      close(File_);
+}
+
+#endif
+
+TagLib::FileName mapped_stream::name() const
+{
+   return FileName_.c_str();
+}
+
+TagLib::ByteVector mapped_stream::readBlock(TagLib::ulong length)
+{
+   if (!Data_ || Position_ >= Size_)
+      return TagLib::ByteVector();
+
+   const long iLength = (long) std::min<TagLib::ulong>(length, Size_ - Position_);
+   const long iStart = Position_;
+   Position_ += iLength;
+   return TagLib::ByteVector(Data_ + iStart, iLength);
+}
+
+void mapped_stream::writeBlock(const TagLib::ByteVector& data)
+{
+}
+
+void mapped_stream::insert(const TagLib::ByteVector& data, TagLib::ulong start, TagLib::ulong replace)
+{
+}
+
+void mapped_stream::removeBlock(TagLib::ulong start, TagLib::ulong length)
+{
+}
+
+bool mapped_stream::readOnly() const
+{
+   return true;
+}
+
+bool mapped_stream::isOpen() const
+{
+   return Data_ != nullptr;
+}
+
+void mapped_stream::seek(long offset, Position p)
+{
+   switch (p)
+   {
+      case Beginning:
+         Position_ = offset;
+         break;
+      case Current:
+         Position_ += offset;
+         break;
+      case End:
+         Position_ = Size_ + offset;
+         break;
+   }
+
+   if (Position_ < 0)
+      Position_ = 0;
+}
+
+void mapped_stream::clear()
+{
+}
+
+long mapped_stream::tell() const
+{
+   return Position_;
+}
+
+long mapped_stream::length()
+{
+   return Size_;
+}
+
+void mapped_stream::truncate(long length)
+{
+}
+
+#ifdef _WIN32
+
+static bool IsNetworkFile(const std::wstring& sFileName)
+{
+   // UNC path, but not a \\?\ long local one
+   if (sFileName.compare(0, 2, L"\\\\") == 0)
+      return sFileName.compare(0, 4, L"\\\\?\\") != 0 || sFileName.compare(0, 8, L"\\\\?\\UNC\\") == 0;
+
+   if (sFileName.size() < 2 || L':' != sFileName[1])
+      return false;
+
+   const wchar_t szRoot[] = { sFileName[0], L':', L'\\', 0 };
+   return DRIVE_REMOTE == GetDriveTypeW(szRoot);
+}
+
+#else
+
+static bool IsNetworkFile(const std::wstring& sFileName)
+{
+   // magic numbers of NFS, SMB, CIFS and SMB2 from linux/magic.h
+   struct statfs data;
+   if (statfs(utils::GetNativePath(sFileName).c_str(), &data) != 0)
+      return false;
+
+   switch ((unsigned long) data.f_type)
+   {
+      case 0x6969:
+      case 0x517B:
+      case 0xFF534D42:
+      case 0xFE534D42:
+         return true;
+      default:
+         return false;
+   }
+}
+
+#endif
+
+TagLib::IOStream* OpenReadStream(const std::wstring& sFileName, const read_windows& windows, const bool bMap)
+{
+   // a mapping of a network file does not save round trips to the server,
+   // and a network error would be raised as an exception while reading it
+   if (bMap && !IsNetworkFile(sFileName))
+   {
+      std::unique_ptr<mapped_stream> stream(new mapped_stream(sFileName, MaxMappedSize));
+      if (stream->isOpen())
+         return stream.release();
+   }
+
+   TagLib::IOStream* pStream = new TagLib::FileStream(utils::GetNativePath(sFileName).c_str(), true);
+   if ((windows.m_Head || windows.m_Tail) && HasTagsAtEnds(GetFormatByExtension(sFileName)))
+      return new windowed_stream(pStream, windows);
+   return pStream;
+}
+
+}
@@ -0,0 +1,207 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <tiostream.h>
+#include "compat.h"
+#include "cancel.h"
+#include "utils.h"
+
+namespace wdx
+{
+
+/// forwards all calls to the wrapped stream, base for streams which
+/// intercept some of them
+class stream_wrapper: public TagLib::IOStream
+{
+public:
+   explicit stream_wrapper(TagLib::IOStream* pStream);
+   virtual ~stream_wrapper();
+
+   TagLib::FileName name() const;
+   TagLib::ByteVector readBlock(TagLib::ulong length);
+   void writeBlock(const TagLib::ByteVector& data);
+   void insert(const TagLib::ByteVector& data, TagLib::ulong start = 0, TagLib::ulong replace = 0);
+   void removeBlock(TagLib::ulong start = 0, TagLib::ulong length = 0);
+   bool readOnly() const;
+   bool isOpen() const;
+   void seek(long offset, Position p = Beginning);
+   void clear();
+   long tell() const;
+   long length();
+   void truncate(long length);
+
+protected:
+   std::unique_ptr<TagLib::IOStream> Stream_;
+};
+
+/// stream which fails all reads once its token is signalled, so TagLib
+/// gives up parsing as soon as possible
+class cancellable_stream: public stream_wrapper
+{
+public:
+   cancellable_stream(TagLib::IOStream* pStream, const cancel_token& token);
+
+   TagLib::ByteVector readBlock(TagLib::ulong length);
+   void seek(long offset, Position p = Beginning);
+
+private:
+   const cancel_token& Token_;
+};
+
+/// counts data read from the stream
+class read_tracking_stream: public stream_wrapper
+{
+public:
+   explicit read_tracking_stream(TagLib::IOStream* pStream);
+
+   TagLib::ByteVector readBlock(TagLib::ulong length);
+
+   unsigned long long GetBytesRead() const
+   {
+      return BytesRead_;
+   }
+
+private:
+   unsigned long long BytesRead_;
+};
+
+/// counts data written to the stream; an insert or removal in the middle
+/// of the stream moves everything after it, which means the file is rewritten
+class write_tracking_stream: public stream_wrapper
+{
+public:
+   explicit write_tracking_stream(TagLib::IOStream* pStream);
+
+   void writeBlock(const TagLib::ByteVector& data);
+   void insert(const TagLib::ByteVector& data, TagLib::ulong start = 0, TagLib::ulong replace = 0);
+   void removeBlock(TagLib::ulong start = 0, TagLib::ulong length = 0);
+
+   unsigned long long GetBytesWritten() const
+   {
+      return BytesWritten_;
+   }
+
+   /// bytes moved to another position because of size changes
+   unsigned long long GetBytesMoved() const
+   {
+      return BytesMoved_;
+   }
+
+private:
+   unsigned long long BytesWritten_;
+   unsigned long long BytesMoved_;
+};
+
+/// read-only stream over a memory mapping of the whole file, serves
+/// TagLib's many small reads without system calls
+class mapped_stream: public TagLib::IOStream
+{
+public:
+   /// maps file if its size does not exceed the limit, check isOpen() then
+   mapped_stream(const std::wstring& sFileName, const unsigned long long iMaxSize);
+   ~mapped_stream();
+
+   TagLib::FileName name() const;
+   TagLib::ByteVector readBlock(TagLib::ulong length);
+   void writeBlock(const TagLib::ByteVector& data);
+   void insert(const TagLib::ByteVector& data, TagLib::ulong start = 0, TagLib::ulong replace = 0);
+   void removeBlock(TagLib::ulong start = 0, TagLib::ulong length = 0);
+   bool readOnly() const;
+   bool isOpen() const;
+   void seek(long offset, Position p = Beginning);
+   void clear();
+   long tell() const;
+   long length();
+   void truncate(long length);
+
+private:
+   mapped_stream(const mapped_stream&);
+   mapped_stream& operator=(const mapped_stream&);
+
+   utils::native_path_t FileName_;
+#ifdef _WIN32
+   HANDLE File_;
+   HANDLE Mapping_;
+#else
+   int File_;
+#endif
+   const char* Data_;
+   long Size_;
+   long Position_;
+};
+
+/// sizes of the reads which fetch both ends of a file
+struct read_windows
+{
+   unsigned int m_Head; // bytes after the tag in front of the file, if any
+   unsigned int m_Tail; // bytes
+
+   read_windows(const unsigned int iHead, const unsigned int iTail) :
+         m_Head(iHead), m_Tail(iTail)
+   {
+   }
+};
+
+/// serves reads near the start and the end of the file from two buffers,
+/// each filled by one read of the wrapped stream on the first read. TagLib
+/// finds ID3v2 in front and ID3v1 and APE tags at the end with many small
+/// reads, each a round trip to a file server. A window grows once when the
+/// tag header in it tells the tag does not fit, unless the told size does
+/// not fit the file or is over 16 MB. Other reads are passed on.
+class windowed_stream: public stream_wrapper
+{
+public:
+   windowed_stream(TagLib::IOStream* pStream, const read_windows& windows);
+
+   TagLib::ByteVector readBlock(TagLib::ulong length);
+   void writeBlock(const TagLib::ByteVector& data);
+   void insert(const TagLib::ByteVector& data, TagLib::ulong start = 0, TagLib::ulong replace = 0);
+   void removeBlock(TagLib::ulong start = 0, TagLib::ulong length = 0);
+   void seek(long offset, Position p = Beginning);
+   long tell() const;
+   long length();
+   void truncate(long length);
+
+private:
+   void Load();
+   long GetHeadTagEnd() const;
+   long GetTailTagStart() const;
+   const char* GetTail(const long iOffset, const long iSize) const;
+   void Reset();
+
+   const read_windows Windows_;
+   std::vector<char> Head_; // bytes from the start of the file
+   std::vector<char> Tail_; // bytes up to the end of the file
+   long TailStart_;
+   long Length_; // -1 until it is asked
+   long Position_;
+   bool Loaded_;
+};
+
+/// opens file for reading with the fastest stream available for it: memory
+/// mapping for local files, buffered reads for files on network shares,
+/// for files too big to be mapped and if bMap is false. Files which are not
+/// mapped are read through windows of the given sizes if their format has
+/// tags at both ends.
+TagLib::IOStream* OpenReadStream(const std::wstring& sFileName, const read_windows& windows,
+      const bool bMap = true);
+}
@@ -0,0 +1,181 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "sync.h"
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define WDX_SYNC_SIMD
+#include <immintrin.h>
+#endif
+
+namespace wdx
+{
+
+/// 0xFFE sync, version other than reserved 01, layer other than reserved 00,
+/// bitrate other than free 0000 and bad 1111, sample rate other than reserved 11
+static bool IsFrameHeader(const unsigned char* p)
+{
+   return 0xFF == p[0] && 0xE0 == (p[1] & 0xE0) && 0x08 != (p[1] & 0x18) && 0 != (p[1] & 0x06)
+         && 0xF0 != (p[2] & 0xF0) && 0 != (p[2] & 0xF0) && 0x0C != (p[2] & 0x0C);
+}
+
+static long FindScalar(const unsigned char* p, const long iBegin, const long iSize)
+{
+   for (long i = iBegin; i + 3 < iSize; ++i)
+   {
+      if (IsFrameHeader(p + i))
+         return i;
+   }
+   return -1;
+}
+
+static long FindFrameHeaderScalar(const unsigned char* p, const long iSize)
+{
+   return FindScalar(p, 0, iSize);
+}
+
+#ifdef WDX_SYNC_SIMD
+
+// each lane tests the header starting at its byte, the three bytes are loaded at offsets 0, 1 and 2
+__attribute__((target("sse2")))
+static long FindFrameHeaderSSE2(const unsigned char* p, const long iSize)
+{
+   const __m128i zero = _mm_setzero_si128();
+   const __m128i xFF = _mm_set1_epi8((char) 0xFF);
+   const __m128i xE0 = _mm_set1_epi8((char) 0xE0);
+   const __m128i x18 = _mm_set1_epi8(0x18);
+   const __m128i x08 = _mm_set1_epi8(0x08);
+   const __m128i x06 = _mm_set1_epi8(0x06);
+   const __m128i xF0 = _mm_set1_epi8((char) 0xF0);
+   const __m128i x0C = _mm_set1_epi8(0x0C);
+
+   long i = 0;
+   for (; i + 19 <= iSize; i += 16)
+   {
+      const __m128i b0 = _mm_loadu_si128((const __m128i*) (p + i));
+      // most blocks have no 0xFF at all
+      const __m128i sync = _mm_cmpeq_epi8(b0, xFF);
+      if (0 == _mm_movemask_epi8(sync))
+         continue;
+
+      const __m128i b1 = _mm_loadu_si128((const __m128i*) (p + i + 1));
+      const __m128i b2 = _mm_loadu_si128((const __m128i*) (p + i + 2));
+      const __m128i bitrate = _mm_and_si128(b2, xF0);
+      __m128i valid = _mm_and_si128(sync, _mm_cmpeq_epi8(_mm_and_si128(b1, xE0), xE0));
+      valid = _mm_andnot_si128(_mm_cmpeq_epi8(_mm_and_si128(b1, x18), x08), valid);
+      valid = _mm_andnot_si128(_mm_cmpeq_epi8(_mm_and_si128(b1, x06), zero), valid);
+      valid = _mm_andnot_si128(_mm_cmpeq_epi8(bitrate, xF0), valid);
+      valid = _mm_andnot_si128(_mm_cmpeq_epi8(bitrate, zero), valid);
+      valid = _mm_andnot_si128(_mm_cmpeq_epi8(_mm_and_si128(b2, x0C), x0C), valid);
+
+      const int iMask = _mm_movemask_epi8(valid);
+      if (iMask)
+         return i + __builtin_ctz(iMask);
+   }
+   return FindScalar(p, i, iSize);
+}
+
+__attribute__((target("avx2")))
+static long FindFrameHeaderAVX2(const unsigned char* p, const long iSize)
+{
+   const __m256i zero = _mm256_setzero_si256();
+   const __m256i xFF = _mm256_set1_epi8((char) 0xFF);
+   const __m256i xE0 = _mm256_set1_epi8((char) 0xE0);
+   const __m256i x18 = _mm256_set1_epi8(0x18);
+   const __m256i x08 = _mm256_set1_epi8(0x08);
+   const __m256i x06 = _mm256_set1_epi8(0x06);
+   const __m256i xF0 = _mm256_set1_epi8((char) 0xF0);
+   const __m256i x0C = _mm256_set1_epi8(0x0C);
+
+   long i = 0;
+   for (; i + 35 <= iSize; i += 32)
+   {
+      const __m256i b0 = _mm256_loadu_si256((const __m256i*) (p + i));
+      const __m256i sync = _mm256_cmpeq_epi8(b0, xFF);
+      if (0 == _mm256_movemask_epi8(sync))
+         continue;
+
+      const __m256i b1 = _mm256_loadu_si256((const __m256i*) (p + i + 1));
+      const __m256i b2 = _mm256_loadu_si256((const __m256i*) (p + i + 2));
+      const __m256i bitrate = _mm256_and_si256(b2, xF0);
+      __m256i valid = _mm256_and_si256(sync, _mm256_cmpeq_epi8(_mm256_and_si256(b1, xE0), xE0));
+      valid = _mm256_andnot_si256(_mm256_cmpeq_epi8(_mm256_and_si256(b1, x18), x08), valid);
+      valid = _mm256_andnot_si256(_mm256_cmpeq_epi8(_mm256_and_si256(b1, x06), zero), valid);
+      valid = _mm256_andnot_si256(_mm256_cmpeq_epi8(bitrate, xF0), valid);
+      valid = _mm256_andnot_si256(_mm256_cmpeq_epi8(bitrate, zero), valid);
+      valid = _mm256_andnot_si256(_mm256_cmpeq_epi8(_mm256_and_si256(b2, x0C), x0C), valid);
+
+      const unsigned int iMask = (unsigned int) _mm256_movemask_epi8(valid);
+      if (iMask)
+         return i + __builtin_ctz(iMask);
+   }
+   return FindScalar(p, i, iSize);
+}
+
+#endif
+
+typedef long (*find_t)(const unsigned char* p, const long iSize);
+
+/// the widest version the processor supports
+static find_t SelectFind()
+{
+#ifdef WDX_SYNC_SIMD
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("avx2"))
+      return &FindFrameHeaderAVX2;
+   if (__builtin_cpu_supports("sse2"))
+      return &FindFrameHeaderSSE2;
+#endif
+   return &FindFrameHeaderScalar;
+}
+
+long FindFrameHeader(const unsigned char* p, const long iSize)
+{
+   static const find_t find = SelectFind();
+   return find(p, iSize);
+}
+
+bool FindFrameHeader(const unsigned char* p, const long iSize, const sync_version_t version, long& iOffset)
+{
+   find_t find = nullptr;
+   switch (version)
+   {
+      case syncScalar:
+         find = &FindFrameHeaderScalar;
+         break;
+#ifdef WDX_SYNC_SIMD
+      case syncSSE2:
+         __builtin_cpu_init();
+         if (__builtin_cpu_supports("sse2"))
+            find = &FindFrameHeaderSSE2;
+         break;
+      case syncAVX2:
+         __builtin_cpu_init();
+         if (__builtin_cpu_supports("avx2"))
+            find = &FindFrameHeaderAVX2;
+         break;
+#endif
+      default:
+         break;
+   }
+
+   if (!find)
+      return false;
+   iOffset = find(p, iSize);
+   return true;
+}
+}
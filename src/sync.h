@@ -0,0 +1,40 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+namespace wdx
+{
+
+/// offset of the first MPEG audio frame header candidate in the buffer: sync
+/// word, valid version, layer, bitrate and sample rate. A candidate is whole
+/// in the buffer, so the last three bytes are never returned; -1 if there is
+/// none. Uses AVX2 or SSE2 when the processor has them.
+long FindFrameHeader(const unsigned char* p, const long iSize);
+
+/// versions of the search
+enum sync_version_t
+{
+   syncScalar,
+   syncSSE2,
+   syncAVX2,
+};
+
+/// the search with the given version, for benchmarks which compare them;
+/// false if the build or the processor does not have it
+bool FindFrameHeader(const unsigned char* p, const long iSize, const sync_version_t version, long& iOffset);
+}
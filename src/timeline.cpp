@@ -0,0 +1,257 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "timeline.h"
+
+namespace wdx
+{
+
+/// appends string as JSON string literal in UTF-8
+static void AppendJson(std::string& sOut, const wchar_t* pszText)
+{
+   sOut += '"';
+   for (const wchar_t* p = pszText; *p; ++p)
+   {
+      unsigned long c = (unsigned long) *p;
+      // UTF-16 surrogate pair
+      if (c >= 0xD800 && c < 0xDC00 && p[1] >= 0xDC00 && p[1] < 0xE000)
+      {
+         c = 0x10000 + ((c - 0xD800) << 10) + ((unsigned long) p[1] - 0xDC00);
+         ++p;
+      }
+
+      if ('"' == c || '\\' == c)
+      {
+         sOut += '\\';
+         sOut += (char) c;
+      }
+      else if (c < 0x20)
+      {
+         char buf[8];
+         snprintf(buf, sizeof(buf), "\\u%04x", (unsigned int) c);
+         sOut += buf;
+      }
+      else if (c < 0x80)
+         sOut += (char) c;
+      else if (c < 0x800)
+      {
+         sOut += (char) (0xC0 | (c >> 6));
+         sOut += (char) (0x80 | (c & 0x3F));
+      }
+      else if (c < 0x10000)
+      {
+         sOut += (char) (0xE0 | (c >> 12));
+         sOut += (char) (0x80 | ((c >> 6) & 0x3F));
+         sOut += (char) (0x80 | (c & 0x3F));
+      }
+      else
+      {
+         sOut += (char) (0xF0 | (c >> 18));
+         sOut += (char) (0x80 | ((c >> 12) & 0x3F));
+         sOut += (char) (0x80 | ((c >> 6) & 0x3F));
+         sOut += (char) (0x80 | (c & 0x3F));
+      }
+   }
+   sOut += '"';
+}
+
+static void AppendJson(std::string& sOut, const char* pszText)
+{
+   sOut += '"';
+   for (const char* p = pszText; *p; ++p)
+   {
+      if ('"' == *p || '\\' == *p)
+         sOut += '\\';
+      sOut += *p;
+   }
+   sOut += '"';
+}
+
+timeline::timeline() :
+      Open_(false), Generation_(0), File_(nullptr), Empty_(true)
+{
+}
+
+timeline::~timeline()
+{
+   Close();
+}
+
+void timeline::Open(const std::string& sFileName)
+{
+   Close();
+
+   if (sFileName.empty())
+      return;
+
+   std::lock_guard<std::mutex> lock(Mutex_);
+
+   File_ = std::fopen(sFileName.c_str(), "wb");
+   if (!File_)
+      return;
+
+   // JSON array format, viewers accept it without the closing bracket
+   // if the process ends before Close
+   std::fputs("[\n", File_);
+   Empty_ = true;
+   Start_ = std::chrono::steady_clock::now();
+   ++Generation_;
+   Open_ = true;
+}
+
+void timeline::Close()
+{
+   std::lock_guard<std::mutex> lock(Mutex_);
+
+   if (!File_)
+      return;
+
+   Open_ = false;
+   for (const std::unique_ptr<thread_buffer>& buffer : Buffers_)
+      Write(*buffer);
+
+   std::fputs("\n]\n", File_);
+   std::fclose(File_);
+   File_ = nullptr;
+}
+
+unsigned long long timeline::GetTime() const
+{
+   return (unsigned long long) std::chrono::duration_cast<std::chrono::nanoseconds>(
+         std::chrono::steady_clock::now() - Start_).count();
+}
+
+timeline::thread_buffer& timeline::GetBuffer()
+{
+   static thread_local timeline* pOwner = nullptr;
+   static thread_local thread_buffer* pBuffer = nullptr;
+
+   if (pOwner != this)
+   {
+      std::lock_guard<std::mutex> lock(Mutex_);
+      Buffers_.push_back(std::unique_ptr<thread_buffer>(new thread_buffer()));
+      pBuffer = Buffers_.back().get();
+      pBuffer->m_Thread = (unsigned int) Buffers_.size();
+      pBuffer->m_Count = 0;
+      pBuffer->m_Written = 0;
+      pOwner = this;
+   }
+   return *pBuffer;
+}
+
+void timeline::Add(const char* pszName, const char* pszCategory, const unsigned long long iStart,
+      const unsigned long long iEnd, const wchar_t* pszFileName)
+{
+   if (!IsOpen())
+      return;
+
+   thread_buffer& buffer = GetBuffer();
+   size_t iCount = buffer.m_Count.load(std::memory_order_relaxed);
+   if (BufferSize == iCount)
+   {
+      std::lock_guard<std::mutex> lock(Mutex_);
+      Write(buffer);
+      buffer.m_Written = 0;
+      buffer.m_Count.store(0, std::memory_order_relaxed);
+      iCount = 0;
+   }
+
+   // the slot is not visible to Write until the count is published
+   event& e = buffer.m_Events[iCount];
+   e.m_Name = pszName;
+   e.m_Category = pszCategory;
+   e.m_Start = iStart;
+   e.m_End = iEnd;
+   if (pszFileName)
+      e.m_FileName = pszFileName;
+   else
+      e.m_FileName.clear();
+   e.m_Generation = Generation_.load(std::memory_order_relaxed);
+   buffer.m_Count.store(iCount + 1, std::memory_order_release);
+}
+
+void timeline::Write(thread_buffer& buffer)
+{
+   const size_t iCount = buffer.m_Count.load(std::memory_order_acquire);
+   if (!File_)
+   {
+      buffer.m_Written = iCount;
+      return;
+   }
+
+   const unsigned int iGeneration = Generation_.load(std::memory_order_relaxed);
+   std::string sOut;
+   char buf[128];
+   for (size_t i = buffer.m_Written; i < iCount; ++i)
+   {
+      const event& e = buffer.m_Events[i];
+      if (e.m_Generation != iGeneration)
+         continue;
+
+      sOut += Empty_ ? "{\"name\":" : ",\n{\"name\":";
+      Empty_ = false;
+      AppendJson(sOut, e.m_Name);
+      sOut += ",\"cat\":";
+      AppendJson(sOut, e.m_Category);
+      // times are in microseconds, formatted without floating point
+      const unsigned long long iDuration = e.m_End - e.m_Start;
+      snprintf(buf, sizeof(buf), ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%llu.%03u,\"dur\":%llu.%03u",
+            buffer.m_Thread, e.m_Start / 1000, (unsigned int) (e.m_Start % 1000), iDuration / 1000,
+            (unsigned int) (iDuration % 1000));
+      sOut += buf;
+      if (!e.m_FileName.empty())
+      {
+         sOut += ",\"args\":{\"file\":";
+         AppendJson(sOut, e.m_FileName.c_str());
+         sOut += '}';
+      }
+      sOut += '}';
+   }
+   buffer.m_Written = iCount;
+
+   std::fwrite(sOut.data(), 1, sOut.size(), File_);
+}
+
+timeline_span::timeline_span(timeline& owner, const char* pszName, const char* pszCategory,
+      const wchar_t* pszFileName) :
+      Owner_(owner), Active_(owner.IsOpen()), Name_(pszName), Category_(pszCategory), FileName_(pszFileName),
+            Start_(Active_ ? owner.GetTime() : 0)
+{
+}
+
+timeline_span::~timeline_span()
+{
+   Stop();
+}
+
+void timeline_span::Stop()
+{
+   if (!Active_)
+      return;
+
+   Active_ = false;
+
+   // timeline must not break the call it measures
+   try
+   {
+      Owner_.Add(Name_, Category_, Start_, Owner_.GetTime(), FileName_);
+   }
+   catch (...)
+   {
+   }
+}
+}
@@ -0,0 +1,117 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace wdx
+{
+
+/// writes spans of plugin work as Chrome trace-event JSON, which
+/// chrome://tracing and Perfetto show as per-thread timelines. Each thread
+/// collects its spans in a buffer of its own without locking, only full
+/// buffers are written to the file under a lock.
+class timeline
+{
+public:
+   timeline();
+   ~timeline();
+
+   /// starts a new timeline, empty file name stops it
+   void Open(const std::string& sFileName);
+   void Close();
+
+   bool IsOpen() const
+   {
+      return Open_.load(std::memory_order_relaxed);
+   }
+
+   /// nanoseconds since the timeline was opened
+   unsigned long long GetTime() const;
+
+   /// adds span of the calling thread, name and category must be constant strings
+   void Add(const char* pszName, const char* pszCategory, const unsigned long long iStart,
+         const unsigned long long iEnd, const wchar_t* pszFileName);
+
+private:
+   timeline(const timeline&);
+   timeline& operator=(const timeline&);
+
+   struct event
+   {
+      const char* m_Name;
+      const char* m_Category;
+      unsigned long long m_Start;
+      unsigned long long m_End;
+      std::wstring m_FileName;
+      unsigned int m_Generation; // events of a previous timeline are dropped
+   };
+
+   static const size_t BufferSize = 1024;
+
+   struct thread_buffer
+   {
+      unsigned int m_Thread;
+      // only the owning thread adds events and resets the count, under Mutex_
+      std::atomic<size_t> m_Count;
+      // events before it are written already, changed under Mutex_
+      size_t m_Written;
+      event m_Events[BufferSize];
+   };
+
+   thread_buffer& GetBuffer();
+   void Write(thread_buffer& buffer);
+
+   std::mutex Mutex_;
+   std::atomic<bool> Open_;
+   std::atomic<unsigned int> Generation_;
+   std::FILE* File_;
+   std::chrono::steady_clock::time_point Start_;
+   bool Empty_; // no event was written to the file yet
+   // buffers live as long as the timeline, threads keep pointers to them
+   std::vector<std::unique_ptr<thread_buffer> > Buffers_;
+};
+
+/// adds span from its construction to its destruction, or to Stop, if the
+/// timeline is open
+class timeline_span
+{
+public:
+   timeline_span(timeline& owner, const char* pszName, const char* pszCategory, const wchar_t* pszFileName = nullptr);
+   ~timeline_span();
+
+   void Stop();
+
+private:
+   timeline_span(const timeline_span&);
+   timeline_span& operator=(const timeline_span&);
+
+   timeline& Owner_;
+   bool Active_;
+   const char* Name_;
+   const char* Category_;
+   const wchar_t* FileName_;
+   unsigned long long Start_;
+};
+}
@@ -0,0 +1,384 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cstring>
+#include <cwchar>
+#include <fstream>
+#include <iterator>
+#include "compat.h"
+#include "contentplug.h"
+#include "serial.h"
+#include "trace.h"
+
+namespace wdx
+{
+
+static const char TraceMagic[8] = { 'W', 'D', 'X', 'T', 'R', 'A', 'C', 'E' };
+static const unsigned int TraceFormatVersion = 1;
+
+// defines a file name number used by the records after it
+static const unsigned char NameRecord = 0;
+
+// buffered records are written when there are enough of them or they are old
+static const size_t FlushSize = 64 * 1024;
+static const unsigned long long FlushInterval = 1000000;
+
+static bool IsStringType(const int iFieldType)
+{
+   return ft_string == iFieldType || ft_multiplechoice == iFieldType || ft_fulltext == iFieldType;
+}
+
+/// size of a value of a fixed size field type
+static size_t GetValueSize(const int iFieldType)
+{
+   switch (iFieldType)
+   {
+      case ft_numeric_32:
+      case ft_boolean:
+         return 4;
+      case ft_numeric_64:
+      case ft_numeric_floating:
+      case ft_datetime:
+         return 8;
+      case ft_date:
+      case ft_time:
+         return 6;
+      default:
+         return 0;
+   }
+}
+
+trace_writer::trace_writer() :
+      Open_(false), File_(nullptr), LastFlush_(0)
+{
+}
+
+trace_writer::~trace_writer()
+{
+   Close();
+}
+
+void trace_writer::Open(const std::string& sFileName)
+{
+   Close();
+
+   if (sFileName.empty())
+      return;
+
+   std::lock_guard<std::mutex> lock(Mutex_);
+
+   File_ = std::fopen(sFileName.c_str(), "wb");
+   if (!File_)
+      return;
+
+   Buffer_.assign(TraceMagic, TraceMagic + sizeof(TraceMagic));
+   serial_writer(Buffer_).U32(TraceFormatVersion);
+   Start_ = std::chrono::steady_clock::now();
+   LastFlush_ = 0;
+   Open_ = true;
+}
+
+void trace_writer::Close()
+{
+   std::lock_guard<std::mutex> lock(Mutex_);
+
+   if (!File_)
+      return;
+
+   Open_ = false;
+   Flush();
+   std::fclose(File_);
+   File_ = nullptr;
+   Names_.clear();
+   Threads_.clear();
+}
+
+unsigned long long trace_writer::GetTime() const
+{
+   return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - Start_).count();
+}
+
+void trace_writer::Write(trace_record& record)
+{
+   std::lock_guard<std::mutex> lock(Mutex_);
+
+   if (!File_)
+      return;
+
+   serial_writer writer(Buffer_);
+
+   const unsigned int iName = GetNameId(writer, record.m_FileName);
+   const unsigned int iName2 = GetNameId(writer, record.m_FileName2);
+
+   record.m_Thread = Threads_.insert(std::make_pair(std::this_thread::get_id(), (unsigned int) Threads_.size()))
+         .first->second;
+
+   writer.U8((unsigned char) record.m_Call);
+   writer.U32(record.m_Thread);
+   writer.U64(record.m_Time);
+   writer.U32(record.m_Duration);
+
+   switch (record.m_Call)
+   {
+      case callGetSupportedField:
+      case callGetDefaultSortOrder:
+      case callGetSupportedFieldFlags:
+         writer.I32(record.m_FieldIndex);
+         writer.I32(record.m_Result);
+         break;
+      case callGetValue:
+         writer.U32(iName);
+         writer.I32(record.m_FieldIndex);
+         writer.I32(record.m_UnitIndex);
+         writer.I32(record.m_MaxLen);
+         writer.I32(record.m_Flags);
+         writer.I32(record.m_Result);
+         break;
+      case callSetValue:
+         writer.U32(iName);
+         writer.I32(record.m_FieldIndex);
+         writer.I32(record.m_UnitIndex);
+         writer.I32(record.m_FieldType);
+         writer.I32(record.m_Flags);
+         if (ft_stringw == record.m_FieldType && !record.m_Value.empty())
+            writer.WString((const wchar_t*) &record.m_Value[0]);
+         else
+            writer.String(std::string(record.m_Value.begin(), record.m_Value.end()));
+         writer.I32(record.m_Result);
+         break;
+      case callEndOfSetValue:
+         writer.I32(record.m_Result);
+         break;
+      case callStopGetValue:
+         writer.U32(iName);
+         break;
+      case callSendStateInformation:
+         writer.I32(record.m_FieldIndex);
+         writer.U32(iName);
+         break;
+      case callCompareFiles:
+         writer.U32(iName);
+         writer.U32(iName2);
+         writer.I32(record.m_FieldIndex);
+         writer.I32(record.m_Result);
+         break;
+      default:
+         break;
+   }
+
+   // edits are flushed at once, TC may be closed right after them
+   const unsigned long long iNow = GetTime();
+   if (Buffer_.size() >= FlushSize || iNow - LastFlush_ >= FlushInterval || callEndOfSetValue == record.m_Call)
+   {
+      Flush();
+      LastFlush_ = iNow;
+   }
+}
+
+/// number of the file name, its record is written before the first use
+unsigned int trace_writer::GetNameId(serial_writer& writer, const std::wstring& sFileName)
+{
+   if (sFileName.empty())
+      return 0;
+
+   std::unordered_map<std::wstring, unsigned int>::const_iterator iter = Names_.find(sFileName);
+   if (Names_.end() != iter)
+      return iter->second;
+
+   const unsigned int iName = (unsigned int) Names_.size() + 1;
+   Names_[sFileName] = iName;
+   writer.U8(NameRecord);
+   writer.U32(iName);
+   writer.WString(sFileName);
+   return iName;
+}
+
+void trace_writer::Flush()
+{
+   if (!Buffer_.empty())
+      std::fwrite(&Buffer_[0], 1, Buffer_.size(), File_);
+   std::fflush(File_);
+   Buffer_.clear();
+}
+
+trace_reader::trace_reader() :
+      Position_(0)
+{
+}
+
+trace_reader::~trace_reader()
+{
+}
+
+bool trace_reader::Open(const std::string& sFileName)
+{
+   std::ifstream file(sFileName.c_str(), std::ios::binary);
+   Data_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+   Names_.assign(1, std::wstring());
+
+   unsigned int iVersion = 0;
+   serial_reader reader(Data_.data() + sizeof(TraceMagic), Data_.size() - std::min(Data_.size(), sizeof(TraceMagic)));
+   if (Data_.size() < sizeof(TraceMagic) || std::memcmp(&Data_[0], TraceMagic, sizeof(TraceMagic)) != 0
+         || !reader.U32(iVersion) || TraceFormatVersion != iVersion)
+      return false;
+
+   Position_ = sizeof(TraceMagic) + 4;
+   return true;
+}
+
+bool trace_reader::Read(trace_record& record)
+{
+   serial_reader reader(Data_.data() + Position_, Data_.size() - Position_);
+   record = trace_record();
+
+   unsigned char iCall = 0;
+   if (!reader.U8(iCall))
+      return false;
+
+   while (NameRecord == iCall)
+   {
+      unsigned int iName = 0;
+      std::wstring sName;
+      if (!reader.U32(iName) || !reader.WString(sName) || Names_.size() != iName || !reader.U8(iCall))
+         return false;
+      Names_.push_back(sName);
+   }
+
+   record.m_Call = iCall;
+   if (!reader.U32(record.m_Thread) || !reader.U64(record.m_Time) || !reader.U32(record.m_Duration))
+      return false;
+
+   unsigned int iName = 0;
+   unsigned int iName2 = 0;
+   bool bOk = true;
+   switch (iCall)
+   {
+      case callGetSupportedField:
+      case callGetDefaultSortOrder:
+      case callGetSupportedFieldFlags:
+         bOk = reader.I32(record.m_FieldIndex) && reader.I32(record.m_Result);
+         break;
+      case callGetValue:
+         bOk = reader.U32(iName) && reader.I32(record.m_FieldIndex) && reader.I32(record.m_UnitIndex)
+               && reader.I32(record.m_MaxLen) && reader.I32(record.m_Flags) && reader.I32(record.m_Result);
+         break;
+      case callSetValue:
+         {
+         bOk = reader.U32(iName) && reader.I32(record.m_FieldIndex) && reader.I32(record.m_UnitIndex)
+               && reader.I32(record.m_FieldType) && reader.I32(record.m_Flags);
+         if (bOk && ft_stringw == record.m_FieldType)
+         {
+            std::wstring sValue;
+            bOk = reader.WString(sValue);
+            const char* pValue = (const char*) sValue.c_str();
+            record.m_Value.assign(pValue, pValue + (sValue.size() + 1) * sizeof(wchar_t));
+         }
+         else if (bOk)
+         {
+            std::string sValue;
+            bOk = reader.String(sValue);
+            record.m_Value.assign(sValue.begin(), sValue.end());
+         }
+         bOk = bOk && reader.I32(record.m_Result);
+         break;
+      }
+      case callEndOfSetValue:
+         bOk = reader.I32(record.m_Result);
+         break;
+      case callStopGetValue:
+         bOk = reader.U32(iName);
+         break;
+      case callSendStateInformation:
+         bOk = reader.I32(record.m_FieldIndex) && reader.U32(iName);
+         break;
+      case callCompareFiles:
+         bOk = reader.U32(iName) && reader.U32(iName2) && reader.I32(record.m_FieldIndex)
+               && reader.I32(record.m_Result);
+         break;
+      case callPluginUnloading:
+         break;
+      default:
+         return false;
+   }
+
+   if (!bOk || iName >= Names_.size() || iName2 >= Names_.size())
+      return false;
+
+   record.m_FileName = Names_[iName];
+   record.m_FileName2 = Names_[iName2];
+   Position_ = Data_.size() - reader.Left();
+   return true;
+}
+
+trace_scope::trace_scope(trace_writer& writer, const trace_call_t call, const wchar_t* pszFileName,
+      const int iFieldIndex, const int iUnitIndex, const int iFlags) :
+      Writer_(writer), Active_(writer.IsOpen())
+{
+   if (!Active_)
+      return;
+
+   Record_.m_Call = call;
+   Record_.m_Time = Writer_.GetTime();
+   if (pszFileName)
+      Record_.m_FileName = pszFileName;
+   Record_.m_FieldIndex = iFieldIndex;
+   Record_.m_UnitIndex = iUnitIndex;
+   Record_.m_Flags = iFlags;
+}
+
+trace_scope::~trace_scope()
+{
+   if (!Active_)
+      return;
+
+   try
+   {
+      Record_.m_Duration = (unsigned int) (Writer_.GetTime() - Record_.m_Time);
+      Writer_.Write(Record_);
+   }
+   catch (...)
+   {
+      // tracing must never break the call it records
+   }
+}
+
+void trace_scope::SetValue(const int iFieldType, const void* pFieldValue)
+{
+   if (!Active_)
+      return;
+
+   Record_.m_FieldType = iFieldType;
+   if (!pFieldValue)
+      return;
+
+   const char* pValue = (const char*) pFieldValue;
+   size_t iSize = GetValueSize(iFieldType);
+   if (ft_stringw == iFieldType)
+      iSize = (wcslen((const wchar_t*) pFieldValue) + 1) * sizeof(wchar_t);
+   else if (IsStringType(iFieldType))
+      iSize = std::strlen(pValue) + 1;
+
+   Record_.m_Value.assign(pValue, pValue + iSize);
+}
+
+void trace_scope::SetFileName2(const wchar_t* pszFileName)
+{
+   if (Active_ && pszFileName)
+      Record_.m_FileName2 = pszFileName;
+}
+}
@@ -0,0 +1,166 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "serial.h"
+
+namespace wdx
+{
+
+/// plugin interface calls which are recorded to a trace
+enum trace_call_t
+{
+   callGetSupportedField = 1,
+   callGetValue,
+   callSetValue,
+   callEndOfSetValue,
+   callStopGetValue,
+   callSendStateInformation,
+   callPluginUnloading,
+   callGetDefaultSortOrder,
+   callGetSupportedFieldFlags,
+   callCompareFiles,
+};
+
+/// one call made by TC, with the result and the time the plugin took for it
+struct trace_record
+{
+   int m_Call;
+   unsigned int m_Thread; // calling threads are numbered in order of their first call
+   unsigned long long m_Time; // microseconds since the trace was opened
+   unsigned int m_Duration; // microseconds
+   std::wstring m_FileName; // file or directory path
+   std::wstring m_FileName2; // second file for callCompareFiles
+   int m_FieldIndex; // state for callSendStateInformation, compare index for callCompareFiles
+   int m_UnitIndex;
+   int m_FieldType;
+   int m_MaxLen;
+   int m_Flags;
+   int m_Result;
+   std::vector<char> m_Value; // value passed to SetValue in its native layout
+
+   trace_record() :
+         m_Call(0), m_Thread(0), m_Time(0), m_Duration(0), m_FieldIndex(0), m_UnitIndex(0), m_FieldType(0),
+               m_MaxLen(0), m_Flags(0), m_Result(0)
+   {
+   }
+};
+
+/// appends records to a trace file. File names are written once and then
+/// referred to by number, so a trace of a big directory stays small.
+class trace_writer
+{
+public:
+   trace_writer();
+   ~trace_writer();
+
+   /// starts a new trace, empty file name stops tracing
+   void Open(const std::string& sFileName);
+   void Close();
+
+   bool IsOpen() const
+   {
+      return Open_;
+   }
+
+   /// microseconds since the trace was opened
+   unsigned long long GetTime() const;
+
+   void Write(trace_record& record);
+
+private:
+   trace_writer(const trace_writer&);
+   trace_writer& operator=(const trace_writer&);
+
+   void Flush();
+   unsigned int GetNameId(serial_writer& writer, const std::wstring& sFileName);
+
+   std::mutex Mutex_;
+   std::atomic<bool> Open_;
+   std::FILE* File_;
+   std::chrono::steady_clock::time_point Start_;
+   unsigned long long LastFlush_;
+   std::vector<char> Buffer_;
+   std::unordered_map<std::wstring, unsigned int> Names_;
+   std::map<std::thread::id, unsigned int> Threads_;
+};
+
+/// reads records of a trace file in order
+class trace_reader
+{
+public:
+   trace_reader();
+   ~trace_reader();
+
+   bool Open(const std::string& sFileName);
+
+   /// false at the end of trace or on a damaged record
+   bool Read(trace_record& record);
+
+private:
+   trace_reader(const trace_reader&);
+   trace_reader& operator=(const trace_reader&);
+
+   std::vector<char> Data_;
+   size_t Position_;
+   std::vector<std::wstring> Names_;
+};
+
+/// records the call it lives through if tracing is on
+class trace_scope
+{
+public:
+   trace_scope(trace_writer& writer, const trace_call_t call, const wchar_t* pszFileName = nullptr,
+         const int iFieldIndex = 0, const int iUnitIndex = 0, const int iFlags = 0);
+   ~trace_scope();
+
+   void SetMaxLen(const int iMaxLen)
+   {
+      Record_.m_MaxLen = iMaxLen;
+   }
+
+   /// keeps a copy of the value passed to SetValue
+   void SetValue(const int iFieldType, const void* pFieldValue);
+
+   /// second file of CompareFiles
+   void SetFileName2(const wchar_t* pszFileName);
+
+   int Result(const int iResult)
+   {
+      Record_.m_Result = iResult;
+      return iResult;
+   }
+
+private:
+   trace_scope(const trace_scope&);
+   trace_scope& operator=(const trace_scope&);
+
+   trace_writer& Writer_;
+   const bool Active_;
+   trace_record Record_;
+};
+}
@@ -17,10 +17,18 @@
 
 #include <cstring>
 #include <cstdio>
+#include <cwctype>
 #include <sstream>
-#include <windows.h>
+#include "compat.h"
 #include "utils.h"
 
+#ifndef _WIN32
+#include <dirent.h>
+#include <fstream>
+#include <strings.h>
+#include <sys/stat.h>
+#endif
+
 namespace utils
 {
 
@@ -50,9 +58,262 @@ std::string Int2Str(const int num)
    return (os.str());
 }
 
+#ifdef _WIN32
+
 void ShowError(const std::string& sText, const std::string& sTitle, const HWND hWnd)
 {
    MessageBox(hWnd, sText.c_str(), sTitle.c_str(), MB_OK | MB_ICONERROR);
 }
 
+void ShowError(const std::wstring& sText, const std::wstring& sTitle, const HWND hWnd)
+{
+   MessageBoxW(hWnd, sText.c_str(), sTitle.c_str(), MB_OK | MB_ICONERROR);
+}
+
+native_path_t GetNativePath(const std::wstring& sFileName)
+{
+   return sFileName;
+}
+
+bool GetFileStamp(const std::wstring& sFileName, file_stamp& stamp)
+{
+   WIN32_FILE_ATTRIBUTE_DATA data;
+   if (!GetFileAttributesExW(sFileName.c_str(), GetFileExInfoStandard, &data))
+      return false;
+
+   stamp.m_Size = ((unsigned long long) data.nFileSizeHigh << 32) | data.nFileSizeLow;
+   stamp.m_Time = ((unsigned long long) data.ftLastWriteTime.dwHighDateTime << 32)
+         | data.ftLastWriteTime.dwLowDateTime;
+   return true;
+}
+
+void ListDirectory(const std::wstring& sPath, std::vector<std::wstring>& files)
+{
+   std::wstring sDir(sPath);
+   if (!sDir.empty() && L'\\' != sDir[sDir.size() - 1])
+      sDir += L'\\';
+
+   WIN32_FIND_DATAW data;
+   HANDLE hFind = FindFirstFileW((sDir + L"*").c_str(), &data);
+   if (INVALID_HANDLE_VALUE == hFind)
+      return;
+
+   do
+   {
+      if (!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+         files.push_back(sDir + data.cFileName);
+   } while (FindNextFileW(hFind, &data));
+
+   FindClose(hFind);
+}
+
+std::wstring GetVolumeName(const std::wstring& sFileName)
+{
+   // \\server\share\ for network paths
+   if (0 == sFileName.compare(0, 2, L"\\\\"))
+   {
+      const std::wstring::size_type iServerEnd = sFileName.find(L'\\', 2);
+      const std::wstring::size_type iShareEnd =
+            std::wstring::npos == iServerEnd ? std::wstring::npos : sFileName.find(L'\\', iServerEnd + 1);
+      return std::wstring::npos == iShareEnd ? sFileName : sFileName.substr(0, iShareEnd + 1);
+   }
+
+   if (sFileName.size() >= 2 && L':' == sFileName[1])
+      return std::wstring(1, (wchar_t) towupper(sFileName[0])) + L":\\";
+
+   return std::wstring();
+}
+
+int GetIniInt(const std::string& sIniName, const std::string& sSection, const std::string& sKey,
+      const int iDefault)
+{
+   if (sIniName.empty())
+      return iDefault;
+   return GetPrivateProfileIntA(sSection.c_str(), sKey.c_str(), iDefault, sIniName.c_str());
+}
+
+std::string GetIniString(const std::string& sIniName, const std::string& sSection, const std::string& sKey,
+      const std::string& sDefault)
+{
+   if (sIniName.empty())
+      return sDefault;
+
+   char szValue[MAX_PATH * 4];
+   GetPrivateProfileStringA(sSection.c_str(), sKey.c_str(), sDefault.c_str(), szValue, sizeof(szValue),
+         sIniName.c_str());
+   return szValue;
+}
+
+#else
+
+void ShowError(const std::string& sText, const std::string& sTitle, const HWND hWnd)
+{
+   std::fprintf(stderr, "%s: %s\n", sTitle.c_str(), sText.c_str());
+}
+
+void ShowError(const std::wstring& sText, const std::wstring& sTitle, const HWND hWnd)
+{
+   ShowError(GetNativePath(sText), GetNativePath(sTitle), hWnd);
+}
+
+static void AppendNativePath(const std::wstring& sFileName, std::string& sResult)
+{
+   for (wchar_t c : sFileName)
+   {
+      const unsigned long iCode = (unsigned long) c;
+      if (iCode < 0x80)
+         sResult += (char) iCode;
+      else if (iCode < 0x800)
+      {
+         sResult += (char) (0xC0 | (iCode >> 6));
+         sResult += (char) (0x80 | (iCode & 0x3F));
+      }
+      else if (iCode < 0x10000)
+      {
+         sResult += (char) (0xE0 | (iCode >> 12));
+         sResult += (char) (0x80 | ((iCode >> 6) & 0x3F));
+         sResult += (char) (0x80 | (iCode & 0x3F));
+      }
+      else
+      {
+         sResult += (char) (0xF0 | (iCode >> 18));
+         sResult += (char) (0x80 | ((iCode >> 12) & 0x3F));
+         sResult += (char) (0x80 | ((iCode >> 6) & 0x3F));
+         sResult += (char) (0x80 | (iCode & 0x3F));
+      }
+   }
+}
+
+native_path_t GetNativePath(const std::wstring& sFileName)
+{
+   std::string sResult;
+   AppendNativePath(sFileName, sResult);
+   return sResult;
 }
+
+static std::wstring FromNativePath(const std::string& sFileName)
+{
+   std::wstring sResult;
+   for (size_t i = 0; i < sFileName.size();)
+   {
+      const unsigned char c = sFileName[i];
+      const size_t iLength = c < 0x80 ? 1 : c < 0xE0 ? 2 : c < 0xF0 ? 3 : 4;
+      unsigned long iCode = iLength > 1 ? c & (0x7F >> iLength) : c;
+      for (size_t j = 1; j < iLength && i + j < sFileName.size(); ++j)
+         iCode = (iCode << 6) | (sFileName[i + j] & 0x3F);
+      sResult += (wchar_t) iCode;
+      i += iLength;
+   }
+   return sResult;
+}
+
+bool GetFileStamp(const std::wstring& sFileName, file_stamp& stamp)
+{
+   // called for every field TC shows, the buffer keeps its memory between calls
+   static thread_local std::string sPath;
+   sPath.clear();
+   AppendNativePath(sFileName, sPath);
+
+   struct stat data;
+   if (stat(sPath.c_str(), &data) != 0)
+      return false;
+
+   stamp.m_Size = data.st_size;
+   stamp.m_Time = (unsigned long long) data.st_mtim.tv_sec * 1000000000ull + data.st_mtim.tv_nsec;
+   return true;
+}
+
+void ListDirectory(const std::wstring& sPath, std::vector<std::wstring>& files)
+{
+   std::wstring sDir(sPath);
+   if (!sDir.empty() && L'/' != sDir[sDir.size() - 1])
+      sDir += L'/';
+
+   DIR* pDir = opendir(GetNativePath(sDir).c_str());
+   if (!pDir)
+      return;
+
+   while (const dirent* pEntry = readdir(pDir))
+   {
+      const std::wstring sFileName = sDir + FromNativePath(pEntry->d_name);
+      struct stat data;
+      if (0 == stat(GetNativePath(sFileName).c_str(), &data) && S_ISREG(data.st_mode))
+         files.push_back(sFileName);
+   }
+
+   closedir(pDir);
+}
+
+std::wstring GetVolumeName(const std::wstring& sFileName)
+{
+   struct stat data;
+   if (stat(GetNativePath(sFileName).c_str(), &data) != 0)
+      return std::wstring();
+
+   std::wostringstream os;
+   os << data.st_dev;
+   return os.str();
+}
+
+static bool FindIniValue(const std::string& sIniName, const std::string& sSection, const std::string& sKey,
+      std::string& sValue)
+{
+   std::ifstream ini(sIniName.c_str());
+   std::string sLine;
+   bool bInSection = false;
+
+   while (std::getline(ini, sLine))
+   {
+      if (!sLine.empty() && '\r' == sLine[sLine.size() - 1])
+         sLine.erase(sLine.size() - 1);
+
+      if (!sLine.empty() && '[' == sLine[0])
+      {
+         bInSection = 0 == strcasecmp(sLine.c_str(), ("[" + sSection + "]").c_str());
+         continue;
+      }
+
+      const std::string::size_type iEqual = sLine.find('=');
+      if (bInSection && std::string::npos != iEqual && 0 == strcasecmp(sLine.substr(0, iEqual).c_str(), sKey.c_str()))
+      {
+         sValue = sLine.substr(iEqual + 1);
+         return true;
+      }
+   }
+
+   return false;
+}
+
+int GetIniInt(const std::string& sIniName, const std::string& sSection, const std::string& sKey,
+      const int iDefault)
+{
+   std::string sValue;
+   return FindIniValue(sIniName, sSection, sKey, sValue) ? std::atoi(sValue.c_str()) : iDefault;
+}
+
+std::string GetIniString(const std::string& sIniName, const std::string& sSection, const std::string& sKey,
+      const std::string& sDefault)
+{
+   std::string sValue;
+   return FindIniValue(sIniName, sSection, sKey, sValue) ? sValue : sDefault;
+}
+
+#endif
+
+}
+
+#ifndef _WIN32
+
+wchar_t* wcslcpy(wchar_t* str1, const wchar_t* str2, int imaxlen)
+{
+   if ((int) wcslen(str2) >= imaxlen - 1)
+   {
+      wcsncpy(str1, str2, imaxlen - 1);
+      str1[imaxlen - 1] = 0;
+   }
+   else
+      wcscpy(str1, str2);
+   return str1;
+}
+
+#endif
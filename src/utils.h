@@ -18,15 +18,56 @@
 #pragma once
 
 #include <string>
-#include <windows.h>
+#include <vector>
+#include "compat.h"
 
 namespace utils
 {
 
+/// size and last write time of a file, used to detect changes made since
+/// the file was parsed
+struct file_stamp
+{
+   unsigned long long m_Size;
+   unsigned long long m_Time;
+
+   file_stamp() :
+         m_Size(0), m_Time(0)
+   {
+   }
+
+   bool operator==(const file_stamp& other) const
+   {
+      return m_Size == other.m_Size && m_Time == other.m_Time;
+   }
+
+   bool operator!=(const file_stamp& other) const
+   {
+      return !(*this == other);
+   }
+};
+
 char* strlcpy(char* p, const char* p2, int maxlen);
 std::string formatSeconds(int seconds);
 std::string Int2Str(const int num);
 void ShowError(const std::string& sText, const std::string& sTitle = std::string(), const HWND hWnd = NULL);
+void ShowError(const std::wstring& sText, const std::wstring& sTitle = std::wstring(), const HWND hWnd = NULL);
+bool GetFileStamp(const std::wstring& sFileName, file_stamp& stamp);
+void ListDirectory(const std::wstring& sPath, std::vector<std::wstring>& files);
+/// file name in the form TagLib::FileName takes it: UTF-16 on Windows,
+/// UTF-8 elsewhere
+#ifdef _WIN32
+typedef std::wstring native_path_t;
+#else
+typedef std::string native_path_t;
+#endif
+native_path_t GetNativePath(const std::wstring& sFileName);
+/// drive or network share the file is on, e.g. "C:\" or "\\server\share\"
+std::wstring GetVolumeName(const std::wstring& sFileName);
+int GetIniInt(const std::string& sIniName, const std::string& sSection, const std::string& sKey,
+      const int iDefault);
+std::string GetIniString(const std::string& sIniName, const std::string& sSection, const std::string& sKey,
+      const std::string& sDefault = std::string());
 
 template<class T>
 class singleton: private T
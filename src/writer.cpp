@@ -0,0 +1,288 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include <algorithm>
+#include <mpegfile.h>
+#include <id3v2tag.h>
+#include <id3v2header.h>
+#include <vorbisfile.h>
+#include <speexfile.h>
+#include <opusfile.h>
+#include <xiphcomment.h>
+
+#include "ogg.h"
+#include "writer.h"
+
+namespace wdx
+{
+
+// ID3v2::Tag::render() of TagLib 1.9 pads a tag with this if it does not fit
+// into its original size, otherwise it pads it to the original size
+static const TagLib::uint TagLibPadding = 1024;
+
+// ID3v2 sizes are 28 bit synchsafe integers
+static const TagLib::uint MaxTagSize = 0x0FFFFFFF;
+
+/// writes ID3v2 tag of MPEG file, returns false if this is left to TagLib
+static bool SaveMpegFile(TagLib::MPEG::File* pFile, const padding_policy& policy, bool& bSaved)
+{
+   TagLib::ID3v2::Tag* pTag = pFile->ID3v2Tag();
+   if (pFile->readOnly() || !pTag || pTag->isEmpty())
+      return false;
+
+   // space taken by the tag now; a tag which is not in front of the audio
+   // data is moved there by TagLib
+   const TagLib::uint iHeaderSize = TagLib::ID3v2::Header::size();
+   pFile->seek(0);
+   const TagLib::ByteVector header = pFile->readBlock(iHeaderSize);
+   TagLib::uint iOldSize = 0;
+   if (header.size() == iHeaderSize && header.startsWith(TagLib::ID3v2::Header::fileIdentifier()))
+      iOldSize = TagLib::ID3v2::Header(header).completeTagSize();
+   else if (pTag->header()->tagSize() > 0)
+      return false;
+
+   // size of frames and padding, render() overwrites it
+   const TagLib::uint iOldTagSize = pTag->header()->tagSize();
+   const TagLib::ByteVector rendered = pTag->render(4);
+   const TagLib::uint iRendered = rendered.size() - iHeaderSize;
+
+   // frames keep the original size if they fit into it
+   if (iRendered != iOldTagSize && iRendered < TagLibPadding)
+      return false;
+   const TagLib::uint iFrames = iRendered == iOldTagSize ? iRendered : iRendered - TagLibPadding;
+
+   TagLib::uint iSize = iOldSize;
+   if (iHeaderSize + iFrames > iOldSize)
+      iSize = iHeaderSize + iFrames + std::max(policy.m_Reserve, iFrames / 100 * policy.m_GrowthPercent);
+   if (iSize - iHeaderSize > MaxTagSize)
+      return false;
+
+   // tags at the end of the file go first, they do not move the beginning
+   if (!pFile->save(TagLib::MPEG::File::ID3v1 | TagLib::MPEG::File::APE, false))
+   {
+      bSaved = false;
+      return true;
+   }
+
+   TagLib::ByteVector data = rendered.mid(0, iHeaderSize + iFrames);
+   data.resize(iSize, 0);
+   data[5] &= ~0x10; // footer is not rendered
+   const TagLib::uint iTagSize = iSize - iHeaderSize;
+   data[6] = (iTagSize >> 21) & 0x7F;
+   data[7] = (iTagSize >> 14) & 0x7F;
+   data[8] = (iTagSize >> 7) & 0x7F;
+   data[9] = iTagSize & 0x7F;
+
+   if (iSize == iOldSize)
+   {
+      pFile->seek(0);
+      pFile->writeBlock(data);
+   }
+   else
+      pFile->insert(data, 0, iOldSize);
+
+   bSaved = true;
+   return true;
+}
+
+// comment header spanning more pages is left to TagLib
+static const size_t MaxCommentPages = 256;
+
+/// comment header packet the same as TagLib writes it,
+/// false if the format is left to TagLib
+static bool RenderCommentPacket(const audio_file& file, TagLib::ByteVector& packet)
+{
+   switch (file.GetFormat())
+   {
+      case fmtOggVorbis:
+         packet = TagLib::ByteVector("\x03vorbis", 7);
+         packet.append(static_cast<TagLib::Ogg::Vorbis::File*>(file.GetFile())->tag()->render(true));
+         return true;
+      case fmtOpus:
+         packet = TagLib::ByteVector("OpusTags", 8);
+         packet.append(static_cast<TagLib::Ogg::Opus::File*>(file.GetFile())->tag()->render(false));
+         return true;
+      case fmtSpeex:
+         packet = static_cast<TagLib::Ogg::Speex::File*>(file.GetFile())->tag()->render();
+         return true;
+      default:
+         // FLAC metadata block of Ogg FLAC must not be padded
+         return false;
+   }
+}
+
+/// lacing values of a packet of the given size
+static void AppendLacing(const long iSize, std::vector<unsigned char>& lacing)
+{
+   lacing.insert(lacing.end(), iSize / 255, 255);
+   lacing.push_back((unsigned char) (iSize % 255));
+}
+
+/// writes comment header of Vorbis, Opus or Speex stream over the pages it
+/// takes now, returns false if this is left to TagLib. Zeroes after the
+/// comments are ignored by the decoders, so a shorter packet is padded to
+/// the old size and a longer one gets padding by the policy. Pages keep
+/// their number, so sequence numbers of the following pages stay valid and
+/// the audio pages are never rewritten.
+static bool SaveOggFile(const audio_file& file, const padding_policy& policy, bool& bSaved)
+{
+   TagLib::ByteVector packet;
+   if (file.GetFile()->readOnly() || !RenderCommentPacket(file, packet))
+      return false;
+
+   TagLib::IOStream* pStream = file.GetStream();
+
+   // identification header is alone on the first page
+   ogg_page first;
+   if (!ReadOggPage(pStream, 0, first) || !(first.m_Flags & ogg_page::FirstPage) || first.m_Lacing.empty())
+      return false;
+   for (size_t i = 0; i < first.m_Lacing.size(); ++i)
+   {
+      if ((first.m_Lacing[i] < 255) != (i + 1 == first.m_Lacing.size()))
+         return false;
+   }
+
+   // pages with the comment header, it starts on the second page
+   std::vector<ogg_page> pages;
+   std::vector<unsigned char> oldLacing;
+   long iOldSize = 0;
+   size_t iPacketSegments = 0;
+   bool bComplete = false;
+   long iOffset = first.GetSize();
+   while (!bComplete)
+   {
+      ogg_page page;
+      if (pages.size() == MaxCommentPages || !ReadOggPage(pStream, iOffset, page)
+            || page.m_Serial != first.m_Serial || (pages.empty() && (page.m_Flags & ogg_page::Continued)))
+         return false;
+
+      for (size_t i = 0; i < page.m_Lacing.size() && !bComplete; ++i)
+      {
+         iOldSize += page.m_Lacing[i];
+         ++iPacketSegments;
+         bComplete = page.m_Lacing[i] < 255;
+      }
+
+      oldLacing.insert(oldLacing.end(), page.m_Lacing.begin(), page.m_Lacing.end());
+      iOffset += page.GetSize();
+      pages.push_back(page);
+   }
+
+   const long iStart = pages.front().m_Offset;
+   const long iOldLength = iOffset - iStart;
+
+   // the comment header is followed by the beginning of the next header,
+   // which stays as it is
+   TagLib::ByteVector content;
+   for (const ogg_page& page : pages)
+   {
+      pStream->seek(page.m_Offset + page.GetHeaderSize());
+      const TagLib::ByteVector body = pStream->readBlock(page.GetBodySize());
+      if (body.size() != (TagLib::uint) page.GetBodySize())
+         return false;
+      content.append(body);
+   }
+   const size_t iRestSegments = oldLacing.size() - iPacketSegments;
+   const TagLib::ByteVector rest = content.mid(iOldSize);
+
+   long iSize = iOldSize;
+   if ((long) packet.size() > iOldSize)
+   {
+      // largest packet which fits into the segment tables of the pages
+      const long iCapacity = (long) (pages.size() * ogg_page::MaxSegments - iRestSegments) * 255 - 1;
+      const long iNewSize = packet.size();
+      if (iNewSize > iCapacity)
+         return false;
+      const long iPadding = std::max(policy.m_Reserve, (unsigned int) iNewSize / 100 * policy.m_GrowthPercent);
+      iSize = std::min(iCapacity, iNewSize + iPadding);
+   }
+   packet.resize(iSize, 0);
+
+   // segments are spread over the same pages again, the last segments
+   // stay the same, so the page after them is still valid
+   if (iSize != iOldSize)
+   {
+      std::vector<unsigned char> lacing;
+      AppendLacing(iSize, lacing);
+      lacing.insert(lacing.end(), oldLacing.end() - iRestSegments, oldLacing.end());
+      if (lacing.size() < pages.size())
+         return false;
+
+      const long long iGranule = pages.back().m_Granule;
+      size_t iNext = 0;
+      for (size_t i = 0; i < pages.size(); ++i)
+      {
+         const size_t iCount = std::min(ogg_page::MaxSegments, lacing.size() - iNext - (pages.size() - i - 1));
+         pages[i].m_Lacing.assign(lacing.begin() + iNext, lacing.begin() + iNext + iCount);
+         iNext += iCount;
+
+         if (i > 0)
+         {
+            pages[i].m_Flags &= ~ogg_page::Continued;
+            if (255 == pages[i - 1].m_Lacing.back())
+               pages[i].m_Flags |= ogg_page::Continued;
+         }
+         // granule position is not defined for pages where no packet ends
+         pages[i].m_Granule = pages[i].HasPacketEnd() ? iGranule : -1;
+      }
+   }
+
+   content = packet;
+   content.append(rest);
+
+   TagLib::ByteVector data;
+   long iPosition = 0;
+   for (const ogg_page& page : pages)
+   {
+      data.append(RenderOggPage(page, content.mid(iPosition, page.GetBodySize())));
+      iPosition += page.GetBodySize();
+   }
+
+   if ((long) data.size() == iOldLength)
+   {
+      pStream->seek(iStart);
+      pStream->writeBlock(data);
+   }
+   else
+      pStream->insert(data, iStart, iOldLength);
+
+   bSaved = true;
+   return true;
+}
+
+bool SaveTags(const audio_file& file, const padding_policy& policy)
+{
+   bool bSaved = false;
+   switch (file.GetFormat())
+   {
+      case fmtMPEG:
+         if (SaveMpegFile(static_cast<TagLib::MPEG::File*>(file.GetFile()), policy, bSaved))
+            return bSaved;
+         break;
+      case fmtOggVorbis:
+      case fmtOpus:
+      case fmtSpeex:
+         if (SaveOggFile(file, policy, bSaved))
+            return bSaved;
+         break;
+      default:
+         break;
+   }
+
+   return file.GetFile()->save();
+}
+
+}
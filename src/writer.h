@@ -0,0 +1,41 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#pragma once
+
+#include "formats.h"
+
+namespace wdx
+{
+
+/// free space left in a tag which has to grow, so following edits fit into it
+struct padding_policy
+{
+   unsigned int m_Reserve; // bytes
+   unsigned int m_GrowthPercent; // of the size of the tag
+
+   padding_policy(const unsigned int iReserve, const unsigned int iGrowthPercent) :
+         m_Reserve(iReserve), m_GrowthPercent(iGrowthPercent)
+   {
+   }
+};
+
+/// saves changed tags of the file. ID3v2 tag in front of MPEG audio is
+/// written over the space of the old tag whenever it fits, otherwise the
+/// file is rewritten once and the tag is padded according to the policy.
+/// Tags at the end of files never make TagLib move the audio data.
+bool SaveTags(const audio_file& file, const padding_policy& policy);
+}
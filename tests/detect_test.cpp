@@ -0,0 +1,72 @@
+// WDXTagLib is a content plugin for Total Commander which uses TagLib library
+// for reading and editing the meta-data of several popular audio formats.
+// Copyright (C) 2008-2013 Dmitry Murzaikin (murzzz@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// Checks that the plugin gives TC the detect string built from the table of
+// supported extensions and that every extension in it is supported.
+//
+// usage: detect_test
+
+#include <cstdio>
+#include <string>
+
+#include "formats.h"
+#include "plugin.h"
+
+int main()
+{
+   wdx::plugin inst;
+   const std::string sDetect = inst.GetDetectString();
+   int iErrors = 0;
+
+   if (sDetect.empty() || sDetect != wdx::GetDetectString())
+   {
+      std::printf("detect string differs from the extension table: %s\n", sDetect.c_str());
+      ++iErrors;
+   }
+
+   int iExtensions = 0;
+   const std::string sPrefix = "EXT=\"";
+   for (std::string::size_type iPos = sDetect.find(sPrefix); std::string::npos != iPos;
+         iPos = sDetect.find(sPrefix, iPos))
+   {
+      iPos += sPrefix.size();
+      const std::string::size_type iEnd = sDetect.find('"', iPos);
+      if (std::string::npos == iEnd)
+      {
+         std::printf("unterminated extension at %u\n", (unsigned int) iPos);
+         ++iErrors;
+         break;
+      }
+
+      const std::string sExt = sDetect.substr(iPos, iEnd - iPos);
+      if (!wdx::IsSupportedFile(L"test." + std::wstring(sExt.begin(), sExt.end())))
+      {
+         std::printf("extension %s is not supported\n", sExt.c_str());
+         ++iErrors;
+      }
+      ++iExtensions;
+      iPos = iEnd;
+   }
+
+   if (!iExtensions || std::string::npos == sDetect.find("EXT=\"MP3\""))
+   {
+      std::printf("no extensions in detect string: %s\n", sDetect.c_str());
+      ++iErrors;
+   }
+
+   std::printf("%d extensions, %d errors\n", iExtensions, iErrors);
+   return iErrors ? 1 : 0;
+}